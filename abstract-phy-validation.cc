@@ -0,0 +1,169 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Validation of the abstract sidelink PHY (abstract-sl-phy.h) against the
+ * full one: the scenario (wns3-2017-synch by default) is run for every
+ * seed with --abstractPhy=0 and --abstractPhy=1, in parallel, in
+ * outDir/full-NNNNN and outDir/abstract-NNNNN, and the PDR and latency
+ * KPIs of both are compared.
+ *
+ * The table of every seed (KPIs and wall time of both runs) is printed and
+ * written to outDir/validation.tsv, followed by the mean PDR error, the
+ * mean relative latency error and the speed-up. The exit status is 0 if
+ * both errors are within --pdrTolerance and --latencyTolerance, 2
+ * otherwise.
+ *
+ * The scenario binary is run directly, so run the harness through waf to
+ * get the library path:
+ *
+ * ./waf --run "abstract-phy-validation --binary=build/scratch/wns3-2017-synch
+ *   --args=--ring=1 --groups=5 --responders=10 --simTime=30 --seeds=1,2,3"
+ */
+
+#include "ns3/core-module.h"
+#include "parameter-sweep.h"
+
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("AbstractPhyValidation");
+
+//the directory of a run
+std::string
+RunDirectory (const std::string &outDir, bool abstract, uint32_t seed)
+{
+  std::ostringstream oss;
+  oss << outDir << (abstract ? "/abstract-" : "/full-") << std::setw (5) << std::setfill ('0') << seed;
+  return oss.str ();
+}
+
+//a KPI of a finished run, NaN if missing
+double
+ReadKpi (const std::string &dir, const std::string &kpiFile, const std::string &name)
+{
+  KpiTable::Row row;
+  KpiTable::ReadKpiFile (dir + "/" + kpiFile, row);
+  for (uint32_t c = 0; c < row.size (); ++c)
+    {
+      if (row[c].first == name)
+        {
+          return std::strtod (row[c].second.c_str (), 0);
+        }
+    }
+  return std::nan ("");
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string binary = "";
+  std::string args = "";
+  std::string seeds = "1,2,3";
+  std::string outDir = "abstract-validation";
+  std::string kpiFile = "kpi.txt";
+  double pdrTolerance = 0.05;
+  double latencyTolerance = 0.2;
+  uint32_t jobs = 0;
+
+  CommandLine cmd;
+  cmd.AddValue ("binary", "The scenario binary, with an --abstractPhy switch", binary);
+  cmd.AddValue ("args", "Space-separated arguments given to every run", args);
+  cmd.AddValue ("seeds", "Comma-separated RngRun values", seeds);
+  cmd.AddValue ("outDir", "The directory of the run directories and table", outDir);
+  cmd.AddValue ("kpiFile", "The KPI file written by the scenario, with pdr and latency(ms)", kpiFile);
+  cmd.AddValue ("pdrTolerance", "Largest mean absolute PDR error accepted", pdrTolerance);
+  cmd.AddValue ("latencyTolerance", "Largest mean relative latency error accepted", latencyTolerance);
+  cmd.AddValue ("jobs", "Number of concurrent runs (0 for the number of cores)", jobs);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (binary.empty (), "No scenario binary (--binary)");
+  char path[PATH_MAX];
+  NS_ABORT_MSG_IF (realpath (binary.c_str (), path) == 0, "Can't find binary " << binary);
+  binary = path;
+
+  std::vector<std::string> fixedArgs;
+  std::istringstream argStream (args);
+  for (std::string a; argStream >> a; )
+    {
+      fixedArgs.push_back (a);
+    }
+  std::vector<std::string> seedList = ParameterGrid::SplitList (seeds);
+  NS_ABORT_MSG_IF (seedList.empty (), "No seeds");
+
+  // run i is the full PHY of seed i / 2 if i is even, the abstract PHY otherwise
+  ProcessPool pool (jobs);
+  ProcessPool::MakeDirectories (outDir);
+  std::map<uint32_t, std::chrono::steady_clock::time_point> started;
+  std::vector<double> wallTime (2 * seedList.size (), 0);
+  for (uint32_t i = 0; i < 2 * seedList.size (); ++i)
+    {
+      uint32_t seed = std::strtoul (seedList[i / 2].c_str (), 0, 10);
+      std::vector<std::string> argv (1, binary);
+      argv.push_back ("--RngRun=" + seedList[i / 2]);
+      argv.insert (argv.end (), fixedArgs.begin (), fixedArgs.end ());
+      argv.push_back (i % 2 ? "--abstractPhy=1" : "--abstractPhy=0");
+      argv.push_back ("--kpiFile=" + kpiFile);
+      pool.Submit (i, RunDirectory (outDir, i % 2, seed), argv);
+      started[i] = std::chrono::steady_clock::now ();
+
+      uint32_t done;
+      int status;
+      while (pool.Wait (done, status, false))
+        {
+          NS_ABORT_MSG_IF (status != 0, "Run " << done << " exited with " << status << ", see " << RunDirectory (outDir, done % 2, std::strtoul (seedList[done / 2].c_str (), 0, 10)));
+          wallTime[done] = std::chrono::duration<double> (std::chrono::steady_clock::now () - started[done]).count ();
+        }
+    }
+  uint32_t done;
+  int status;
+  while (pool.Wait (done, status))
+    {
+      NS_ABORT_MSG_IF (status != 0, "Run " << done << " exited with " << status << ", see " << RunDirectory (outDir, done % 2, std::strtoul (seedList[done / 2].c_str (), 0, 10)));
+      wallTime[done] = std::chrono::duration<double> (std::chrono::steady_clock::now () - started[done]).count ();
+    }
+
+  std::ostringstream table;
+  table << "RngRun\tpdr(full)\tpdr(abstract)\tlatency(full)\tlatency(abstract)\ttime(full)\ttime(abstract)" << std::endl;
+  double pdrError = 0;
+  double latencyError = 0;
+  double fullTime = 0;
+  double abstractTime = 0;
+  for (uint32_t s = 0; s < seedList.size (); ++s)
+    {
+      uint32_t seed = std::strtoul (seedList[s].c_str (), 0, 10);
+      std::string fullDir = RunDirectory (outDir, false, seed);
+      std::string abstractDir = RunDirectory (outDir, true, seed);
+      double fullPdr = ReadKpi (fullDir, kpiFile, "pdr");
+      double abstractPdr = ReadKpi (abstractDir, kpiFile, "pdr");
+      double fullLatency = ReadKpi (fullDir, kpiFile, "latency(ms)");
+      double abstractLatency = ReadKpi (abstractDir, kpiFile, "latency(ms)");
+      NS_ABORT_MSG_IF (std::isnan (fullPdr) || std::isnan (abstractPdr) || std::isnan (fullLatency) || std::isnan (abstractLatency),
+                       "Missing pdr or latency(ms) in the KPI files of RngRun " << seed);
+      pdrError += std::fabs (abstractPdr - fullPdr);
+      latencyError += fullLatency > 0 ? std::fabs (abstractLatency - fullLatency) / fullLatency : 0;
+      fullTime += wallTime[2 * s];
+      abstractTime += wallTime[2 * s + 1];
+      table << seed << "\t" << fullPdr << "\t" << abstractPdr << "\t" << fullLatency << "\t" << abstractLatency << "\t"
+            << wallTime[2 * s] << "\t" << wallTime[2 * s + 1] << std::endl;
+    }
+  pdrError /= seedList.size ();
+  latencyError /= seedList.size ();
+  bool valid = pdrError <= pdrTolerance && latencyError <= latencyTolerance;
+  table << "# mean PDR error " << pdrError << ", mean latency error " << latencyError * 100 << "%, speed-up "
+        << (abstractTime > 0 ? fullTime / abstractTime : 0) << ": " << (valid ? "within" : "NOT within") << " tolerance" << std::endl;
+
+  std::cout << table.str ();
+  std::ofstream out ((outDir + "/validation.tsv").c_str ());
+  NS_ABORT_MSG_UNLESS (out.is_open (), "Can't open file " << outDir << "/validation.tsv");
+  out << table.str ();
+
+  return valid ? 0 : 2;
+}
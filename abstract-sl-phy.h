@@ -0,0 +1,846 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Abstract (link-to-system) sidelink PHY for capacity sweeps of the
+ * broadcast group scenarios (wns3-2017-synch --abstractPhy): the groups
+ * and traffic of the scenario are played period by period without the
+ * LTE stack nor the per-RB SpectrumValue interference.
+ *
+ * In every sidelink period, each transmitter with pending packets draws
+ * a PSCCH resource (two subframes of the PSCCH region, one PRB), a T-RPT
+ * (ktrp of every 8 data subframes) and a subchannel of rbSize PRBs, as
+ * the UE-selected scheduler; its MAC PDUs take 4 transmission
+ * opportunities each (HARQ), and carry the pending packets, segmented at
+ * the TB size of the MCS. A receiver then gets, per transmission,
+ *
+ *   SINR = P (tx) / (N + sum of P (other tx on the same subframe and RBs))
+ *
+ * with P the received power from the scenario's (cached) pathloss model
+ * and N the thermal noise over the RBs, and nothing when it transmits
+ * itself (half duplex). The SCI is received if one of its two
+ * transmissions is decoded, the PDU with the chase-combined SINR of its
+ * four transmissions, each with the BLER of the sidelink error model
+ * (LteNistErrorModel, through the SlBlerTable lookup) when enabled, as
+ * LteSpectrumPhy. A packet is delivered when all its segments are; the
+ * latency runs from its generation to the end of the subframe of the
+ * last transmission.
+ *
+ * Periods where no transmitter has a packet queued cost nothing: the loop
+ * jumps to the period after the next packet generation.
+ *
+ * The receptions of a period, all at the same time, are independent: with
+ * SetWorkers, their SINRs and BLERs are computed on a pool of threads,
+ * from the link powers computed beforehand, then the decoding draws and
+ * deliveries are committed in transmitter and receiver order, so the
+ * results are the same whatever the number of workers.
+ *
+ * The UEs are assumed synchronized (periods aligned), i.e. the steady
+ * state reached by the SLSS protocol. SlDeliveryStats gives the same PDR
+ * and latency KPIs for a run of the full PHY, from the application
+ * traces, which is what abstract-phy-validation.cc compares.
+ *
+ *   Ptr<SlDeliveryStats> stats = Create<SlDeliveryStats> ();
+ *   Ptr<AbstractSlPhy> phy = Create<AbstractSlPhy> (lossModel);
+ *   phy->SetPool (slPeriod, pscchLength, 2 * pscchRbs, 2 * dataRbs);
+ *   phy->SetGrant (rbSize, mcs, ktrp);
+ *   phy->SetPeriodicTraffic (pktSize, pktInterval, maxPackets);
+ *   phy->Run (groups, start, stop, stats);
+ *   stats->PrintStats (std::cout);
+ */
+
+#ifndef ABSTRACT_SL_PHY_H
+#define ABSTRACT_SL_PHY_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/lte-module.h"
+
+#include "kpi-file.h"
+#include "sl-bler-table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <thread>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Packet delivery ratio and latency of the broadcast groups, for the full
+ * PHY (application traces) and the abstract one alike.
+ */
+class SlDeliveryStats : public SimpleRefCount<SlDeliveryStats>
+{
+public:
+  SlDeliveryStats (void)
+    : m_expected (0),
+      m_received (0),
+      m_latencySum (0)
+  { }
+
+  /**
+   * A packet sent to a group.
+   * \param receivers The number of receivers of the group.
+   */
+  void NotifyTx (uint32_t receivers)
+  {
+    m_expected += receivers;
+  }
+
+  /**
+   * A packet received by one receiver.
+   * \param latency Its latency.
+   */
+  void NotifyRx (Time latency)
+  {
+    m_received++;
+    m_latencySum += latency.GetSeconds ();
+  }
+
+  /**
+   * Count the packets of a group transmitter application, which must
+   * have a "Tx" trace source (UdpEchoClient, OnOffApplication).
+   * \param app The application.
+   * \param receivers The number of receivers of its group.
+   */
+  void ConnectTx (Ptr<Application> app, uint32_t receivers)
+  {
+    app->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&SlDeliveryStats::AppTx, Ptr<SlDeliveryStats> (this), receivers));
+  }
+
+  /**
+   * Count the packets received by a PacketSink.
+   * \param sink The sink application.
+   */
+  void ConnectRx (Ptr<Application> sink)
+  {
+    sink->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&SlDeliveryStats::AppRx, Ptr<SlDeliveryStats> (this)));
+  }
+
+  /**
+   * \return The fraction of the (packet, receiver) pairs delivered.
+   */
+  double GetPdr (void) const
+  {
+    return m_expected ? (double) m_received / m_expected : 0;
+  }
+
+  /**
+   * \return The mean latency (s) of the packets delivered.
+   */
+  double GetMeanLatency (void) const
+  {
+    return m_received ? m_latencySum / m_received : 0;
+  }
+
+  /**
+   * \param kpis The KPI file to set "pdr" and "latency(ms)" in.
+   */
+  void SetKpis (Ptr<KpiFile> kpis) const
+  {
+    kpis->Set ("pdr", GetPdr ());
+    kpis->Set ("latency(ms)", GetMeanLatency () * 1000);
+  }
+
+  /**
+   * \param os The stream to print the counters to.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    os << "delivery: " << m_received << "/" << m_expected << " packets (PDR " << GetPdr () << "), mean latency "
+       << GetMeanLatency () * 1000 << " ms" << std::endl;
+  }
+
+private:
+  static void AppTx (Ptr<SlDeliveryStats> stats, uint32_t receivers, Ptr<const Packet> p)
+  {
+    DelayJitterEstimation::PrepareTx (p);
+    stats->NotifyTx (receivers);
+  }
+
+  static void AppRx (Ptr<SlDeliveryStats> stats, Ptr<const Packet> p, const Address &from)
+  {
+    stats->m_delay.RecordRx (p);
+    stats->NotifyRx (stats->m_delay.GetLastDelay ());
+  }
+
+  uint64_t m_expected;                 //!< The (packet, receiver) pairs sent.
+  uint64_t m_received;                 //!< The (packet, receiver) pairs delivered.
+  double m_latencySum;                 //!< The sum of their latencies (s).
+  DelayJitterEstimation m_delay;       //!< The latency of the last packet received.
+};
+
+class AbstractSlPhy : public SimpleRefCount<AbstractSlPhy>
+{
+public:
+  /**
+   * \param lossModel The pathloss model of the sidelink.
+   */
+  AbstractSlPhy (Ptr<PropagationLossModel> lossModel)
+    : m_lossModel (lossModel),
+      m_txPower (23),
+      m_noiseFigure (9),
+      m_period (40),
+      m_pscchSubframes (8),
+      m_pscchPrbs (44),
+      m_dataPrbs (50),
+      m_rbSize (2),
+      m_mcs (10),
+      m_ktrp (2),
+      m_ctrlErrorModel (true),
+      m_dataErrorModel (true),
+      m_dropOnCollision (false),
+      m_pktSize (40),
+      m_pktInterval (MilliSeconds (20)),
+      m_maxPackets (0xffffffff),
+      m_meanOn (0),
+      m_meanOff (0),
+      m_scis (0),
+      m_pdus (0),
+      m_periods (0),
+      m_idlePeriods (0),
+      m_workers (1)
+  {
+    m_rnd = CreateObject<UniformRandomVariable> ();
+    m_onOffRnd = CreateObject<ExponentialRandomVariable> ();
+    m_blerTable = Create<SlBlerTable> ();
+  }
+
+  /**
+   * \param blerTable The BLER table, e.g. loaded from a cache file.
+   */
+  void SetBlerTable (Ptr<SlBlerTable> blerTable)
+  {
+    m_blerTable = blerTable;
+  }
+
+  /**
+   * \param txPower The transmit power of the UEs (dBm).
+   * \param noiseFigure Their noise figure (dB).
+   */
+  void SetRadio (double txPower, double noiseFigure)
+  {
+    m_txPower = txPower;
+    m_noiseFigure = noiseFigure;
+  }
+
+  /**
+   * \param period The sidelink period (subframes).
+   * \param pscchSubframes The subframes of the PSCCH region, an even number.
+   * \param pscchPrbs The PRBs of the PSCCH pool.
+   * \param dataPrbs The PRBs of the PSSCH pool.
+   */
+  void SetPool (uint32_t period, uint32_t pscchSubframes, uint32_t pscchPrbs, uint32_t dataPrbs)
+  {
+    NS_ABORT_MSG_IF (pscchSubframes < 2 || pscchSubframes % 2 || pscchSubframes >= period, "Bad PSCCH region of " << pscchSubframes << " subframes");
+    m_period = period;
+    m_pscchSubframes = pscchSubframes;
+    m_pscchPrbs = pscchPrbs;
+    m_dataPrbs = dataPrbs;
+  }
+
+  /**
+   * \param rbSize The PRBs of a PSSCH transmission.
+   * \param mcs Its MCS.
+   * \param ktrp The transmission subframes in every 8 of the T-RPT.
+   */
+  void SetGrant (uint32_t rbSize, uint32_t mcs, uint32_t ktrp)
+  {
+    NS_ABORT_MSG_IF (rbSize == 0 || rbSize > m_dataPrbs, "Bad grant of " << rbSize << " PRBs");
+    NS_ABORT_MSG_IF (ktrp == 0 || ktrp > 8, "Bad ktrp " << ktrp);
+    m_rbSize = rbSize;
+    m_mcs = mcs;
+    m_ktrp = ktrp;
+  }
+
+  /**
+   * \param ctrl Whether the PSCCH error model is enabled.
+   * \param data Whether the PSSCH error model is enabled.
+   * \param dropOnCollision Whether transmissions overlapping another are lost.
+   */
+  void SetErrorModels (bool ctrl, bool data, bool dropOnCollision)
+  {
+    m_ctrlErrorModel = ctrl;
+    m_dataErrorModel = data;
+    m_dropOnCollision = dropOnCollision;
+  }
+
+  /**
+   * \param size The packet size (bytes).
+   * \param interval The time between two packets of a transmitter.
+   * \param maxPackets The packets of a transmitter.
+   */
+  void SetPeriodicTraffic (uint32_t size, Time interval, uint32_t maxPackets)
+  {
+    m_pktSize = size;
+    m_pktInterval = interval;
+    m_maxPackets = maxPackets;
+  }
+
+  /**
+   * Send the packets in ON periods only, as OnOffApplication, starting
+   * with an OFF period.
+   * \param meanOn The mean ON duration (s).
+   * \param meanOff The mean OFF duration (s).
+   */
+  void SetOnOff (double meanOn, double meanOff)
+  {
+    m_meanOn = meanOn;
+    m_meanOff = meanOff;
+  }
+
+  /**
+   * Compute the SINRs and BLERs of the receptions of a period on several
+   * threads; the decoding draws and deliveries are still made in order,
+   * so the results do not depend on the number of workers.
+   * \param workers The number of threads, 0 for the number of cores, 1
+   *                for none (default).
+   */
+  void SetWorkers (uint32_t workers)
+  {
+    m_workers = workers ? workers : std::max (1u, std::thread::hardware_concurrency ());
+  }
+
+  /**
+   * \param stream The first stream of the random draws.
+   * \return The number of streams used.
+   */
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_rnd->SetStream (stream);
+    m_onOffRnd->SetStream (stream + 1);
+    return 2;
+  }
+
+  /**
+   * Play the traffic of the groups.
+   * \param groups The groups, transmitter first.
+   * \param start The time the transmitters start sending.
+   * \param stop The time they stop.
+   * \param stats The statistics to fill.
+   */
+  void Run (const std::vector<NetDeviceContainer> &groups, Time start, Time stop, Ptr<SlDeliveryStats> stats)
+  {
+    std::vector<Transmitter> txs;
+    for (uint32_t g = 0; g < groups.size (); g++)
+      {
+        Transmitter tx;
+        tx.ue = UeIndex (groups[g].Get (0));
+        for (uint32_t r = 1; r < groups[g].GetN (); r++)
+          {
+            tx.receivers.push_back (UeIndex (groups[g].Get (r)));
+          }
+        tx.packetOk.assign (tx.receivers.size (), true);
+        GenerateArrivals (tx, start, stop, stats);
+        txs.push_back (tx);
+      }
+
+    uint32_t tbBytes = LteAmc::GetUlTbSizeFromMcs (m_mcs, m_rbSize) / 8;
+    uint32_t subchannels = m_dataPrbs / m_rbSize;
+    uint32_t pduSlots = (m_period - m_pscchSubframes) / 8 * m_ktrp / 4;
+    NS_ABORT_MSG_IF (pduSlots == 0, "No room for a PSSCH PDU in a period");
+    m_blerTable->Build (std::vector<uint32_t> (1, m_mcs));
+    std::vector<std::vector<Reception> > receptions;
+    uint64_t busyPeriods = 0;
+    for (Time periodStart = Seconds (0); periodStart < stop; periodStart += MilliSeconds (m_period))
+      {
+        // the transmitters with pending packets draw their resources
+        std::vector<uint32_t> active;
+        for (uint32_t t = 0; t < txs.size (); t++)
+          {
+            Transmitter &tx = txs[t];
+            while (tx.nextArrival < tx.arrivals.size () && tx.arrivals[tx.nextArrival] < periodStart)
+              {
+                tx.queue.push_back (Pending (tx.nextArrival++, m_pktSize));
+              }
+            if (tx.queue.empty ())
+              {
+                continue;
+              }
+            uint32_t pscchResource = m_rnd->GetInteger (0, m_pscchPrbs * m_pscchSubframes / 2 - 1);
+            tx.sciSubframe = pscchResource % (m_pscchSubframes / 2);
+            tx.sciPrb = pscchResource / (m_pscchSubframes / 2);
+            tx.subchannel = m_rnd->GetInteger (0, subchannels - 1);
+            DrawTrpt (tx, pduSlots);
+            FillPdus (tx, tbBytes);
+            active.push_back (t);
+          }
+        if (active.empty ())
+          {
+            // nothing queued: skip to the period following the next arrival
+            Time next = stop;
+            for (uint32_t t = 0; t < txs.size (); t++)
+              {
+                if (txs[t].nextArrival < txs[t].arrivals.size ())
+                  {
+                    next = std::min (next, txs[t].arrivals[txs[t].nextArrival]);
+                  }
+              }
+            periodStart = MilliSeconds (next.GetMilliSeconds () / m_period * m_period);
+            continue;
+          }
+        busyPeriods++;
+        // the receptions only read the link powers, computed beforehand
+        PrepareLinks (txs, active);
+        ComputeReceptions (txs, active, receptions);
+        for (uint32_t a = 0; a < active.size (); a++)
+          {
+            CommitReceptions (txs, active[a], receptions[a], periodStart, stats);
+          }
+      }
+    uint64_t periods = (stop.GetMicroSeconds () + m_period * 1000 - 1) / (m_period * 1000);
+    m_periods += busyPeriods;
+    m_idlePeriods += periods - busyPeriods;
+  }
+
+  /**
+   * \param os The stream to print the counters to.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    os << "abstract PHY: " << m_periods << " periods (" << m_idlePeriods << " idle skipped), "
+       << m_scis << " SCIs, " << m_pdus << " PSSCH PDUs, " << m_rxPower.size () << " links" << std::endl;
+  }
+
+private:
+  struct Pending
+  {
+    Pending (uint32_t p, uint32_t b)
+      : packet (p),
+        bytes (b),
+        sent (0)
+    { }
+    uint32_t packet;      //!< The packet index.
+    uint32_t bytes;       //!< Its size.
+    uint32_t sent;        //!< Its bytes already in a PDU.
+  };
+
+  struct Segment
+  {
+    uint32_t packet;      //!< The packet index.
+    bool first;           //!< Whether it starts the packet.
+    bool last;            //!< Whether it ends the packet.
+  };
+
+  struct Transmitter
+  {
+    uint32_t ue;                                 //!< The UE index.
+    std::vector<uint32_t> receivers;             //!< The UE indexes of the group receivers.
+    std::vector<Time> arrivals;                  //!< The packet generation times.
+    uint32_t nextArrival;                        //!< The first packet not yet queued.
+    std::deque<Pending> queue;                   //!< The packets not fully sent.
+    std::vector<bool> packetOk;                  //!< Per receiver, the segments of the current packet received.
+    uint32_t sciSubframe;                        //!< The first SCI subframe in the period.
+    uint32_t sciPrb;                             //!< The SCI PRB.
+    uint32_t subchannel;                         //!< The PSSCH subchannel.
+    std::vector<uint32_t> dataSubframes;         //!< The PSSCH subframes of the period, 4 per PDU.
+    std::vector<std::vector<Segment> > pdus;     //!< The segments of every PDU of the period.
+  };
+
+  uint32_t UeIndex (Ptr<NetDevice> dev)
+  {
+    std::unordered_map<const NetDevice *, uint32_t>::const_iterator it = m_ueIndex.find (PeekPointer (dev));
+    if (it != m_ueIndex.end ())
+      {
+        return it->second;
+      }
+    Ptr<MobilityModel> mobility = dev->GetNode ()->GetObject<MobilityModel> ();
+    NS_ABORT_MSG_IF (mobility == 0, "Node " << dev->GetNode ()->GetId () << " has no mobility");
+    m_mobility.push_back (mobility);
+    m_ueIndex[PeekPointer (dev)] = m_mobility.size () - 1;
+    return m_mobility.size () - 1;
+  }
+
+  void GenerateArrivals (Transmitter &tx, Time start, Time stop, Ptr<SlDeliveryStats> stats)
+  {
+    tx.nextArrival = 0;
+    Time t = start;
+    while (t < stop && tx.arrivals.size () < m_maxPackets)
+      {
+        if (m_meanOn > 0)
+          {
+            t += Seconds (m_onOffRnd->GetValue (m_meanOff, 0));
+            Time onEnd = t + Seconds (m_onOffRnd->GetValue (m_meanOn, 0));
+            for (; t < onEnd && t < stop && tx.arrivals.size () < m_maxPackets; t += m_pktInterval)
+              {
+                tx.arrivals.push_back (t);
+              }
+            t = onEnd;
+          }
+        else
+          {
+            tx.arrivals.push_back (t);
+            t += m_pktInterval;
+          }
+      }
+    for (uint32_t p = 0; p < tx.arrivals.size (); p++)
+      {
+        stats->NotifyTx (tx.receivers.size ());
+      }
+  }
+
+  // ktrp random subframes of every 8, then the opportunities of the PDUs
+  void DrawTrpt (Transmitter &tx, uint32_t pduSlots)
+  {
+    uint32_t offsets[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    for (uint32_t i = 0; i < m_ktrp; i++)
+      {
+        std::swap (offsets[i], offsets[m_rnd->GetInteger (i, 7)]);
+      }
+    std::sort (offsets, offsets + m_ktrp);
+    tx.dataSubframes.clear ();
+    for (uint32_t base = m_pscchSubframes; tx.dataSubframes.size () < pduSlots * 4; base += 8)
+      {
+        for (uint32_t i = 0; i < m_ktrp && tx.dataSubframes.size () < pduSlots * 4; i++)
+          {
+            tx.dataSubframes.push_back (base + offsets[i]);
+          }
+      }
+  }
+
+  // the pending packets, segmented in the PDUs of the period
+  void FillPdus (Transmitter &tx, uint32_t tbBytes)
+  {
+    tx.pdus.assign (tx.dataSubframes.size () / 4, std::vector<Segment> ());
+    for (uint32_t p = 0; p < tx.pdus.size () && !tx.queue.empty (); p++)
+      {
+        uint32_t room = tbBytes;
+        while (room > 0 && !tx.queue.empty ())
+          {
+            Pending &pending = tx.queue.front ();
+            uint32_t bytes = std::min (room, pending.bytes - pending.sent);
+            Segment segment = { pending.packet, pending.sent == 0, pending.sent + bytes == pending.bytes };
+            tx.pdus[p].push_back (segment);
+            pending.sent += bytes;
+            room -= bytes;
+            if (segment.last)
+              {
+                tx.queue.pop_front ();
+              }
+          }
+      }
+    while (!tx.pdus.empty () && tx.pdus.back ().empty ())
+      {
+        tx.pdus.pop_back ();
+      }
+  }
+
+  struct Reception
+  {
+    double sciSinr[2];                           //!< The SINR of the two SCI transmissions, 0 if missed.
+    double sciBler[2];                           //!< Their BLER.
+    std::vector<double> pduSinr;                 //!< The combined SINR of every PDU.
+    std::vector<double> pduBler;                 //!< Its BLER.
+  };
+
+  // received power (dBm) at the rx-th UE from the tx-th one, computed on first use
+  double RxPower (uint32_t tx, uint32_t rx)
+  {
+    uint64_t key = ((uint64_t) tx << 32) | rx;
+    std::unordered_map<uint64_t, double>::const_iterator it = m_rxPower.find (key);
+    if (it != m_rxPower.end ())
+      {
+        return it->second;
+      }
+    double rxPower = m_lossModel->CalcRxPower (m_txPower, m_mobility[tx], m_mobility[rx]);
+    m_rxPower[key] = rxPower;
+    return rxPower;
+  }
+
+  // the same, once PrepareLinks computed it
+  double LinkPower (uint32_t tx, uint32_t rx) const
+  {
+    return m_rxPower.find (((uint64_t) tx << 32) | rx)->second;
+  }
+
+  static double DbmToMw (double dbm)
+  {
+    return std::pow (10.0, dbm / 10);
+  }
+
+  double NoiseMw (uint32_t prbs) const
+  {
+    return DbmToMw (-174 + m_noiseFigure + 10 * std::log10 (prbs * 180e3));
+  }
+
+  bool TransmitsSci (const Transmitter &tx, uint32_t subframe) const
+  {
+    return subframe == tx.sciSubframe || subframe == tx.sciSubframe + m_pscchSubframes / 2;
+  }
+
+  bool TransmitsData (const Transmitter &tx, uint32_t subframe) const
+  {
+    std::vector<uint32_t>::const_iterator end = tx.dataSubframes.begin () + tx.pdus.size () * 4;
+    return std::find (tx.dataSubframes.begin (), end, subframe) != end;
+  }
+
+  // the linear SINR of a transmission of the tx-th transmitter, 0 if lost
+  double Sinr (const std::vector<Transmitter> &txs, const std::vector<uint32_t> &active, uint32_t t, uint32_t rx,
+               uint32_t subframe, bool pscch) const
+  {
+    const Transmitter &tx = txs[t];
+    double interference = 0;
+    bool collision = false;
+    for (uint32_t a = 0; a < active.size (); a++)
+      {
+        const Transmitter &other = txs[active[a]];
+        if (active[a] == t || other.ue == rx)
+          {
+            continue;
+          }
+        bool overlap = pscch
+          ? other.sciPrb == tx.sciPrb && TransmitsSci (other, subframe)
+          : other.subchannel == tx.subchannel && TransmitsData (other, subframe);
+        if (overlap)
+          {
+            interference += DbmToMw (LinkPower (other.ue, rx));
+            collision = true;
+          }
+      }
+    if (collision && m_dropOnCollision)
+      {
+        return 0;
+      }
+    return DbmToMw (LinkPower (tx.ue, rx)) / (NoiseMw (pscch ? 1 : m_rbSize) + interference);
+  }
+
+  // the BLER of the sidelink error model at a (linear) SINR
+  double Bler (double sinr, bool pscch) const
+  {
+    if (sinr <= 0)
+      {
+        return 1;
+      }
+    double sinrDb = 10 * std::log10 (sinr);
+    return pscch ? m_blerTable->GetPscchBler (sinrDb) : m_blerTable->GetPsschBler (m_mcs, sinrDb);
+  }
+
+  // a decoding draw, made only when the error model has to decide
+  bool Decoded (double sinr, double bler, bool errorModel)
+  {
+    if (sinr <= 0)
+      {
+        return false;
+      }
+    return !errorModel || m_rnd->GetValue () >= bler;
+  }
+
+  // the received powers the receptions of a period use, in a fixed order
+  void PrepareLinks (const std::vector<Transmitter> &txs, const std::vector<uint32_t> &active)
+  {
+    for (uint32_t a = 0; a < active.size (); a++)
+      {
+        const Transmitter &tx = txs[active[a]];
+        std::vector<uint32_t> overlapping;
+        for (uint32_t o = 0; o < active.size (); o++)
+          {
+            if (o != a && Overlaps (tx, txs[active[o]]))
+              {
+                overlapping.push_back (txs[active[o]].ue);
+              }
+          }
+        for (uint32_t r = 0; r < tx.receivers.size (); r++)
+          {
+            RxPower (tx.ue, tx.receivers[r]);
+            for (uint32_t o = 0; o < overlapping.size (); o++)
+              {
+                if (overlapping[o] != tx.receivers[r])
+                  {
+                    RxPower (overlapping[o], tx.receivers[r]);
+                  }
+              }
+          }
+      }
+  }
+
+  // whether another transmitter interferes with one of the tx's transmissions
+  bool Overlaps (const Transmitter &tx, const Transmitter &other) const
+  {
+    if (other.sciPrb == tx.sciPrb && (TransmitsSci (other, tx.sciSubframe)
+                                      || TransmitsSci (other, tx.sciSubframe + m_pscchSubframes / 2)))
+      {
+        return true;
+      }
+    if (other.subchannel != tx.subchannel)
+      {
+        return false;
+      }
+    for (uint32_t i = 0; i < tx.pdus.size () * 4; i++)
+      {
+        if (TransmitsData (other, tx.dataSubframes[i]))
+          {
+            return true;
+          }
+      }
+    return false;
+  }
+
+  // the SINRs and BLERs of the receptions of the a-th active transmitter
+  // by its receivers [first, last), writing nothing but these receptions
+  void ComputeReceptions (const std::vector<Transmitter> &txs, const std::vector<uint32_t> &active, uint32_t a,
+                          uint32_t first, uint32_t last, Reception *receptions) const
+  {
+    uint32_t t = active[a];
+    const Transmitter &tx = txs[t];
+    for (uint32_t r = first; r < last; r++)
+      {
+        uint32_t rx = tx.receivers[r];
+        Reception &reception = receptions[r];
+        // the receiver's own transmissions in the period, for half duplex
+        const Transmitter *self = 0;
+        for (uint32_t o = 0; o < active.size (); o++)
+          {
+            if (txs[active[o]].ue == rx)
+              {
+                self = &txs[active[o]];
+              }
+          }
+        for (uint32_t k = 0; k < 2; k++)
+          {
+            uint32_t subframe = tx.sciSubframe + k * m_pscchSubframes / 2;
+            reception.sciSinr[k] = 0;
+            if (!self || !(TransmitsSci (*self, subframe) || TransmitsData (*self, subframe)))
+              {
+                reception.sciSinr[k] = Sinr (txs, active, t, rx, subframe, true);
+              }
+            reception.sciBler[k] = m_ctrlErrorModel ? Bler (reception.sciSinr[k], true) : 0;
+          }
+        reception.pduSinr.assign (tx.pdus.size (), 0);
+        reception.pduBler.assign (tx.pdus.size (), 0);
+        for (uint32_t p = 0; p < tx.pdus.size (); p++)
+          {
+            for (uint32_t k = 0; k < 4; k++)
+              {
+                uint32_t subframe = tx.dataSubframes[p * 4 + k];
+                if (!self || !(TransmitsSci (*self, subframe) || TransmitsData (*self, subframe)))
+                  {
+                    reception.pduSinr[p] += Sinr (txs, active, t, rx, subframe, false);
+                  }
+              }
+            reception.pduBler[p] = m_dataErrorModel ? Bler (reception.pduSinr[p], false) : 0;
+          }
+      }
+  }
+
+  // the receptions of every active transmitter, on the workers if enabled
+  void ComputeReceptions (const std::vector<Transmitter> &txs, const std::vector<uint32_t> &active,
+                          std::vector<std::vector<Reception> > &receptions) const
+  {
+    uint32_t items = 0;
+    receptions.resize (active.size ());
+    for (uint32_t a = 0; a < active.size (); a++)
+      {
+        receptions[a].resize (txs[active[a]].receivers.size ());
+        items += receptions[a].size ();
+      }
+    uint32_t workers = std::min (m_workers, items);
+    if (workers <= 1)
+      {
+        for (uint32_t a = 0; a < active.size (); a++)
+          {
+            ComputeReceptions (txs, active, a, 0, receptions[a].size (), receptions[a].data ());
+          }
+        return;
+      }
+    // the w-th worker takes the items [w * items / workers, (w + 1) * items / workers)
+    std::vector<std::thread> threads;
+    for (uint32_t w = 0; w < workers; w++)
+      {
+        threads.push_back (std::thread ([&, w] ()
+          {
+            uint32_t begin = (uint64_t) w * items / workers;
+            uint32_t end = (uint64_t) (w + 1) * items / workers;
+            uint32_t base = 0;
+            for (uint32_t a = 0; a < active.size () && base < end; a++)
+              {
+                uint32_t n = receptions[a].size ();
+                if (base + n > begin)
+                  {
+                    ComputeReceptions (txs, active, a, std::max (begin, base) - base, std::min (end, base + n) - base,
+                                       receptions[a].data ());
+                  }
+                base += n;
+              }
+          }));
+      }
+    for (uint32_t w = 0; w < workers; w++)
+      {
+        threads[w].join ();
+      }
+  }
+
+  // the decoding draws and deliveries of the receptions of the t-th
+  // transmitter, in receiver order
+  void CommitReceptions (std::vector<Transmitter> &txs, uint32_t t, const std::vector<Reception> &receptions,
+                         Time periodStart, Ptr<SlDeliveryStats> stats)
+  {
+    Transmitter &tx = txs[t];
+    m_scis++;
+    m_pdus += tx.pdus.size ();
+    for (uint32_t r = 0; r < tx.receivers.size (); r++)
+      {
+        const Reception &reception = receptions[r];
+        bool sci = false;
+        for (uint32_t k = 0; k < 2 && !sci; k++)
+          {
+            sci = Decoded (reception.sciSinr[k], reception.sciBler[k], m_ctrlErrorModel);
+          }
+        for (uint32_t p = 0; p < tx.pdus.size (); p++)
+          {
+            bool pdu = sci && Decoded (reception.pduSinr[p], reception.pduBler[p], m_dataErrorModel);
+            Time end = periodStart + MilliSeconds (tx.dataSubframes[p * 4 + 3] + 1);
+            for (uint32_t s = 0; s < tx.pdus[p].size (); s++)
+              {
+                const Segment &segment = tx.pdus[p][s];
+                if (segment.first)
+                  {
+                    tx.packetOk[r] = true;
+                  }
+                tx.packetOk[r] = tx.packetOk[r] && pdu;
+                if (segment.last && tx.packetOk[r])
+                  {
+                    stats->NotifyRx (end - tx.arrivals[segment.packet]);
+                  }
+              }
+          }
+      }
+  }
+
+  Ptr<PropagationLossModel> m_lossModel;                          //!< The sidelink pathloss model.
+  double m_txPower;                                               //!< The UE transmit power (dBm).
+  double m_noiseFigure;                                           //!< The UE noise figure (dB).
+  uint32_t m_period;                                              //!< The sidelink period (subframes).
+  uint32_t m_pscchSubframes;                                      //!< The subframes of the PSCCH region.
+  uint32_t m_pscchPrbs;                                           //!< The PRBs of the PSCCH pool.
+  uint32_t m_dataPrbs;                                            //!< The PRBs of the PSSCH pool.
+  uint32_t m_rbSize;                                              //!< The PRBs of a PSSCH transmission.
+  uint32_t m_mcs;                                                 //!< The PSSCH MCS.
+  uint32_t m_ktrp;                                                //!< The T-RPT transmissions in 8 subframes.
+  bool m_ctrlErrorModel;                                          //!< Whether the PSCCH error model is enabled.
+  bool m_dataErrorModel;                                          //!< Whether the PSSCH error model is enabled.
+  bool m_dropOnCollision;                                         //!< Whether overlapping transmissions are lost.
+  uint32_t m_pktSize;                                             //!< The packet size (bytes).
+  Time m_pktInterval;                                             //!< The time between two packets.
+  uint32_t m_maxPackets;                                          //!< The packets of a transmitter.
+  double m_meanOn;                                                //!< The mean ON duration (s), 0 if always on.
+  double m_meanOff;                                               //!< The mean OFF duration (s).
+  Ptr<UniformRandomVariable> m_rnd;                               //!< The resource and decoding draws.
+  Ptr<ExponentialRandomVariable> m_onOffRnd;                      //!< The ON and OFF durations.
+  Ptr<SlBlerTable> m_blerTable;                                   //!< The BLER of the error model.
+  std::vector<Ptr<MobilityModel> > m_mobility;                    //!< The mobility of every UE.
+  std::unordered_map<const NetDevice *, uint32_t> m_ueIndex;      //!< The index of every UE.
+  std::unordered_map<uint64_t, double> m_rxPower;                 //!< The received power (dBm) of every link.
+  uint64_t m_scis;                                                //!< The SCIs sent.
+  uint64_t m_pdus;                                                //!< The PSSCH PDUs sent.
+  uint64_t m_periods;                                             //!< The periods with a transmission.
+  uint64_t m_idlePeriods;                                         //!< The periods skipped, without any.
+  uint32_t m_workers;                                             //!< The threads computing the receptions.
+};
+
+} // namespace ns3
+
+#endif /* ABSTRACT_SL_PHY_H */
@@ -0,0 +1,110 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Micro-benchmark of the sidelink error evaluation: the BLER of the same
+ * random SINRs (PSCCH, PSDCH and the PSSCH of an MCS) is computed by
+ * LteNistErrorModel directly and looked up in SlBlerTable; reports the
+ * cost per reception of both, the cost of building the table and of
+ * loading it from its cache file, and the largest BLER difference due to
+ * the grid.
+ *
+ * Build with the optimized profile:
+ * ./waf configure --build-profile=optimized
+ * ./waf --run "bler-table-bench --lookups=1000000 --mcs=10"
+ */
+
+#include "ns3/core-module.h"
+#include "sl-bler-table.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BlerTableBench");
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t lookups = 1000000;
+  uint32_t mcs = 10;
+  double stepDb = 0.01;
+  std::string cache = "bler-table-bench.bin";
+
+  CommandLine cmd;
+  cmd.AddValue ("lookups", "Number of receptions per channel", lookups);
+  cmd.AddValue ("mcs", "PSSCH MCS", mcs);
+  cmd.AddValue ("stepDb", "SINR step of the table (dB)", stepDb);
+  cmd.AddValue ("cache", "Cache file written and loaded back", cache);
+  cmd.Parse (argc, argv);
+
+  // the SINRs a receiver sees, around the knees of the curves
+  Ptr<UniformRandomVariable> rnd = CreateObject<UniformRandomVariable> ();
+  std::vector<double> sinrs (lookups);
+  for (uint32_t i = 0; i < lookups; ++i)
+    {
+      sinrs[i] = rnd->GetValue (-10, 30);
+    }
+
+  auto start = std::chrono::steady_clock::now ();
+  Ptr<SlBlerTable> table = Create<SlBlerTable> (-20, 40, stepDb);
+  table->Build (std::vector<uint32_t> (1, mcs));
+  double buildMs = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+  table->Save (cache);
+  start = std::chrono::steady_clock::now ();
+  Ptr<SlBlerTable> loaded = Create<SlBlerTable> (-20, 40, stepDb);
+  bool valid = loaded->Load (cache);
+  double loadMs = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+  std::remove (cache.c_str ());
+  NS_ABORT_MSG_UNLESS (valid, "The BLER table was not loaded back from " << cache);
+
+  std::cout << "lookups: " << lookups << "\tMCS: " << mcs << "\tstep: " << stepDb << " dB" << std::endl;
+  std::cout << "build: " << buildMs << " ms\tcache load: " << loadMs << " ms" << std::endl;
+  std::cout << "channel\tmodel(ns)\ttable(ns)\tspeedup\tmax error" << std::endl;
+  const char *names[] = {"PSCCH", "PSDCH", "PSSCH"};
+  double sink = 0;
+  for (uint32_t c = SlBlerTable::PSCCH; c <= SlBlerTable::PSSCH; ++c)
+    {
+      SlBlerTable::Channel channel = (SlBlerTable::Channel) c;
+      std::vector<double> modelOut (lookups);
+      std::vector<double> tableOut (lookups);
+
+      start = std::chrono::steady_clock::now ();
+      for (uint32_t i = 0; i < lookups; ++i)
+        {
+          modelOut[i] = SlBlerTable::ComputeBler (channel, mcs, sinrs[i]);
+        }
+      double modelNs = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+
+      start = std::chrono::steady_clock::now ();
+      for (uint32_t i = 0; i < lookups; ++i)
+        {
+          switch (channel)
+            {
+            case SlBlerTable::PSCCH:
+              tableOut[i] = loaded->GetPscchBler (sinrs[i]);
+              break;
+            case SlBlerTable::PSDCH:
+              tableOut[i] = loaded->GetPsdchBler (sinrs[i]);
+              break;
+            default:
+              tableOut[i] = loaded->GetPsschBler (mcs, sinrs[i]);
+            }
+        }
+      double tableNs = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+
+      double maxError = 0;
+      for (uint32_t i = 0; i < lookups; ++i)
+        {
+          maxError = std::max (maxError, std::fabs (modelOut[i] - tableOut[i]));
+          sink += tableOut[i];
+        }
+      std::cout << names[c] << "\t" << modelNs / lookups << "\t" << tableNs / lookups << "\t"
+                << modelNs / tableNs << "x\t" << maxError << std::endl;
+    }
+  std::cout << "checksum " << sink << std::endl;
+
+  return 0;
+}
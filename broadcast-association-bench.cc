@@ -0,0 +1,176 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Benchmark of the broadcast group association of wns3-2017-synch:
+ * LteSidelinkHelper::AssociateForBroadcast against the spatially indexed
+ * BroadcastAssociator, on the same 3GPP hexagonal deployment (Hybrid3gpp
+ * pathloss, isd, responders per sector) for 1 to 5 rings.
+ *
+ * The indexed pass is given the transmitters drawn by the helper, so the
+ * groups can be compared: for every ring count the wall time of both
+ * passes, the SL-RSRP computed by the indexed one, and the receivers it
+ * missed or added with respect to the helper (0 when the range bound
+ * holds) are reported. Every ring count runs in its own child process.
+ *
+ * ./waf --run "broadcast-association-bench --rings=1,2,3,4,5 --responders=10 --groups=50 --exponent=2"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/lte-module.h"
+
+#include "broadcast-associator.h"
+#include "simulation-profiler.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BroadcastAssociationBench");
+
+//deploy the rings, associate with both passes, then print the result line
+void
+RunAssociation (uint32_t numRings, double isd, uint32_t respondersPerSector, uint32_t numGroups, double exponent, double rsrpThreshold)
+{
+  double ueTxPower = 31.0;
+  Config::SetDefault ("ns3::LteEnbNetDevice::UlEarfcn", UintegerValue (23330));
+  Config::SetDefault ("ns3::LteEnbNetDevice::UlBandwidth", UintegerValue (50));
+  Config::SetDefault ("ns3::LteUePhy::TxPower", DoubleValue (ueTxPower));
+
+  Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
+  Ptr<PointToPointEpcHelper> epcHelper = CreateObject<PointToPointEpcHelper> ();
+  lteHelper->SetEpcHelper (epcHelper);
+  Ptr<LteSidelinkHelper> proseHelper = CreateObject<LteSidelinkHelper> ();
+  proseHelper->SetLteHelper (lteHelper);
+  Ptr<Lte3gppHexGridEnbTopologyHelper> topoHelper = CreateObject<Lte3gppHexGridEnbTopologyHelper> ();
+  topoHelper->SetLteHelper (lteHelper);
+  int64_t randomStream = 1;
+  randomStream += topoHelper->AssignStreams (randomStream);
+
+  lteHelper->DisableEnbPhy (true);
+  lteHelper->SetEnbAntennaModelType ("ns3::Parabolic3dAntennaModel");
+  lteHelper->SetEnbAntennaModelAttribute ("MechanicalTilt", DoubleValue (15));
+  lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Hybrid3gppPropagationLossModel"));
+
+  topoHelper->SetNumRings (numRings);
+  topoHelper->SetInterSiteDistance (isd);
+  topoHelper->SetMinimumDistance (10);
+  topoHelper->SetSiteHeight (32);
+  NodeContainer sectorNodes;
+  sectorNodes.Create (topoHelper->GetNumNodes ());
+  MobilityHelper mobilityeNodeB;
+  mobilityeNodeB.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobilityeNodeB.Install (sectorNodes);
+  NetDeviceContainer enbDevs = topoHelper->SetPositionAndInstallEnbDevice (sectorNodes);
+
+  NodeContainer ueResponders;
+  ueResponders.Create (respondersPerSector * sectorNodes.GetN ());
+  MobilityHelper mobilityResponders;
+  mobilityResponders.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobilityResponders.Install (ueResponders);
+  lteHelper->SetAttribute ("UseSidelink", BooleanValue (true));
+  NetDeviceContainer ueDevs = topoHelper->DropUEsUniformlyPerSector (ueResponders);
+  randomStream += lteHelper->AssignStreams (ueDevs, randomStream);
+
+  double ulEarfcn = enbDevs.Get (0)->GetObject<LteEnbNetDevice> ()->GetUlEarfcn ();
+  double ulBandwidth = enbDevs.Get (0)->GetObject<LteEnbNetDevice> ()->GetUlBandwidth ();
+
+  SimulationProfiler helperTime;
+  helperTime.Start ();
+  std::vector<NetDeviceContainer> helperGroups = proseHelper->AssociateForBroadcast (ueTxPower, ulEarfcn, ulBandwidth, ueDevs, rsrpThreshold,
+                                                                                     numGroups, LteSidelinkHelper::SLRSRP_PSBCH);
+  helperTime.Stop ();
+
+  NetDeviceContainer transmitters;
+  for (uint32_t g = 0; g < helperGroups.size (); g++)
+    {
+      transmitters.Add (helperGroups[g].Get (0));
+    }
+  Ptr<BroadcastAssociator> associator = Create<BroadcastAssociator> (lteHelper, proseHelper);
+  associator->SetRangeBound (exponent);
+  SimulationProfiler indexedTime;
+  indexedTime.Start ();
+  std::vector<NetDeviceContainer> indexedGroups = associator->AssociateTransmitters (ueTxPower, ulEarfcn, ulBandwidth, ueDevs, rsrpThreshold,
+                                                                                     transmitters, LteSidelinkHelper::SLRSRP_PSBCH);
+  indexedTime.Stop ();
+
+  uint32_t receivers = 0;
+  uint32_t missed = 0;
+  uint32_t added = 0;
+  for (uint32_t g = 0; g < helperGroups.size (); g++)
+    {
+      std::set<Ptr<NetDevice> > expected (helperGroups[g].Begin () + 1, helperGroups[g].End ());
+      std::set<Ptr<NetDevice> > found (indexedGroups[g].Begin () + 1, indexedGroups[g].End ());
+      receivers += expected.size ();
+      for (std::set<Ptr<NetDevice> >::const_iterator it = expected.begin (); it != expected.end (); ++it)
+        {
+          missed += !found.count (*it);
+        }
+      for (std::set<Ptr<NetDevice> >::const_iterator it = found.begin (); it != found.end (); ++it)
+        {
+          added += !expected.count (*it);
+        }
+    }
+  Simulator::Destroy ();
+
+  std::cout << numRings << "\t" << ueDevs.GetN () << "\t" << helperGroups.size () << "\t" << receivers << "\t"
+            << helperTime.GetWallTime () << "\t" << indexedTime.GetWallTime () << "\t"
+            << helperTime.GetWallTime () / indexedTime.GetWallTime () << "\t"
+            << associator->GetEvaluations () << "\t" << missed << "\t" << added << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string rings = "1,2,3,4,5";
+  double isd = 500;
+  uint32_t responders = 10;
+  uint32_t groups = 50;
+  double exponent = 2;
+  double rsrpThreshold = -112;
+
+  CommandLine cmd;
+  cmd.AddValue ("rings", "Comma-separated numbers of rings to deploy", rings);
+  cmd.AddValue ("isd", "Inter Site Distance", isd);
+  cmd.AddValue ("responders", "Number of UEs per sector", responders);
+  cmd.AddValue ("groups", "Number of groups", groups);
+  cmd.AddValue ("exponent", "Path loss exponent bounding the range of the indexed pass", exponent);
+  cmd.AddValue ("rsrpThreshold", "SL-RSRP (dBm) a receiver must reach", rsrpThreshold);
+  cmd.Parse (argc, argv);
+
+  std::vector<uint32_t> ringCounts;
+  std::istringstream items (rings);
+  std::string item;
+  while (std::getline (items, item, ','))
+    {
+      std::istringstream is (item);
+      uint32_t count;
+      NS_ABORT_MSG_UNLESS ((is >> count) && is.eof (), "Bad ring count '" << item << "'");
+      ringCounts.push_back (count);
+    }
+
+  std::cout << "rings\tUEs\tgroups\treceivers\thelper(s)\tindexed(s)\tspeedup\tevaluations\tmissed\tadded" << std::endl;
+  for (uint32_t r = 0; r < ringCounts.size (); r++)
+    {
+      std::cout.flush ();
+      pid_t pid = fork ();
+      NS_ABORT_MSG_IF (pid < 0, "fork failed");
+      if (pid == 0)
+        {
+          RunAssociation (ringCounts[r], isd, responders, groups, exponent, rsrpThreshold);
+          std::cout.flush ();
+          _exit (0);
+        }
+      int status;
+      waitpid (pid, &status, 0);
+      NS_ABORT_MSG_UNLESS (WIFEXITED (status) && WEXITSTATUS (status) == 0, "Run with " << ringCounts[r] << " rings failed");
+    }
+
+  return 0;
+}
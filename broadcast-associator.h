@@ -0,0 +1,227 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Spatially indexed counterpart of LteSidelinkHelper::AssociateForBroadcast
+ * for large deployments (e.g. wns3-2017-synch with many rings).
+ *
+ * Groups are formed as by the helper: a transmitter is drawn at random
+ * among the UEs not yet transmitting, and every other UE whose SL-RSRP
+ * from it is at least the threshold joins its group. Instead of computing
+ * the SL-RSRP from the transmitter to every UE, only the UEs in the grid
+ * cells within range are evaluated. The range is where the SL-RSRP falls
+ * under the threshold even for a loss bounded from below by free space at
+ * 1 m then a path loss exponent (SetRangeBound), i.e.
+ *
+ *   rsrp <= txPower (- 10 log10 (72) for PSBCH) + maxAntennaGain - loss (d)
+ *
+ * The bound is exact when the exponent is the lowest slope of the
+ * propagation loss model; a higher exponent trades missed receivers for
+ * speed. The SL-RSRP itself is computed by the helper, so the groups are
+ * the helper's for the same transmitters (AssociateTransmitters).
+ */
+
+#ifndef BROADCAST_ASSOCIATOR_H
+#define BROADCAST_ASSOCIATOR_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/lte-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+class BroadcastAssociator : public SimpleRefCount<BroadcastAssociator>
+{
+public:
+  /**
+   * \param lteHelper The LTE helper, whose uplink pathloss model is used.
+   * \param proseHelper The sidelink helper, which computes the SL-RSRP.
+   */
+  BroadcastAssociator (Ptr<LteHelper> lteHelper, Ptr<LteSidelinkHelper> proseHelper)
+    : m_lteHelper (lteHelper),
+      m_proseHelper (proseHelper),
+      m_lossExponent (2),
+      m_maxAntennaGain (0),
+      m_evaluations (0)
+  {
+    m_rnd = CreateObject<UniformRandomVariable> ();
+  }
+
+  /**
+   * \param lossExponent The lowest path loss exponent of the pathloss
+   *                     model, beyond 1 m (2 for free space).
+   * \param maxAntennaGain The highest sum of the tx and rx antenna gains (dB).
+   */
+  void SetRangeBound (double lossExponent, double maxAntennaGain = 0)
+  {
+    NS_ABORT_MSG_IF (lossExponent < 1, "Bad path loss exponent " << lossExponent);
+    m_lossExponent = lossExponent;
+    m_maxAntennaGain = maxAntennaGain;
+  }
+
+  /**
+   * \param stream The first stream of the transmitter draws.
+   * \return The number of streams used.
+   */
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_rnd->SetStream (stream);
+    return 1;
+  }
+
+  /**
+   * Form nGroups groups, or fewer if there are not enough UEs, as
+   * LteSidelinkHelper::AssociateForBroadcast.
+   * \param txPower The transmit power (dBm).
+   * \param ulEarfcn The uplink EARFCN of the sidelink.
+   * \param ulBandwidth The uplink bandwidth (RBs).
+   * \param ues The UE devices.
+   * \param rsrpThreshold The SL-RSRP (dBm) a receiver must reach.
+   * \param nGroups The number of groups (transmitters).
+   * \param method How the SL-RSRP is computed.
+   * \return The groups, transmitter first.
+   */
+  std::vector<NetDeviceContainer> Associate (double txPower, double ulEarfcn, double ulBandwidth, NetDeviceContainer ues,
+                                             double rsrpThreshold, uint32_t nGroups, LteSidelinkHelper::SrsrpMethod_t method)
+  {
+    std::vector<uint32_t> remaining (ues.GetN ());
+    for (uint32_t i = 0; i < remaining.size (); i++)
+      {
+        remaining[i] = i;
+      }
+    NetDeviceContainer transmitters;
+    while (transmitters.GetN () < nGroups && !remaining.empty ())
+      {
+        uint32_t index = m_rnd->GetInteger (0, remaining.size () - 1);
+        transmitters.Add (ues.Get (remaining[index]));
+        remaining.erase (remaining.begin () + index);
+      }
+    return AssociateTransmitters (txPower, ulEarfcn, ulBandwidth, ues, rsrpThreshold, transmitters, method);
+  }
+
+  /**
+   * Form the group of each given transmitter.
+   * \param txPower The transmit power (dBm).
+   * \param ulEarfcn The uplink EARFCN of the sidelink.
+   * \param ulBandwidth The uplink bandwidth (RBs).
+   * \param ues The UE devices.
+   * \param rsrpThreshold The SL-RSRP (dBm) a receiver must reach.
+   * \param transmitters The transmitters, among ues.
+   * \param method How the SL-RSRP is computed.
+   * \return The groups, transmitter first.
+   */
+  std::vector<NetDeviceContainer> AssociateTransmitters (double txPower, double ulEarfcn, double ulBandwidth, NetDeviceContainer ues,
+                                                         double rsrpThreshold, NetDeviceContainer transmitters,
+                                                         LteSidelinkHelper::SrsrpMethod_t method)
+  {
+    Ptr<PropagationLossModel> lossModel = m_lteHelper->GetUplinkPathlossModel ()->GetObject<PropagationLossModel> ();
+    NS_ABORT_MSG_IF (lossModel == 0, "No PathLossModel");
+    double range = GetRange (txPower, ulEarfcn, rsrpThreshold, method);
+
+    // index the UEs in cells of the range
+    std::unordered_map<int64_t, std::vector<uint32_t> > cells;
+    std::vector<Vector> positions (ues.GetN ());
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        positions[i] = ues.Get (i)->GetNode ()->GetObject<MobilityModel> ()->GetPosition ();
+        int64_t x = std::floor (positions[i].x / range);
+        int64_t y = std::floor (positions[i].y / range);
+        cells[CellKey (x, y)].push_back (i);
+      }
+    std::unordered_map<const NetDevice *, uint32_t> indexes;
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        indexes[PeekPointer (ues.Get (i))] = i;
+      }
+
+    m_evaluations = 0;
+    std::vector<NetDeviceContainer> groups;
+    for (uint32_t t = 0; t < transmitters.GetN (); t++)
+      {
+        Ptr<NetDevice> tx = transmitters.Get (t);
+        std::unordered_map<const NetDevice *, uint32_t>::const_iterator txIndex = indexes.find (PeekPointer (tx));
+        NS_ABORT_MSG_IF (txIndex == indexes.end (), "Transmitter not among the UEs");
+        const Vector &txPosition = positions[txIndex->second];
+        // the candidates, in the order of ues as the helper
+        std::vector<uint32_t> candidates;
+        int64_t cx = std::floor (txPosition.x / range);
+        int64_t cy = std::floor (txPosition.y / range);
+        for (int64_t x = cx - 1; x <= cx + 1; x++)
+          {
+            for (int64_t y = cy - 1; y <= cy + 1; y++)
+              {
+                std::unordered_map<int64_t, std::vector<uint32_t> >::const_iterator cell = cells.find (CellKey (x, y));
+                if (cell != cells.end ())
+                  {
+                    candidates.insert (candidates.end (), cell->second.begin (), cell->second.end ());
+                  }
+              }
+          }
+        std::sort (candidates.begin (), candidates.end ());
+
+        NetDeviceContainer group (tx);
+        for (uint32_t c = 0; c < candidates.size (); c++)
+          {
+            Ptr<NetDevice> rx = ues.Get (candidates[c]);
+            if (rx == tx || CalculateDistance (positions[candidates[c]], txPosition) > range)
+              {
+                continue;
+              }
+            m_evaluations++;
+            double rsrp = method == LteSidelinkHelper::SLRSRP_PSBCH
+              ? m_proseHelper->CalcSlRsrpPsbch (lossModel, txPower, ulEarfcn, ulBandwidth, tx, rx)
+              : m_proseHelper->CalcSlRsrpTxPw (lossModel, txPower, ulEarfcn, ulBandwidth, tx, rx);
+            if (rsrp >= rsrpThreshold)
+              {
+                group.Add (rx);
+              }
+          }
+        groups.push_back (group);
+      }
+    return groups;
+  }
+
+  /**
+   * \return The number of SL-RSRP computed by the last association.
+   */
+  uint64_t GetEvaluations (void) const
+  {
+    return m_evaluations;
+  }
+
+  /**
+   * \param txPower The transmit power (dBm).
+   * \param ulEarfcn The uplink EARFCN of the sidelink.
+   * \param rsrpThreshold The SL-RSRP (dBm) a receiver must reach.
+   * \param method How the SL-RSRP is computed.
+   * \return The distance (m) beyond which no UE reaches the threshold.
+   */
+  double GetRange (double txPower, double ulEarfcn, double rsrpThreshold, LteSidelinkHelper::SrsrpMethod_t method) const
+  {
+    double maxRsrp = txPower + m_maxAntennaGain - (method == LteSidelinkHelper::SLRSRP_PSBCH ? 10 * std::log10 (72.0) : 0);
+    double frequency = LteSpectrumValueHelper::GetCarrierFrequency (ulEarfcn);
+    double lossAt1mDb = 20 * std::log10 (4 * M_PI * frequency / 299792458.0);
+    return std::max (1.0, std::pow (10.0, (maxRsrp - rsrpThreshold - lossAt1mDb) / (10 * m_lossExponent)));
+  }
+
+private:
+  static int64_t CellKey (int64_t x, int64_t y)
+  {
+    return (x << 32) ^ (y & 0xffffffff);
+  }
+
+  Ptr<LteHelper> m_lteHelper;                 //!< The LTE helper.
+  Ptr<LteSidelinkHelper> m_proseHelper;       //!< The sidelink helper.
+  Ptr<UniformRandomVariable> m_rnd;           //!< The transmitter draws.
+  double m_lossExponent;                      //!< The lowest path loss exponent.
+  double m_maxAntennaGain;                    //!< The highest tx plus rx antenna gain (dB).
+  uint64_t m_evaluations;                     //!< The SL-RSRP computed by the last association.
+};
+
+} // namespace ns3
+
+#endif /* BROADCAST_ASSOCIATOR_H */
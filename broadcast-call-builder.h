@@ -0,0 +1,289 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Wiring of out-of-coverage MCPTT broadcast group calls for any number of
+ * groups and users per group.
+ *
+ * The applications are split into consecutive groups of usersPerGroup UEs.
+ * For every UE the builder creates the call (McpttCallMachineGrpBroadcast
+ * and McpttFloorMachineBasic by default) and configures the call machine
+ * of that UE's own call: call ID, group ID, originating user (the first UE
+ * of the group), SDP, call type and priority. Every group gets its own
+ * call ID, group ID and floor/speech ports.
+ *
+ * The builder also schedules, for every call, the start and stop of the
+ * TFB timers (TFB1 and TFB2 for the originating UE, TFB1 for the others)
+ * and the opening of the floor and media channels.
+ *
+ * Groups may also have listenersPerGroup passive listeners
+ * (passive-listener.h), given apart from the talkers: their calls are
+ * configured alike and their channels opened, but no TFB timer is
+ * scheduled; the call machine starts TFB1 on receiving the call.
+ */
+
+#ifndef BROADCAST_CALL_BUILDER_H
+#define BROADCAST_CALL_BUILDER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/psc-module.h"
+
+#include <ns3/mcptt-call-machine-grp-broadcast.h>
+#include <ns3/mcptt-call-msg-field.h>
+#include <ns3/mcptt-ptt-app.h>
+#include <ns3/mcptt-timer.h>
+
+#include <vector>
+
+namespace ns3 {
+
+class BroadcastCallBuilder : public SimpleRefCount<BroadcastCallBuilder>
+{
+public:
+  /**
+   * One broadcast group and its calls.
+   */
+  struct Group
+  {
+    uint32_t grpId;                    //!< The group ID.
+    uint16_t callId;                   //!< The call ID.
+    uint32_t origId;                   //!< The originating MCPTT user ID.
+    McpttCallMsgFieldSdp sdp;          //!< The SDP of the call.
+    ApplicationContainer apps;         //!< The McpttPttApp of every member.
+    std::vector<Ptr<McpttCall> > calls; //!< The call of every member.
+    ApplicationContainer listeners;    //!< The McpttPttApp of every passive listener.
+    std::vector<Ptr<McpttCall> > listenerCalls; //!< The call of every passive listener.
+  };
+
+  BroadcastCallBuilder (void)
+    : m_usersPerGroup (3),
+      m_listenersPerGroup (0),
+      m_firstGrpId (1),
+      m_firstCallId (1),
+      m_grpAddress (Ipv4Address::GetAny ()),
+      m_delayTfb1 (Seconds (10)),
+      m_delayTfb2 (Seconds (5)),
+      m_delayTfb3 (Seconds (5)),
+      m_timerStart (Seconds (2.1)),
+      m_chanOpen (Seconds (2.15)),
+      m_callEnd (Seconds (5.25))
+  {
+    m_callFac.SetTypeId ("ns3::McpttCallMachineGrpBroadcast");
+    m_floorFac.SetTypeId ("ns3::McpttFloorMachineBasic");
+  }
+
+  /**
+   * \param callFac The factory of the call machines.
+   * \param floorFac The factory of the floor machines.
+   */
+  void SetFactories (ObjectFactory callFac, ObjectFactory floorFac)
+  {
+    m_callFac = callFac;
+    m_floorFac = floorFac;
+  }
+
+  /**
+   * \param usersPerGroup The number of UEs in a group.
+   */
+  void SetUsersPerGroup (uint32_t usersPerGroup)
+  {
+    NS_ABORT_MSG_IF (usersPerGroup == 0, "Empty broadcast group");
+    m_usersPerGroup = usersPerGroup;
+  }
+
+  /**
+   * \param listenersPerGroup The number of passive listeners in a group.
+   */
+  void SetListenersPerGroup (uint32_t listenersPerGroup)
+  {
+    m_listenersPerGroup = listenersPerGroup;
+  }
+
+  /**
+   * \param grpId The group ID of the first group; the next groups follow.
+   * \param callId The call ID of the first group; the next groups follow.
+   */
+  void SetFirstIds (uint32_t grpId, uint16_t callId)
+  {
+    m_firstGrpId = grpId;
+    m_firstCallId = callId;
+  }
+
+  /**
+   * \param grpAddress The group address put in the SDP and used to open
+   *                   the floor and media channels.
+   */
+  void SetGrpAddress (Ipv4Address grpAddress)
+  {
+    m_grpAddress = grpAddress;
+  }
+
+  /**
+   * \param tfb1 The TFB1 delay.
+   * \param tfb2 The TFB2 delay.
+   * \param tfb3 The TFB3 delay.
+   */
+  void SetTimerDelays (Time tfb1, Time tfb2, Time tfb3)
+  {
+    m_delayTfb1 = tfb1;
+    m_delayTfb2 = tfb2;
+    m_delayTfb3 = tfb3;
+  }
+
+  /**
+   * \param timerStart The time the TFB timers are started.
+   * \param chanOpen The time the floor and media channels are opened.
+   * \param callEnd The time the TFB timers are stopped.
+   */
+  void SetSchedule (Time timerStart, Time chanOpen, Time callEnd)
+  {
+    m_timerStart = timerStart;
+    m_chanOpen = chanOpen;
+    m_callEnd = callEnd;
+  }
+
+  /**
+   * Create, configure and schedule the calls of all the applications.
+   * \param apps The McpttPttApp applications, a multiple of usersPerGroup.
+   * \param listeners The McpttPttApp applications of the passive
+   *                  listeners, listenersPerGroup per group.
+   * \return The number of groups.
+   */
+  uint32_t Build (ApplicationContainer apps, ApplicationContainer listeners = ApplicationContainer ())
+  {
+    NS_ABORT_MSG_IF (apps.GetN () % m_usersPerGroup != 0,
+                     apps.GetN () << " UEs do not make groups of " << m_usersPerGroup);
+    uint32_t nGroups = apps.GetN () / m_usersPerGroup;
+    NS_ABORT_MSG_IF (listeners.GetN () != nGroups * m_listenersPerGroup,
+                     listeners.GetN () << " listeners do not make " << nGroups << " groups of " << m_listenersPerGroup);
+    uint32_t first = m_groups.size ();
+    m_groups.resize (first + nGroups);
+    for (uint32_t g = first; g < m_groups.size (); g++)
+      {
+        Group &group = m_groups[g];
+        group.grpId = m_firstGrpId + g;
+        group.callId = m_firstCallId + g;
+        group.sdp.SetFloorPort (McpttPttApp::AllocateNextPortNumber ());
+        group.sdp.SetGrpAddr (m_grpAddress);
+        group.sdp.SetSpeechPort (McpttPttApp::AllocateNextPortNumber ());
+        for (uint32_t u = 0; u < m_usersPerGroup; u++)
+          {
+            Ptr<McpttPttApp> pttApp = DynamicCast<McpttPttApp, Application> (apps.Get ((g - first) * m_usersPerGroup + u));
+            NS_ABORT_MSG_IF (pttApp == 0, "Application is not a McpttPttApp");
+            if (u == 0)
+              {
+                group.origId = pttApp->GetUserId ();
+              }
+            group.apps.Add (pttApp);
+            group.calls.push_back (AddCall (group, pttApp, u == 0 ? ORIGINATOR : TALKER));
+          }
+        for (uint32_t l = 0; l < m_listenersPerGroup; l++)
+          {
+            Ptr<McpttPttApp> pttApp = DynamicCast<McpttPttApp, Application> (listeners.Get ((g - first) * m_listenersPerGroup + l));
+            NS_ABORT_MSG_IF (pttApp == 0, "Listener application is not a McpttPttApp");
+            group.listeners.Add (pttApp);
+            group.listenerCalls.push_back (AddCall (group, pttApp, LISTENER));
+          }
+      }
+    return m_groups.size () - first;
+  }
+
+  /**
+   * \return The number of groups built.
+   */
+  uint32_t GetNGroups (void) const
+  {
+    return m_groups.size ();
+  }
+
+  /**
+   * \param g The group index.
+   * \return The group.
+   */
+  const Group &GetGroup (uint32_t g) const
+  {
+    NS_ABORT_MSG_IF (g >= m_groups.size (), "No broadcast group " << g);
+    return m_groups[g];
+  }
+
+private:
+  enum Role
+  {
+    ORIGINATOR,   //!< The first UE of the group.
+    TALKER,       //!< Another UE that may take the floor.
+    LISTENER      //!< A passive listener.
+  };
+
+  Ptr<McpttCall> AddCall (const Group &group, Ptr<McpttPttApp> pttApp, Role role)
+  {
+    pttApp->CreateCall (m_callFac, m_floorFac);
+    pttApp->SelectLastCall ();
+    Ptr<McpttCall> call = pttApp->GetSelectedCall ();
+    Ptr<McpttCallMachineGrpBroadcast> machine = DynamicCast<McpttCallMachineGrpBroadcast, McpttCallMachine> (call->GetCallMachine ());
+    NS_ABORT_MSG_IF (machine == 0, "Call machine is not a McpttCallMachineGrpBroadcast");
+
+    machine->SetCallId (group.callId);
+    machine->SetGrpId (group.grpId);
+    machine->SetOrigId (group.origId);
+    machine->SetSdp (group.sdp);
+    machine->SetCallType (McpttCallMsgFieldCallType::BROADCAST_GROUP);
+    machine->SetPriority (McpttCallMsgFieldCallType::GetCallTypePriority (McpttCallMsgFieldCallType::BROADCAST_GROUP));
+    machine->SetDelayTfb1 (m_delayTfb1);
+    machine->SetDelayTfb2 (m_delayTfb2);
+    machine->SetDelayTfb3 (m_delayTfb3);
+
+    if (role != LISTENER)
+      {
+        ScheduleTimer (machine->GetTfb1 ());
+      }
+    if (role == ORIGINATOR)
+      {
+        ScheduleTimer (machine->GetTfb2 ());
+      }
+    Simulator::Schedule (m_chanOpen, &McpttCall::OpenFloorChan, call, m_grpAddress, group.sdp.GetFloorPort ());
+    Simulator::Schedule (m_chanOpen, &McpttCall::OpenMediaChan, call, m_grpAddress, group.sdp.GetSpeechPort ());
+    return call;
+  }
+
+  void ScheduleTimer (Ptr<McpttTimer> timer)
+  {
+    Simulator::Schedule (m_timerStart, &BroadcastCallBuilder::StartTimer, timer);
+    Simulator::Schedule (m_callEnd, &BroadcastCallBuilder::StopTimer, timer);
+  }
+
+  // the call machine may have started or stopped the timer itself by then
+  static void StartTimer (Ptr<McpttTimer> timer)
+  {
+    if (!timer->IsRunning ())
+      {
+        timer->Start ();
+      }
+  }
+
+  static void StopTimer (Ptr<McpttTimer> timer)
+  {
+    if (timer->IsRunning ())
+      {
+        timer->Stop ();
+      }
+  }
+
+  ObjectFactory m_callFac;         //!< The call machine factory.
+  ObjectFactory m_floorFac;        //!< The floor machine factory.
+  uint32_t m_usersPerGroup;        //!< The number of UEs in a group.
+  uint32_t m_listenersPerGroup;    //!< The number of passive listeners in a group.
+  uint32_t m_firstGrpId;           //!< The group ID of the first group.
+  uint16_t m_firstCallId;          //!< The call ID of the first group.
+  Ipv4Address m_grpAddress;        //!< The group address.
+  Time m_delayTfb1;                //!< The TFB1 delay.
+  Time m_delayTfb2;                //!< The TFB2 delay.
+  Time m_delayTfb3;                //!< The TFB3 delay.
+  Time m_timerStart;               //!< The time the TFB timers start.
+  Time m_chanOpen;                 //!< The time the channels are opened.
+  Time m_callEnd;                  //!< The time the TFB timers stop.
+  std::vector<Group> m_groups;     //!< The groups built.
+};
+
+} // namespace ns3
+
+#endif /* BROADCAST_CALL_BUILDER_H */
@@ -0,0 +1,330 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Scaling benchmark of out-of-coverage MCPTT broadcast group calls, for an
+ * increasing number of UEs. It shares the BroadcastCallBuilder wiring and
+ * the relay election (T_cycle and hearing delay) of broadcast_20, but
+ * unlike broadcast_20 it installs the LTE UE devices: one sidelink pool
+ * (sf40, 8 PSCCH subframes), no discovery, a BIDIRECTIONAL bearer to the
+ * broadcast address and the Cost231 pathloss model. The numbers describe
+ * this LTE sidelink setup, not the device-less broadcast_20 runs.
+ *
+ * Every UE count is simulated in its own child process, so that each run
+ * starts from an empty simulator and node list and its peak RSS is its own.
+ * For every run the wall time, events processed and peak RSS are reported.
+ * The UEs are dropped at random in a square whose area grows with their
+ * number (areaPerUe).
+ *
+ * Every group may also get listenersPerGroup listeners, on top of the UE
+ * count. Every UE count is then run twice: with the passive-listener
+ * profile (passive-listener.h) and, as the baseline, with the listeners
+ * installed as talkers (sidelink configuration, BIDIRECTIONAL bearer and
+ * McpttPttApp of the talkers), which is the cost of a large audience
+ * without the profile. For example for 5000 listeners:
+ *
+ * With earlyStop a run ends once every member and listener of every group
+ * received the GROUP CALL BROADCAST END of its call (TerminationController),
+ * instead of at simTime; end(s) is the simulated time the run ended at.
+ *
+ * ./waf --run "broadcast-scaling-bench --ueCounts=10,100,1000 --usersPerGroup=10"
+ * ./waf --run "broadcast-scaling-bench --ueCounts=100 --usersPerGroup=10 --listenersPerGroup=500"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/psc-module.h"
+
+#include <ns3/mcptt-ptt-app.h>
+#include "relay-election.h"
+#include "broadcast-call-builder.h"
+#include "passive-listener.h"
+#include "simulation-profiler.h"
+#include "termination-controller.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BroadcastScalingBench");
+
+//early termination: the receivers of the GROUP CALL BROADCAST END of every group
+struct BroadcastEndProgress : public SimpleRefCount<BroadcastEndProgress>
+{
+  std::vector<uint16_t> callIds;
+  std::vector<uint32_t> expected; //members and listeners but the one ending the call
+  std::vector<std::set<Ptr<const Application> > > received;
+};
+
+void
+BroadcastEndRxTrace (Ptr<BroadcastEndProgress> progress, uint32_t group, Ptr<const Application> app, uint16_t callId, const Header& msg)
+{
+  if (callId == progress->callIds[group] && msg.GetInstanceTypeId () == McpttCallMsgGrpBroadcastEnd::GetTypeId ())
+    {
+      progress->received[group].insert (app);
+    }
+}
+
+bool
+AllBroadcastsEnded (Ptr<BroadcastEndProgress> progress)
+{
+  for (uint32_t g = 0; g < progress->expected.size (); g++)
+    {
+      if (progress->received[g].size () < progress->expected[g])
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+//build and run the scenario with ueCount UEs and their listeners, then print its result line
+void
+RunScenario (uint32_t ueCount, uint32_t usersPerGroup, uint32_t listenersPerGroup, bool fullListeners,
+             double areaPerUe, Time simTime, bool earlyStop)
+{
+  Config::SetDefault ("ns3::LteUeMac::SlGrantMcs", UintegerValue (8));
+  Config::SetDefault ("ns3::LteUeMac::SlGrantSize", UintegerValue (5));
+  Config::SetDefault ("ns3::LteUeMac::Ktrp", UintegerValue (1));
+  Config::SetDefault ("ns3::LteUeMac::UseSetTrp", BooleanValue (true));
+  Config::SetDefault ("ns3::RrSlFfMacScheduler::Itrp", UintegerValue (0));
+  Config::SetDefault ("ns3::LteSpectrumPhy::SlCtrlErrorModelEnabled", BooleanValue (true));
+  Config::SetDefault ("ns3::LteSpectrumPhy::SlDataErrorModelEnabled", BooleanValue (true));
+  Config::SetDefault ("ns3::LteSpectrumPhy::DropRbOnCollisionEnabled", BooleanValue (true));
+  Config::SetDefault ("ns3::LteUePhy::TxPower", DoubleValue (23.0));
+
+  uint32_t ulEarfcn = 18100;
+  uint16_t ulBandwidth = 50;
+  uint32_t listenerCount = ueCount / usersPerGroup * listenersPerGroup;
+  double side = std::sqrt (areaPerUe * (ueCount + listenerCount));
+
+  NodeContainer nodes;
+  nodes.Create (ueCount);
+  NodeContainer listenerNodes;
+  listenerNodes.Create (listenerCount);
+
+  Ptr<RandomBoxPositionAllocator> positionAlloc = CreateObject <RandomBoxPositionAllocator> ();
+  positionAlloc->SetX (CreateObjectWithAttributes<UniformRandomVariable> ("Min", DoubleValue (0.0), "Max", DoubleValue (side)));
+  positionAlloc->SetY (CreateObjectWithAttributes<UniformRandomVariable> ("Min", DoubleValue (0.0), "Max", DoubleValue (side)));
+  positionAlloc->SetZ (CreateObjectWithAttributes<ConstantRandomVariable> ("Constant", DoubleValue (1.5)));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positionAlloc);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+  mobility.Install (listenerNodes);
+
+  Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
+  Ptr<LteSidelinkHelper> proseHelper = CreateObject<LteSidelinkHelper> ();
+  proseHelper->SetLteHelper (lteHelper);
+  Config::SetDefault ("ns3::LteSlBasicUeController::ProseHelper", PointerValue (proseHelper));
+  lteHelper->SetAttribute ("UseSidelink", BooleanValue (true));
+  lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Cost231PropagationLossModel"));
+  lteHelper->Initialize ();
+
+  // Since we are not installing eNB, we need to set the frequency attribute of pathloss model here
+  double ulFreq = LteSpectrumValueHelper::GetCarrierFrequency (ulEarfcn);
+  Ptr<Object> uplinkPathlossModel = lteHelper->GetUplinkPathlossModel ();
+  NS_ABORT_MSG_IF (uplinkPathlossModel->GetObject<PropagationLossModel> () == 0, "No PathLossModel");
+  uplinkPathlossModel->SetAttributeFailSafe ("Frequency", DoubleValue (ulFreq));
+
+  NetDeviceContainer devices = lteHelper->InstallUeDevice (nodes);
+  NetDeviceContainer listenerDevices = lteHelper->InstallUeDevice (listenerNodes);
+
+  Ptr<LteSlUeRrc> ueSidelinkConfiguration = CreateObject<LteSlUeRrc> ();
+  ueSidelinkConfiguration->SetSlEnabled (true);
+  LteRrcSap::SlPreconfiguration preconfiguration;
+  preconfiguration.preconfigGeneral.carrierFreq = ulEarfcn;
+  preconfiguration.preconfigGeneral.slBandwidth = ulBandwidth;
+  preconfiguration.preconfigComm.nbPools = 1;
+  LteSlPreconfigPoolFactory pfactory;
+  pfactory.SetControlPeriod ("sf40");
+  pfactory.SetControlBitmap (0x00000000FF); //8 subframes for PSCCH
+  pfactory.SetControlOffset (0);
+  pfactory.SetControlPrbNum (22);
+  pfactory.SetControlPrbStart (0);
+  pfactory.SetControlPrbEnd (49);
+  pfactory.SetDataBitmap (0xFFFFFFFFFF);
+  pfactory.SetDataOffset (8); //After 8 subframes of PSCCH
+  pfactory.SetDataPrbNum (25);
+  pfactory.SetDataPrbStart (0);
+  pfactory.SetDataPrbEnd (49);
+  preconfiguration.preconfigComm.pools[0] = pfactory.CreatePool ();
+  ueSidelinkConfiguration->SetSlPreconfiguration (preconfiguration);
+  lteHelper->InstallSidelinkConfiguration (devices, ueSidelinkConfiguration);
+  Ptr<PassiveListenerHelper> listenerHelper = Create<PassiveListenerHelper> (lteHelper, proseHelper);
+  if (fullListeners)
+    {
+      lteHelper->InstallSidelinkConfiguration (listenerDevices, ueSidelinkConfiguration);
+    }
+  else
+    {
+      listenerHelper->SetPreconfiguration (preconfiguration);
+      listenerHelper->Install (listenerDevices);
+    }
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  internet.Install (listenerNodes);
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.0.0.0", "255.0.0.0");
+  ipv4.Assign (devices);
+  ipv4.Assign (listenerDevices);
+
+  Ipv4Address groupAddress4 ("255.255.255.255");
+  Ptr<LteSlTft> tft = Create<LteSlTft> (LteSlTft::BIDIRECTIONAL, groupAddress4, 255);
+  proseHelper->ActivateSidelinkBearer (Seconds (1), devices, tft);
+  if (fullListeners)
+    {
+      proseHelper->ActivateSidelinkBearer (Seconds (1), listenerDevices, tft);
+    }
+  else
+    {
+      listenerHelper->ActivateGroup (Seconds (1), listenerDevices, groupAddress4, 255);
+    }
+
+  McpttHelper mcpttHelper;
+  mcpttHelper.SetPttApp ("ns3::McpttPttApp",
+                         "PeerAddress", Ipv4AddressValue (groupAddress4),
+                         "PushOnStart", BooleanValue (true));
+  mcpttHelper.SetMediaSrc ("ns3::McpttMediaSrc",
+                           "Bytes", UintegerValue (60),
+                           "DataRate", DataRateValue (DataRate ("24kb/s")));
+  mcpttHelper.SetPusher ("ns3::McpttPusher",
+                         "Automatic", BooleanValue (false));
+  ApplicationContainer clientApps = mcpttHelper.Install (nodes);
+  clientApps.Start (Seconds (1));
+  clientApps.Stop (simTime);
+  ApplicationContainer listenerApps = fullListeners ? mcpttHelper.Install (listenerNodes)
+    : listenerHelper->InstallApps (listenerNodes, groupAddress4);
+  listenerApps.Start (Seconds (1));
+  listenerApps.Stop (simTime);
+
+  Ptr<BroadcastCallBuilder> callBuilder = Create<BroadcastCallBuilder> ();
+  callBuilder->SetUsersPerGroup (usersPerGroup);
+  callBuilder->SetListenersPerGroup (listenersPerGroup);
+  uint32_t groups = callBuilder->Build (clientApps, listenerApps);
+
+  Ptr<UniformRandomVariable> electionRnd = CreateObject<UniformRandomVariable> ();
+  for (uint32_t g = 0; g < groups; g++)
+    {
+      const BroadcastCallBuilder::Group &group = callBuilder->GetGroup (g);
+      Ptr<RelayElection> election = Create<RelayElection> ();
+      election->SetTCycle (MilliSeconds (100));
+      election->SetHearingDelay (MilliSeconds (40)); //one SC period to hear the winner, as broadcast_20
+      for (uint32_t u = 0; u < group.apps.GetN (); u++)
+        {
+          Ptr<McpttPttApp> pttApp = DynamicCast<McpttPttApp, Application> (group.apps.Get (u));
+          uint32_t candidateId = election->AddCandidate (MakeCallback (&McpttPttApp::TakePushNotification, pttApp),
+                                                         electionRnd->GetValue (1.0, 100.0),
+                                                         electionRnd->GetValue (0.0, 10.0),
+                                                         electionRnd->GetValue (1.0, 100.0),
+                                                         false,
+                                                         electionRnd->GetValue (0.0, 100.0));
+          pttApp->TraceConnectWithoutContext ("RxTrace", MakeBoundCallback (&RelayElection::RxTrace, election, candidateId, group.callId));
+        }
+      Simulator::Schedule (Seconds (2.2), &RelayElection::Start, election);
+      Simulator::Schedule (Seconds (5.25), &RelayElection::ReleaseWinnerCall, election, group.apps);
+    }
+
+  //early termination: the calls are over once the BROADCAST END reached every other member and listener
+  Ptr<TerminationController> termination;
+  if (earlyStop)
+    {
+      Ptr<BroadcastEndProgress> endProgress = Create<BroadcastEndProgress> ();
+      for (uint32_t g = 0; g < groups; g++)
+        {
+          const BroadcastCallBuilder::Group &group = callBuilder->GetGroup (g);
+          ApplicationContainer receivers = group.apps;
+          receivers.Add (group.listeners);
+          endProgress->callIds.push_back (group.callId);
+          endProgress->expected.push_back (receivers.GetN () - 1);
+          endProgress->received.push_back (std::set<Ptr<const Application> > ());
+          for (uint32_t u = 0; u < receivers.GetN (); u++)
+            {
+              receivers.Get (u)->TraceConnectWithoutContext ("RxTrace", MakeBoundCallback (&BroadcastEndRxTrace, endProgress, g));
+            }
+        }
+      termination = Create<TerminationController> (MilliSeconds (100));
+      termination->AddCriterion ("BROADCAST END received by all", MakeBoundCallback (&AllBroadcastsEnded, endProgress));
+      termination->Start (Seconds (5.25), simTime);
+    }
+
+  SimulationProfiler profiler;
+  Simulator::Stop (simTime);
+  profiler.Start ();
+  Simulator::Run ();
+  profiler.Stop ();
+  double endTime = Simulator::Now ().GetSeconds ();
+  Simulator::Destroy ();
+
+  std::cout << ueCount << "\t" << listenerCount << "\t" << (listenerCount == 0 ? "-" : (fullListeners ? "full" : "passive"))
+            << "\t" << groups << "\t" << endTime << "\t" << profiler.GetWallTime () << "\t"
+            << profiler.GetEvents () << "\t" << profiler.GetEvents () / profiler.GetWallTime () << "\t"
+            << SimulationProfiler::GetPeakRss () << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string ueCounts = "10,100,1000";
+  uint32_t usersPerGroup = 10;
+  uint32_t listenersPerGroup = 0;
+  bool fullBaseline = true;
+  double areaPerUe = 25.0;
+  Time simTime = Seconds (6);
+  bool earlyStop = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("ueCounts", "Comma-separated numbers of UEs to simulate", ueCounts);
+  cmd.AddValue ("usersPerGroup", "Number of UEs in a broadcast group", usersPerGroup);
+  cmd.AddValue ("listenersPerGroup", "Number of passive listeners added to every broadcast group", listenersPerGroup);
+  cmd.AddValue ("fullBaseline", "Also run every UE count with the listeners installed as talkers", fullBaseline);
+  cmd.AddValue ("areaPerUe", "Area of the drop square per UE, in m^2", areaPerUe);
+  cmd.AddValue ("simTime", "Simulated time of every run", simTime);
+  cmd.AddValue ("earlyStop", "End a run once every member and listener received the GROUP CALL BROADCAST END, instead of at simTime", earlyStop);
+  cmd.Parse (argc, argv);
+
+  std::vector<uint32_t> counts;
+  std::istringstream items (ueCounts);
+  std::string item;
+  while (std::getline (items, item, ','))
+    {
+      std::istringstream is (item);
+      uint32_t count;
+      NS_ABORT_MSG_UNLESS ((is >> count) && is.eof () && count > 0, "Bad UE count '" << item << "'");
+      NS_ABORT_MSG_IF (count % usersPerGroup != 0, count << " UEs do not make groups of " << usersPerGroup);
+      counts.push_back (count);
+    }
+
+  //the passive profile, then the baseline with full listeners
+  uint32_t profiles = listenersPerGroup > 0 && fullBaseline ? 2 : 1;
+  std::cout << "UEs\tlisteners\tprofile\tgroups\tend(s)\twall(s)\tevents\tevents/s\tpeakRSS(KiB)" << std::endl;
+  for (uint32_t c = 0; c < counts.size (); c++)
+    {
+      for (uint32_t p = 0; p < profiles; p++)
+        {
+          std::cout.flush ();
+          pid_t pid = fork ();
+          NS_ABORT_MSG_IF (pid < 0, "fork failed");
+          if (pid == 0)
+            {
+              RunScenario (counts[c], usersPerGroup, listenersPerGroup, p == 1, areaPerUe, simTime, earlyStop);
+              std::cout.flush ();
+              _exit (0);
+            }
+          int status;
+          waitpid (pid, &status, 0);
+          NS_ABORT_MSG_UNLESS (WIFEXITED (status) && WEXITSTATUS (status) == 0, "Run with " << counts[c] << " UEs failed");
+        }
+    }
+
+  return 0;
+}
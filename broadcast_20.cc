@@ -22,6 +22,12 @@
 #include <ns3/mcptt-floor-msg.h>
 #include <ns3/mcptt-floor-msg-field.h>
 #include "ns3/ipv4-l3-protocol.h"
+#include "relay-election.h"
+#include "broadcast-call-builder.h"
+#include "simulation-profiler.h"
+#include "kpi-file.h"
+#include "run-cache.h"
+#include "pathloss-matrix.h"
 
 using namespace ns3;
 //using namespace psc;
@@ -29,20 +35,6 @@ using namespace ns3;
 //initial environment :initial parameter configurations 
 NS_LOG_COMPONENT_DEFINE ("broadcast_call_technique");
 
-//waiting time 
-double
-waiting_time (double own_snr, double loc_accuracy, double other_device_snr, bool incoverage, double mySoc, double T_cycle )
-{
-double result;
-if (mySoc < 20){
-result = 1/(loc_accuracy +0.1)*(own_snr/other_device_snr)*(1/(incoverage+0.1))*(20/(mySoc))*T_cycle ; 
-}
-else {
-result = 1/(loc_accuracy +0.1)*(own_snr/other_device_snr)*(1/(incoverage+0.1))*(20/20)*T_cycle;
-}
-return result;
-}
-
 
 //packet trace 
 void
@@ -121,15 +113,34 @@ double releaseTimeMean = 5.0; // seconds
 double releaseTimeVariance = 2.0; // seconds
 Time startTime = Seconds (1);
 Time stopTime = Seconds (30);
+Time electionStart = Seconds (2.2); //relay election start
+Time electionTCycle = MilliSeconds (100); //T_cycle of waiting_time
+Time electionHearingDelay = MilliSeconds (40); //one SC period to hear the winner
 TypeId socketFacTid = UdpSocketFactory::GetTypeId ();
 //uint32_t groupId = 1;
 //Ipv4Address peerAddress = Ipv4Address ("255.255.255.255");
+bool profile = false;
+std::string kpiFile = "kpi.txt";
+bool runCache = false;
+bool invalidateCache = false;
+std::string runCacheDir = "run-cache";
+bool pathlossMatrix = true;
+
+CommandLine cmd;
+cmd.AddValue ("groupcount", "Number of broadcast groups", groupcount);
+cmd.AddValue ("usersPerGroup", "Number of UEs in a broadcast group", usersPerGroup);
+cmd.AddValue ("profile", "Print the wall time, events processed and peak RSS of the run", profile);
+cmd.AddValue ("kpiFile", "File the KPIs of the run are written to (none if empty)", kpiFile);
+cmd.AddValue ("runCache", "Restore the KPI file of an identical earlier run instead of simulating", runCache);
+cmd.AddValue ("invalidateCache", "Drop the cached results of this run and simulate again", invalidateCache);
+cmd.AddValue ("runCacheDir", "Directory of the run cache (give an absolute path to share it between sweep runs)", runCacheDir);
+cmd.AddValue ("pathlossMatrix", "Precompute the pathloss between every pair of the static UEs", pathlossMatrix);
+cmd.Parse (argc, argv);
+
 appCount = usersPerGroup * groupcount;
 // uint8_t        m_hopCount;
 
 
-uint16_t floorPort = McpttPttApp::AllocateNextPortNumber ();
-uint16_t speechPort = McpttPttApp::AllocateNextPortNumber ();
 Ipv4AddressValue grpAddress;
 //bool remoteUesOoc = true;
 
@@ -160,12 +171,13 @@ Time delayTfb3 = Seconds(5);
 
 //Physical layer 
 
-//creating 3 nodes
+//creating groupcount x usersPerGroup nodes
   NodeContainer nodes;
   nodes.Create(appCount);
-  std::cout << "ue is :" << nodes.Get(0)->GetId() << std::endl;
-  std::cout << "ue is :" << nodes.Get(1)->GetId() << std::endl;
-  std::cout << "ue is :" << nodes.Get(2)->GetId() << std::endl;
+  for (uint32_t n = 0; n < nodes.GetN (); n++)
+    {
+      NS_LOG_INFO ("ue is :" << nodes.Get (n)->GetId ());
+    }
 
   NodeContainer gnBnode;
   gnBnode.Create(1);
@@ -179,6 +191,10 @@ rndBoxPosAllocator->SetX (CreateObjectWithAttributes<UniformRandomVariable> ("Mi
 rndBoxPosAllocator->SetY (CreateObjectWithAttributes<UniformRandomVariable> ("Min", DoubleValue (0.0), "Max", DoubleValue (maxY)));
 rndBoxPosAllocator->SetZ (CreateObjectWithAttributes<ConstantRandomVariable> ("Constant", DoubleValue (1.5)));
 
+//Fix the random number streams, so that replications only differ by RngRun
+int64_t randomStream = 1;
+randomStream += rndBoxPosAllocator->AssignStreams (randomStream);
+
 
 Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator> ();
   for (uint32_t count = 0; count < appCount; count++)
@@ -258,8 +274,16 @@ Config::SetDefault ("ns3::LteSlBasicUeController::ProseHelper",PointerValue (pro
 //Enable Sidelink
 lteHelper->SetAttribute ("UseSidelink", BooleanValue (true));
 
-//Set pathloss model
-lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Cost231PropagationLossModel"));
+//Set pathloss model, looked up in the pair-loss matrix of the UEs since they don't move
+if (pathlossMatrix)
+  {
+    lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::MatrixPropagationLossModel"));
+    lteHelper->SetPathlossModelAttribute ("Model", StringValue ("ns3::Cost231PropagationLossModel"));
+  }
+else
+  {
+    lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Cost231PropagationLossModel"));
+  }
 
 // channel model initialization
 lteHelper->Initialize ();
@@ -268,6 +292,11 @@ lteHelper->Initialize ();
 double ulFreq = LteSpectrumValueHelper::GetCarrierFrequency (ulEarfcn);
 NS_LOG_LOGIC ("UL freq: " << ulFreq);
 Ptr<Object> uplinkPathlossModel = lteHelper->GetUplinkPathlossModel ();
+Ptr<MatrixPropagationLossModel> lossMatrix = uplinkPathlossModel->GetObject<MatrixPropagationLossModel> ();
+if (lossMatrix)
+  {
+    uplinkPathlossModel = lossMatrix->GetModel ();
+  }
 Ptr<PropagationLossModel> lossModel = uplinkPathlossModel->GetObject<PropagationLossModel> ();
 NS_ABORT_MSG_IF (lossModel == NULL, "No PathLossModel");
 bool ulFreqOk = uplinkPathlossModel->SetAttributeFailSafe ("Frequency", DoubleValue (ulFreq));
@@ -275,6 +304,10 @@ bool ulFreqOk = uplinkPathlossModel->SetAttributeFailSafe ("Frequency", DoubleVa
     {
       NS_LOG_WARN ("UL propagation model does not have a Frequency attribute");
     }
+if (lossMatrix)
+  {
+    lossMatrix->Build (nodes);
+  }
 NetDeviceContainer devices;
  // NetDeviceContainer devices = lteHelper->InstallUeDevice (nodes);
 Ptr<LteSlUeRrc> ueSidelinkConfiguration = CreateObject<LteSlUeRrc> ();
@@ -567,6 +600,7 @@ mcpttHelper.SetPusherReleaseVariable ("ns3::NormalRandomVariable",
 mcpttHelper.EnableStateMachineTraces();       
 
 clientApps.Add (mcpttHelper.Install (nodes));
+randomStream += mcpttHelper.AssignStreams (nodes, randomStream);
 clientApps.Start (startTime);
 clientApps.Stop (stopTime);
 
@@ -592,145 +626,62 @@ callFac.SetTypeId ("ns3::McpttCallMachineGrpBroadcast");
 
 ObjectFactory floorFac;
 floorFac.SetTypeId ("ns3::McpttFloorMachineBasic");
-  
-Ipv4AddressValue grpAddr;
-
-//creating location to store application info of UEs A, B 
-Ptr<McpttPttApp> ueAPttApp = DynamicCast<McpttPttApp, Application> (clientApps.Get (0));
-Ptr<McpttPttApp> ueBPttApp = DynamicCast<McpttPttApp, Application> (clientApps.Get (1));
-Ptr<McpttPttApp> ueCPttApp = DynamicCast<McpttPttApp, Application> (clientApps.Get (2));
 
-  //UE A
+  //first group
   uint32_t grpId = 1;
   uint16_t callId = 1;
   
 //McpttCallMsgFieldUserLoc m_userLoc;
 
-  //UE B 
   std::string orgName = "EMS";
   Time joinTime = Seconds (2.2);
-  uint32_t origId = ueAPttApp->GetUserId ();
-  int no_devices = ueAPttApp->GetNode()->GetNDevices();
+  int no_devices = clientApps.Get (0)->GetNode()->GetNDevices();
 for (int i=0;i<no_devices;i++){
 
-  std::cout << "A address" << ueAPttApp->GetNode()->GetDevice(i)->GetAddress() << std::endl;
+  std::cout << "A address" << clientApps.Get (0)->GetNode()->GetDevice(i)->GetAddress() << std::endl;
 
 }
 
-  //fix this // device ekka id within the range 
-  // 0.0.0.0
-
-  McpttCallMsgFieldSdp sdp;
-  sdp.SetFloorPort (floorPort);
-  sdp.SetGrpAddr (grpAddress.Get ());
-  //sdp.SetOrigAddr (origAddress);
-  sdp.SetSpeechPort (speechPort);
-
- 
-//floor and call machines generate*******************************
-ueAPttApp->CreateCall (callFac, floorFac);
-ueAPttApp->SelectLastCall ();
-ueBPttApp->CreateCall (callFac, floorFac);
-ueBPttApp->SelectLastCall ();
-ueCPttApp->CreateCall (callFac, floorFac);
-ueCPttApp->SelectLastCall ();
-
-
-//creating call interfaces and location to store call of UEs A, B 
-Ptr<McpttCall> ueACall = ueAPttApp->GetSelectedCall ();
-Ptr<McpttCall> ueBCall = ueBPttApp->GetSelectedCall ();
-Ptr<McpttCall> ueCCall = ueCPttApp->GetSelectedCall ();
-
-
-//Ptr<McpttCallMachine> ueAMachine = ueACall->GetCallMachine ();
-Ptr<McpttCallMachineGrpBroadcast> Abroadcastgroupmachine = DynamicCast<McpttCallMachineGrpBroadcast, McpttCallMachine>(ueACall->GetCallMachine ());
-Ptr<McpttCallMachineGrpBroadcast> Bbroadcastgroupmachine =  DynamicCast<McpttCallMachineGrpBroadcast, McpttCallMachine>(ueBCall->GetCallMachine ());
-Ptr<McpttCallMachineGrpBroadcast> Cbroadcastgroupmachine =  DynamicCast<McpttCallMachineGrpBroadcast, McpttCallMachine>(ueBCall->GetCallMachine ());
-
-
-  //UE A 
-  Abroadcastgroupmachine->SetCallId (callId);
-  Abroadcastgroupmachine->SetGrpId (grpId);
-  Abroadcastgroupmachine->SetOrigId (origId);
-  Abroadcastgroupmachine->SetSdp (sdp);
-  Abroadcastgroupmachine->SetCallType (McpttCallMsgFieldCallType::BROADCAST_GROUP);
-  Abroadcastgroupmachine->SetPriority (McpttCallMsgFieldCallType::GetCallTypePriority (McpttCallMsgFieldCallType::BROADCAST_GROUP));
-  
-  McpttCallMachineGrpBroadcastStateB2::GetInstance ();
- 
-  // UE B
-  Bbroadcastgroupmachine ->SetCallId (callId);
-  Bbroadcastgroupmachine ->SetGrpId (grpId);
-  Bbroadcastgroupmachine ->SetOrigId (origId);
-  Bbroadcastgroupmachine ->SetSdp (sdp);
-  Bbroadcastgroupmachine ->SetCallType (McpttCallMsgFieldCallType::BROADCAST_GROUP);
-  Bbroadcastgroupmachine ->SetPriority (McpttCallMsgFieldCallType::GetCallTypePriority (McpttCallMsgFieldCallType::BROADCAST_GROUP));
-  McpttCallMachineGrpBroadcastStateB2::GetInstance ();
- 
-
-  // UE C
-  Cbroadcastgroupmachine ->SetCallId (callId);
-  Cbroadcastgroupmachine ->SetGrpId (grpId);
-  Cbroadcastgroupmachine ->SetOrigId (origId);
-  Cbroadcastgroupmachine ->SetSdp (sdp);
-  Cbroadcastgroupmachine ->SetCallType (McpttCallMsgFieldCallType::BROADCAST_GROUP);
-  Cbroadcastgroupmachine ->SetPriority (McpttCallMsgFieldCallType::GetCallTypePriority (McpttCallMsgFieldCallType::BROADCAST_GROUP));
-  McpttCallMachineGrpBroadcastStateB2::GetInstance ();
+//floor and call machines generate, SDP, TFB timers and floor/media channels of every group*******************************
+//start timer TFB1 and TFB2***************************
+//establish media session***************************** 
+Ptr<BroadcastCallBuilder> callBuilder = Create<BroadcastCallBuilder> ();
+callBuilder->SetFactories (callFac, floorFac);
+callBuilder->SetUsersPerGroup (usersPerGroup);
+callBuilder->SetFirstIds (grpId, callId);
+callBuilder->SetGrpAddress (grpAddress.Get ());
+callBuilder->SetTimerDelays (delayTfb1, delayTfb2, delayTfb3);
+callBuilder->SetSchedule (Seconds (2.1), Seconds (2.15), Seconds (5.25));
+callBuilder->Build (clientApps);
 
   //push button press schedule
 
-  Simulator::Schedule (Seconds (2.2), &McpttPttApp::TakePushNotification, ueAPttApp);
-  McpttCallMachineGrpBroadcastStateB1::GetStateId ();
-  McpttCallMachineGrpBroadcastStateB1::GetInstance ();
-  Ptr<McpttChan> AcallChan = ueAPttApp->GetCallChan ();
-  Ptr<McpttChan> BcallChan = ueBPttApp->GetCallChan ();
-  Ptr<McpttChan> CcallChan = ueCPttApp->GetCallChan ();
-
-  // UE A
-  Abroadcastgroupmachine->SetCallId (callId);
-  Abroadcastgroupmachine->SetGrpId (grpId);
-  Abroadcastgroupmachine->SetOrigId (origId);
-  Abroadcastgroupmachine->SetSdp (sdp);
-  Abroadcastgroupmachine->SetCallType (McpttCallMsgFieldCallType::BROADCAST_GROUP);
-  Abroadcastgroupmachine->SetPriority (McpttCallMsgFieldCallType::GetCallTypePriority (McpttCallMsgFieldCallType::BROADCAST_GROUP));
-  
-
-Ptr<McpttPusher> ueAPusher = ueAPttApp->GetPusher ();
-Ptr<McpttPusher> ueBPusher = ueBPttApp->GetPusher ();
-Ptr<McpttPusher> ueCPusher = ueCPttApp->GetPusher ();
-
-Ptr<McpttMediaSrc> ueAMediaSrc = ueAPttApp->GetMediaSrc ();
-Ptr<McpttMediaSrc> ueBMediaSrc = ueBPttApp->GetMediaSrc ();
-Ptr<McpttMediaSrc> ueCMediaSrc = ueCPttApp->GetMediaSrc ();
-
-
-McpttCallMachineGrpBroadcast AbroadcastMachines;
-AbroadcastMachines.SetDelayTfb1(delayTfb1);
-AbroadcastMachines.SetDelayTfb2(delayTfb2);
-AbroadcastMachines.SetDelayTfb3(delayTfb3);
-
-Ptr<McpttTimer> Atfb1 =AbroadcastMachines.GetTfb1();
-Ptr<McpttTimer> Atfb2 =AbroadcastMachines.GetTfb2();
-Ptr<McpttTimer> Atfb3 =AbroadcastMachines.GetTfb3();
-Ptr<McpttCallMachineGrpBroadcastState> stateA = AbroadcastMachines.GetState ();
-
-
-McpttCallMachineGrpBroadcast BbroadcastMachines;
-BbroadcastMachines.SetDelayTfb1(delayTfb1);
-BbroadcastMachines.SetDelayTfb3(delayTfb3);
-
-Ptr<McpttTimer> Btfb1 =BbroadcastMachines.GetTfb1();
-Ptr<McpttTimer> Btfb3 =BbroadcastMachines.GetTfb3();
-Ptr<McpttCallMachineGrpBroadcastState> stateB = BbroadcastMachines.GetState ();
-
-McpttCallMachineGrpBroadcast CbroadcastMachines;
-CbroadcastMachines.SetDelayTfb1(delayTfb1);
-CbroadcastMachines.SetDelayTfb3(delayTfb3);
-
-Ptr<McpttTimer> Ctfb1 =CbroadcastMachines.GetTfb1();
-Ptr<McpttTimer> Ctfb3 =CbroadcastMachines.GetTfb3();
-Ptr<McpttCallMachineGrpBroadcastState> stateC = CbroadcastMachines.GetState ();
-
+  //in every group every UE backs off for its waiting time; the first to expire initiates the call
+  std::vector<Ptr<RelayElection> > elections;
+  Ptr<UniformRandomVariable> electionRnd = CreateObject<UniformRandomVariable> ();
+  electionRnd->SetStream (randomStream++);
+  for (uint32_t g = 0; g < callBuilder->GetNGroups (); g++)
+    {
+      const BroadcastCallBuilder::Group &group = callBuilder->GetGroup (g);
+      Ptr<RelayElection> election = Create<RelayElection> ();
+      election->SetTCycle (electionTCycle);
+      election->SetHearingDelay (electionHearingDelay);
+      for (uint32_t u = 0; u < group.apps.GetN (); u++)
+        {
+          Ptr<McpttPttApp> pttApp = DynamicCast<McpttPttApp, Application> (group.apps.Get (u));
+          uint32_t candidateId = election->AddCandidate (MakeCallback (&McpttPttApp::TakePushNotification, pttApp),
+                                                         electionRnd->GetValue (1.0, 100.0), //own SNR
+                                                         electionRnd->GetValue (0.0, 10.0), //location accuracy
+                                                         electionRnd->GetValue (1.0, 100.0), //neighbour SNR
+                                                         false, //out of coverage
+                                                         electionRnd->GetValue (0.0, 100.0)); //SoC
+          pttApp->TraceConnectWithoutContext ("RxTrace", MakeBoundCallback (&RelayElection::RxTrace, election, candidateId, group.callId));
+        }
+      Simulator::Schedule (electionStart, &RelayElection::Start, election);
+      //release button : end call
+      Simulator::Schedule (Seconds (5.25), &RelayElection::ReleaseWinnerCall, election, group.apps);
+      elections.push_back (election);
+    }
 
 //generating floor control message 
   McpttFloorMsgFieldIndic indic = McpttFloorMsgFieldIndic ();
@@ -769,40 +720,8 @@ pkt->AddHeader (msg);
  
 NS_LOG_LOGIC (Simulator::Now ().GetSeconds () << "s: PttApp sending " << msg << ".");
 
-
-//start timer TFB1 and TFB2***************************
-//establish media session***************************** 
-//release button : send call***************************
-  Simulator::Schedule (Seconds (2.1), &McpttTimer::Start, Atfb1);
-  Simulator::Schedule (Seconds (2.1), &McpttTimer::Start, Atfb2);
-  Simulator::Schedule (Seconds (2.1), &McpttTimer::Start, Btfb1);
-  Simulator::Schedule (Seconds (2.1), &McpttTimer::Start, Ctfb1);
-  McpttCallMachineGrpBroadcastStateB2::GetStateId ();
-  
-  Simulator::Schedule (Seconds (2.15), &McpttCall::OpenFloorChan, ueACall, grpAddress.Get (), floorPort);
-  Simulator::Schedule (Seconds (2.15), &McpttCall::OpenMediaChan, ueACall, grpAddress.Get (), speechPort);
-  Simulator::Schedule (Seconds (2.15), &McpttCall::OpenFloorChan, ueBCall, grpAddress.Get (), floorPort);
-  Simulator::Schedule (Seconds (2.15), &McpttCall::OpenMediaChan, ueBCall, grpAddress.Get (), speechPort);
-  Simulator::Schedule (Seconds (2.15), &McpttCall::OpenFloorChan, ueCCall, grpAddress.Get (), floorPort);
-  Simulator::Schedule (Seconds (2.15), &McpttCall::OpenMediaChan, ueCCall, grpAddress.Get (), speechPort);
-  
 //// synchronization and call in progress 
  //UdpEchoServer listening in the Remote UE port
-
-
-//end call
- Simulator::Schedule (Seconds (5.25), &McpttPttApp::ReleaseCall, ueAPttApp);
-
-//broadcast end message
-McpttCallMsgGrpBroadcastEnd Endmsg;
-//B, C receive end message
-BbroadcastMachines.ReceiveGrpCallBroadcastEnd(Endmsg);
-CbroadcastMachines.ReceiveGrpCallBroadcastEnd(Endmsg);
-Simulator::Schedule (Seconds (5.25), &McpttTimer::Stop, Atfb1);
-Simulator::Schedule (Seconds (5.25), &McpttTimer::Stop, Atfb2);
-Simulator::Schedule (Seconds (5.25), &McpttTimer::Stop, Btfb1);
-Simulator::Schedule (Seconds (5.25), &McpttTimer::Stop, Ctfb1);
-
 //Result generation*******************************************
 //Packets traces
 
@@ -861,7 +780,63 @@ std::cout << "okay" << std::endl;
 //Simulator::Stop (Seconds (stopTime));
 //anim.SetConstantPosition(nodes.Get(0),1.0,2.0);
 //anim.SetConstantPosition(nodes.Get(1),4.0,5.0);
+Ptr<RunCache> cache;
+if (runCache && !kpiFile.empty ())
+  {
+    cache = Create<RunCache> (runCacheDir, argc, argv);
+    cache->AddOutput (kpiFile);
+    if (invalidateCache)
+      {
+        cache->Invalidate ();
+      }
+    else if (cache->Restore ())
+      {
+        std::cout << "KPIs restored from " << cache->GetEntry () << std::endl;
+        Simulator::Destroy ();
+        return 0;
+      }
+  }
+SimulationProfiler profiler;
+profiler.Start ();
 Simulator::Run ();
+profiler.Stop ();
+
+//KPIs: call setup time is the time from the election start to the first initiation
+Ptr<KpiFile> kpis = Create<KpiFile> (kpiFile);
+double setupSum = 0;
+uint32_t setups = 0;
+for (uint32_t g = 0; g < elections.size (); g++)
+  {
+    const std::vector<RelayElection::Stats> &stats = elections[g]->GetStats ();
+    for (uint32_t e = 0; e < stats.size (); e++)
+      {
+        if (stats[e].initiators > 0)
+          {
+            setupSum += (stats[e].firstWin - stats[e].start).GetSeconds () * 1000;
+            setups++;
+          }
+      }
+  }
+if (setups > 0)
+  {
+    kpis->Set ("callSetup(ms)", setupSum / setups);
+  }
+kpis->Set ("callsSetUp", setups);
+kpis->Write ();
+if (cache)
+  {
+    cache->Store ();
+  }
+for (uint32_t g = 0; g < elections.size (); g++)
+  {
+    std::cout << "group " << callBuilder->GetGroup (g).grpId << ": ";
+    elections[g]->PrintStats (std::cout);
+  }
+if (profile)
+  {
+    std::cout << appCount << " UEs, " << groupcount << " groups: ";
+    profiler.Print (std::cout);
+  }
 Simulator::Destroy();
 
 NS_LOG_UNCOND ("Done Simulator");
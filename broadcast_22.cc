@@ -20,6 +20,7 @@
 #include <iostream>
 #include <ns3/mcptt-floor-msg.h>
 #include <ns3/mcptt-floor-msg-field.h>
+#include "relay-election.h"
 
 using namespace ns3;
 //using namespace psc;
@@ -147,6 +148,9 @@ double releaseTimeMean = 5.0; // seconds
 double releaseTimeVariance = 2.0; // seconds
 Time startTime = Seconds (1);
 Time stopTime = Seconds (30);
+Time electionStart = Seconds (2.2); //relay election start
+Time electionTCycle = MilliSeconds (100); //T_cycle of waiting_time
+Time electionHearingDelay = MilliSeconds (40); //one SC period to hear the winner
 TypeId socketFacTid = UdpSocketFactory::GetTypeId ();
 //uint32_t groupId = 1;
 Ipv4Address peerAddress = Ipv4Address ("255.255.255.255");
@@ -505,7 +509,23 @@ Ptr<McpttCallMachineGrpBroadcast> Cbroadcastgroupmachine =  DynamicCast<McpttCal
 //push button press schedule
 
 
-  Simulator::Schedule (Seconds (2.2), &McpttPttApp::TakePushNotification, ueAPttApp);
+  //every UE backs off for its waiting time; the first to expire initiates the call
+  Ptr<RelayElection> election = Create<RelayElection> ();
+  election->SetTCycle (electionTCycle);
+  election->SetHearingDelay (electionHearingDelay);
+  Ptr<UniformRandomVariable> electionRnd = CreateObject<UniformRandomVariable> ();
+  for (uint32_t u = 0; u < clientApps.GetN (); u++)
+    {
+      Ptr<McpttPttApp> pttApp = DynamicCast<McpttPttApp, Application> (clientApps.Get (u));
+      uint32_t candidateId = election->AddCandidate (MakeCallback (&McpttPttApp::TakePushNotification, pttApp),
+                                                     electionRnd->GetValue (1.0, 100.0), //own SNR
+                                                     electionRnd->GetValue (0.0, 10.0), //location accuracy
+                                                     electionRnd->GetValue (1.0, 100.0), //neighbour SNR
+                                                     false, //out of coverage
+                                                     electionRnd->GetValue (0.0, 100.0)); //SoC
+      pttApp->TraceConnectWithoutContext ("RxTrace", MakeBoundCallback (&RelayElection::RxTrace, election, candidateId, callId));
+    }
+  Simulator::Schedule (electionStart, &RelayElection::Start, election);
   McpttCallMachineGrpBroadcastStateB1::GetStateId ();
 
   Ptr<McpttChan> AcallChan = ueAPttApp->GetCallChan ();
@@ -657,7 +677,7 @@ Simulator::Schedule (Seconds (2.1), &McpttTimer::Start, Ctfb1);
 
 
 //end call
- Simulator::Schedule (Seconds (5.25), &McpttPttApp::ReleaseCall, ueAPttApp);
+ Simulator::Schedule (Seconds (5.25), &RelayElection::ReleaseWinnerCall, election, clientApps);
 
 //broadcast end message
 McpttCallMsgGrpBroadcastEnd Endmsg;
@@ -710,6 +730,7 @@ anim.SetMaxPktsPerTraceFile(500000);
 //anim.SetConstantPosition(nodes.Get(0),1.0,2.0);
 //anim.SetConstantPosition(nodes.Get(1),4.0,5.0);
 Simulator::Run ();
+election->PrintStats (std::cout);
 Simulator::Destroy();
 
 NS_LOG_UNCOND ("Done Simulator");
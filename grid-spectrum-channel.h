@@ -0,0 +1,356 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Spectrum channel with a uniform-grid index of its receivers: a signal is
+ * only forwarded to the PHYs within the range where its best-case received
+ * power is above a floor CullMargin dB under the noise level, instead of to
+ * every PHY of the channel, so a transmission costs O(neighbours) in large
+ * deployments (many relay clusters, many rings).
+ *
+ * The best case is a log-distance loss, free space at 1 m then
+ * LossExponent (2, free space, by default) at the lowest frequency of the
+ * signal, plus MaxAntennaGain: the range is where the highest PSD of the
+ * signal falls CullMargin dB under the thermal noise PSD (-174 dBm/Hz plus
+ * NoiseFigure), capped by MaxRange if set. Free space reaches tens of km
+ * from a UE, so set LossExponent to the lowest slope of the propagation
+ * loss model (or MaxRange) to cull anything. The receivers beyond range
+ * are neither given the signal nor counted as interference, so keep
+ * CullMargin above the shadowing spread of the propagation loss model.
+ *
+ * Within range, a signal is forwarded as by SingleModelSpectrumChannel
+ * (antenna gains, PropagationLossModel, MaxLossDb,
+ * SpectrumPropagationLossModel, delay), in the order the PHYs were added,
+ * and converted to the receiver's spectrum model when it differs as by
+ * MultiModelSpectrumChannel. The grid is rebuilt after a PHY is added or
+ * a node changes course; a node walking between course changes is looked
+ * up in the cell of its last rebuild, so keep CellSize well above the
+ * distance walked meanwhile.
+ *
+ *   lteHelper->SetSpectrumChannelType ("ns3::GridSpectrumChannel");
+ *   lteHelper->SetSpectrumChannelAttribute ("CullMargin", DoubleValue (10));
+ */
+
+#ifndef GRID_SPECTRUM_CHANNEL_H
+#define GRID_SPECTRUM_CHANNEL_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/antenna-module.h"
+#include "ns3/spectrum-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+class GridSpectrumChannel : public SpectrumChannel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::GridSpectrumChannel")
+      .SetParent<SpectrumChannel> ()
+      .SetGroupName ("Spectrum")
+      .AddConstructor<GridSpectrumChannel> ()
+      .AddAttribute ("CellSize",
+                     "The side (m) of the grid cells",
+                     DoubleValue (500),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_cellSize),
+                     MakeDoubleChecker<double> (1))
+      .AddAttribute ("CullMargin",
+                     "How far (dB) under the noise level the best-case received PSD may be before a receiver is skipped",
+                     DoubleValue (10),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_cullMargin),
+                     MakeDoubleChecker<double> ())
+      .AddAttribute ("NoiseFigure",
+                     "The noise figure (dB) of the receivers",
+                     DoubleValue (9),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_noiseFigure),
+                     MakeDoubleChecker<double> ())
+      .AddAttribute ("MaxAntennaGain",
+                     "The highest sum (dB) of the transmit and receive antenna gains",
+                     DoubleValue (0),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_maxAntennaGain),
+                     MakeDoubleChecker<double> ())
+      .AddAttribute ("LossExponent",
+                     "The lowest path loss exponent of the propagation loss model, beyond 1 m",
+                     DoubleValue (2),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_lossExponent),
+                     MakeDoubleChecker<double> (1))
+      .AddAttribute ("MaxRange",
+                     "The maximum range (m) of a signal, 0 for the one derived from the loss exponent",
+                     DoubleValue (0),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_maxRange),
+                     MakeDoubleChecker<double> (0))
+    ;
+    return tid;
+  }
+
+  GridSpectrumChannel (void)
+    : m_dirty (true),
+      m_considered (0),
+      m_culled (0)
+  { }
+
+  virtual void AddRx (Ptr<SpectrumPhy> phy)
+  {
+    m_phys.push_back (phy);
+    m_dirty = true;
+  }
+
+  virtual void StartTx (Ptr<SpectrumSignalParameters> txParams)
+  {
+    NS_ASSERT (txParams->txPhy);
+    NS_ASSERT (txParams->psd);
+    Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+    std::vector<uint32_t> receivers;
+    if (senderMobility == 0)
+      {
+        receivers.resize (m_phys.size ());
+        for (uint32_t i = 0; i < m_phys.size (); i++)
+          {
+            receivers[i] = i;
+          }
+      }
+    else
+      {
+        FindReceivers (senderMobility->GetPosition (), GetRange (txParams->psd), receivers);
+      }
+    m_considered += receivers.size ();
+    m_culled += m_phys.size () - receivers.size ();
+    for (uint32_t r = 0; r < receivers.size (); r++)
+      {
+        if (m_phys[receivers[r]] != txParams->txPhy)
+          {
+            Forward (txParams, senderMobility, m_phys[receivers[r]]);
+          }
+      }
+  }
+
+  virtual std::size_t GetNDevices (void) const
+  {
+    return m_phys.size ();
+  }
+
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const
+  {
+    return m_phys.at (i)->GetDevice ()->GetObject<NetDevice> ();
+  }
+
+  /**
+   * \param os The stream to print the number of receivers considered and
+   *           skipped to.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    uint64_t total = m_considered + m_culled;
+    os << "grid channel: " << m_considered << " receivers considered, " << m_culled << " culled ("
+       << (total ? 100.0 * m_culled / total : 0) << "%)" << std::endl;
+  }
+
+private:
+  virtual void DoDispose (void)
+  {
+    m_phys.clear ();
+    m_cells.clear ();
+    m_unplaced.clear ();
+    m_watched.clear ();
+    m_converters.clear ();
+    SpectrumChannel::DoDispose ();
+  }
+
+  // the distance beyond which the signal is under the cull floor
+  double GetRange (Ptr<const SpectrumValue> psd) const
+  {
+    double maxPsd = 0;
+    for (Values::const_iterator v = psd->ConstValuesBegin (); v != psd->ConstValuesEnd (); ++v)
+      {
+        maxPsd = std::max (maxPsd, *v);
+      }
+    double fMin = psd->GetSpectrumModel ()->Begin ()->fl;
+    if (maxPsd <= 0 || fMin <= 0)
+      {
+        return fMin <= 0 ? (m_maxRange > 0 ? m_maxRange : HUGE_VAL) : 0;
+      }
+    double floorDbmHz = -174 + m_noiseFigure - m_cullMargin;
+    double maxLossDb = 10 * std::log10 (maxPsd) + 30 + m_maxAntennaGain - floorDbmHz;
+    double lossAt1mDb = 20 * std::log10 (4 * M_PI * fMin / 299792458.0);
+    double range = std::pow (10.0, (maxLossDb - lossAt1mDb) / (10 * m_lossExponent));
+    return m_maxRange > 0 ? std::min (range, m_maxRange) : range;
+  }
+
+  static int64_t CellKey (int64_t x, int64_t y)
+  {
+    return (x << 32) ^ (y & 0xffffffff);
+  }
+
+  void Build (void)
+  {
+    m_cells.clear ();
+    m_unplaced.clear ();
+    for (uint32_t i = 0; i < m_phys.size (); i++)
+      {
+        Ptr<MobilityModel> mobility = m_phys[i]->GetMobility ();
+        if (mobility == 0)
+          {
+            m_unplaced.push_back (i);
+            continue;
+          }
+        if (m_watched.insert (PeekPointer (mobility)).second)
+          {
+            mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&GridSpectrumChannel::CourseChanged, this));
+          }
+        Vector position = mobility->GetPosition ();
+        int64_t x = std::floor (position.x / m_cellSize);
+        int64_t y = std::floor (position.y / m_cellSize);
+        m_cells[CellKey (x, y)].push_back (i);
+      }
+    m_dirty = false;
+  }
+
+  void CourseChanged (Ptr<const MobilityModel> mobility)
+  {
+    m_dirty = true;
+  }
+
+  // the PHYs within range of a position, in the order they were added
+  void FindReceivers (const Vector &position, double range, std::vector<uint32_t> &receivers)
+  {
+    if (m_dirty)
+      {
+        Build ();
+      }
+    double reachCells = std::ceil (range / m_cellSize);
+    if (!(reachCells < 1e6) || (2 * reachCells + 1) * (2 * reachCells + 1) > m_phys.size ())
+      {
+        // more cells in reach than PHYs: filter the whole list
+        for (uint32_t i = 0; i < m_phys.size (); i++)
+          {
+            Ptr<MobilityModel> mobility = m_phys[i]->GetMobility ();
+            if (mobility == 0 || CalculateDistance (mobility->GetPosition (), position) <= range)
+              {
+                receivers.push_back (i);
+              }
+          }
+        return;
+      }
+    int64_t reach = reachCells;
+    int64_t cx = std::floor (position.x / m_cellSize);
+    int64_t cy = std::floor (position.y / m_cellSize);
+    for (int64_t x = cx - reach; x <= cx + reach; x++)
+      {
+        for (int64_t y = cy - reach; y <= cy + reach; y++)
+          {
+            std::unordered_map<int64_t, std::vector<uint32_t> >::const_iterator cell = m_cells.find (CellKey (x, y));
+            if (cell == m_cells.end ())
+              {
+                continue;
+              }
+            for (uint32_t p = 0; p < cell->second.size (); p++)
+              {
+                uint32_t i = cell->second[p];
+                if (CalculateDistance (m_phys[i]->GetMobility ()->GetPosition (), position) <= range)
+                  {
+                    receivers.push_back (i);
+                  }
+              }
+          }
+      }
+    receivers.insert (receivers.end (), m_unplaced.begin (), m_unplaced.end ());
+    std::sort (receivers.begin (), receivers.end ());
+  }
+
+  // the transmitted PSD in the spectrum model of a receiver
+  Ptr<SpectrumValue> Convert (Ptr<const SpectrumValue> psd, Ptr<const SpectrumModel> rxModel)
+  {
+    if (rxModel == 0 || rxModel->GetUid () == psd->GetSpectrumModelUid ())
+      {
+        return Copy<SpectrumValue> (psd);
+      }
+    std::pair<SpectrumModelUid_t, SpectrumModelUid_t> models (psd->GetSpectrumModelUid (), rxModel->GetUid ());
+    std::map<std::pair<SpectrumModelUid_t, SpectrumModelUid_t>, SpectrumConverter>::iterator converter = m_converters.find (models);
+    if (converter == m_converters.end ())
+      {
+        converter = m_converters.insert (std::make_pair (models, SpectrumConverter (psd->GetSpectrumModel (), rxModel))).first;
+      }
+    return converter->second.Convert (psd);
+  }
+
+  // as SingleModelSpectrumChannel::StartTx, for one receiver
+  void Forward (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility, Ptr<SpectrumPhy> rxPhy)
+  {
+    Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+    rxParams->psd = Convert (txParams->psd, rxPhy->GetRxSpectrumModel ());
+    Time delay = MicroSeconds (0);
+    Ptr<MobilityModel> receiverMobility = rxPhy->GetMobility ();
+    if (senderMobility && receiverMobility)
+      {
+        double pathLossDb = 0;
+        if (txParams->txAntenna != 0)
+          {
+            Angles txAngles (receiverMobility->GetPosition (), senderMobility->GetPosition ());
+            pathLossDb -= txParams->txAntenna->GetGainDb (txAngles);
+          }
+        Ptr<AntennaModel> rxAntenna = rxPhy->GetRxAntenna ();
+        if (rxAntenna != 0)
+          {
+            Angles rxAngles (senderMobility->GetPosition (), receiverMobility->GetPosition ());
+            pathLossDb -= rxAntenna->GetGainDb (rxAngles);
+          }
+        if (m_propagationLoss)
+          {
+            pathLossDb -= m_propagationLoss->CalcRxPower (0, senderMobility, receiverMobility);
+          }
+        m_pathLossTrace (txParams->txPhy, rxPhy, pathLossDb);
+        if (pathLossDb > m_maxLossDb)
+          {
+            return;
+          }
+        *(rxParams->psd) *= std::pow (10.0, -pathLossDb / 10.0);
+        if (m_spectrumPropagationLoss)
+          {
+            rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, senderMobility, receiverMobility);
+          }
+        if (m_propagationDelay)
+          {
+            delay = m_propagationDelay->GetDelay (senderMobility, receiverMobility);
+          }
+      }
+    Ptr<NetDevice> netDev = rxPhy->GetDevice ();
+    if (netDev)
+      {
+        Simulator::ScheduleWithContext (netDev->GetNode ()->GetId (), delay, &SpectrumPhy::StartRx, rxPhy, rxParams);
+      }
+    else
+      {
+        Simulator::Schedule (delay, &SpectrumPhy::StartRx, rxPhy, rxParams);
+      }
+  }
+
+  double m_cellSize;                                                    //!< The side of the cells (m).
+  double m_cullMargin;                                                  //!< The floor under the noise level (dB).
+  double m_noiseFigure;                                                 //!< The noise figure of the receivers (dB).
+  double m_maxAntennaGain;                                              //!< The highest tx plus rx antenna gain (dB).
+  double m_lossExponent;                                                //!< The lowest path loss exponent.
+  double m_maxRange;                                                    //!< The cap of the range (m), 0 if none.
+  std::vector<Ptr<SpectrumPhy> > m_phys;                                //!< The receivers, in the order added.
+  std::unordered_map<int64_t, std::vector<uint32_t> > m_cells;         //!< The receivers of each cell.
+  std::vector<uint32_t> m_unplaced;                                     //!< The receivers without mobility.
+  std::set<const MobilityModel *> m_watched;                            //!< The mobilities whose course changes are traced.
+  std::map<std::pair<SpectrumModelUid_t, SpectrumModelUid_t>, SpectrumConverter> m_converters;   //!< The spectrum converters.
+  bool m_dirty;                                                         //!< Whether the grid must be rebuilt.
+  uint64_t m_considered;                                                //!< The receivers within range, summed over the signals.
+  uint64_t m_culled;                                                    //!< The receivers skipped, summed over the signals.
+};
+
+NS_OBJECT_ENSURE_REGISTERED (GridSpectrumChannel);
+
+} // namespace ns3
+
+#endif /* GRID_SPECTRUM_CHANNEL_H */
@@ -0,0 +1,75 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * KPIs of a run, written at the end of the simulation as "name value"
+ * lines (kpi.txt by default). This is the file read by the sweep and
+ * replication drivers (sweep-runner.cc, replication-runner.cc).
+ */
+
+#ifndef KPI_FILE_H
+#define KPI_FILE_H
+
+#include "ns3/core-module.h"
+
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+class KpiFile : public SimpleRefCount<KpiFile>
+{
+public:
+  /**
+   * \param filename The KPI file; nothing is written if empty.
+   */
+  explicit KpiFile (std::string filename = "kpi.txt")
+    : m_filename (filename)
+  { }
+
+  /**
+   * Set a KPI, replacing its previous value.
+   * \param name The KPI name, without white space.
+   * \param value Its value.
+   */
+  void Set (const std::string &name, double value)
+  {
+    NS_ABORT_MSG_IF (name.empty () || name.find_first_of (" \t#") != std::string::npos, "Bad KPI name '" << name << "'");
+    for (uint32_t k = 0; k < m_kpis.size (); ++k)
+      {
+        if (m_kpis[k].first == name)
+          {
+            m_kpis[k].second = value;
+            return;
+          }
+      }
+    m_kpis.push_back (std::make_pair (name, value));
+  }
+
+  /**
+   * Write the KPIs, in the order they were first set.
+   */
+  void Write (void) const
+  {
+    if (m_filename.empty ())
+      {
+        return;
+      }
+    std::ofstream out (m_filename.c_str (), std::ofstream::out | std::ofstream::trunc);
+    NS_ABORT_MSG_UNLESS (out.is_open (), "Can't open file " << m_filename);
+    out.precision (std::numeric_limits<double>::digits10);
+    for (uint32_t k = 0; k < m_kpis.size (); ++k)
+      {
+        out << m_kpis[k].first << " " << m_kpis[k].second << std::endl;
+      }
+  }
+
+private:
+  std::string m_filename;                                   //!< The KPI file.
+  std::vector<std::pair<std::string, double> > m_kpis;      //!< The KPIs, in the order set.
+};
+
+} // namespace ns3
+
+#endif /* KPI_FILE_H */
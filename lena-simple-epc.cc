@@ -43,69 +43,17 @@
 #include "ns3/internet-apps-module.h"
 #include "ns3/epc-helper.h"
 #include "ns3/netanim-module.h"
+#include "packet-trace-writer.h"
+#include "lte-flight-recorder.h"
+#include "run-cache.h"
+#include "loss-cache.h"
+#include "termination-controller.h"
 // #include "ns3/mmwave-helper.h"
 
 
 //#include "ns3/gtk-config-store.h"
 
 using namespace ns3;
-// This trace will log packet transmissions and receptions from the application
-// layer.  The parameter 'localAddrs' is passed to this trace in case the
-// address passed by the trace is not set (i.e., is '0.0.0.0' or '::').  The
-// trace writes to a file stream provided by the first argument; by default,
-// this trace file is 'UePacketTrace.tr'
-void
-UePacketTrace (Ptr<OutputStreamWrapper> stream, const Address &localAddrs, std::string context, Ptr<const Packet> p, const Address &srcAddrs, const Address &dstAddrs)
-{
-  std::ostringstream oss;
-  *stream->GetStream () << Simulator::Now ().GetNanoSeconds () / (double) 1e9 << "\t" << context << "\t" << p->GetSize () << "\t";
-  if (InetSocketAddress::IsMatchingType (srcAddrs))
-    {
-      oss << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 ();
-      if (!oss.str ().compare ("0.0.0.0")) //srcAddrs not set
-        {
-          *stream->GetStream () << Ipv4Address::ConvertFrom (localAddrs) << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-        }
-      else
-        {
-          oss.str ("");
-          oss << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 ();
-          if (!oss.str ().compare ("0.0.0.0")) //dstAddrs not set
-            {
-              *stream->GetStream () << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" <<  Ipv4Address::ConvertFrom (localAddrs) << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-          else
-            {
-              *stream->GetStream () << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-        }
-    }
-  else if (Inet6SocketAddress::IsMatchingType (srcAddrs))
-    {
-      oss << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 ();
-      if (!oss.str ().compare ("::")) //srcAddrs not set
-        {
-          *stream->GetStream () << Ipv6Address::ConvertFrom (localAddrs) << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-        }
-      else
-        {
-          oss.str ("");
-          oss << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 ();
-          if (!oss.str ().compare ("::")) //dstAddrs not set
-            {
-              *stream->GetStream () << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Ipv6Address::ConvertFrom (localAddrs) << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-          else
-            {
-              *stream->GetStream () << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-        }
-    }
-  else
-    {
-      *stream->GetStream () << "Unknown address type!" << std::endl;
-    }
-}
 struct info {
   uint16_t rnti; uint16_t cellId; double rsrp; double rsrq; bool servingCell; uint8_t carrier;
 };
@@ -376,6 +324,21 @@ void NotifyConnectionEstablishedEnb (Ptr<OutputStreamWrapper> stream,std::string
 
 
 
+//early termination: the fraction of the packets of all the flows received so far
+double
+FlowDeliveryRatio (Ptr<FlowMonitor> flowMonitor)
+{
+  uint64_t txPackets = 0;
+  uint64_t rxPackets = 0;
+  const FlowMonitor::FlowStatsContainer &stats = flowMonitor->GetFlowStats ();
+  for (FlowMonitor::FlowStatsContainer::const_iterator it = stats.begin (); it != stats.end (); ++it)
+    {
+      txPackets += it->second.txPackets;
+      rxPackets += it->second.rxPackets;
+    }
+  return txPackets ? (double) rxPackets / txPackets : 0;
+}
+
 NS_LOG_COMPONENT_DEFINE ("RelayingSimulator");
 
 int
@@ -385,11 +348,39 @@ main (int argc, char *argv[])
   uint16_t n310 = 1;
   Time t310 = Seconds (1);
   uint16_t n311 = 1;
+  bool binaryTraces = false;
+  std::string traceFilter = "";
+  uint32_t flightRecorderSize = 1000;
+  Time flightRecorderBefore = Seconds (1);
+  Time flightRecorderAfter = MilliSeconds (500);
+  bool runCache = false;
+  bool invalidateCache = false;
+  std::string runCacheDir = "run-cache";
+  uint32_t lossCacheSize = 0;
+  double lossCacheResolution = 1.0;
+  bool earlyStop = false; // end the run once the delivery ratio of the flows is steady
+  double pdrEpsilon = 0.005; // largest variation of a steady delivery ratio
+  uint32_t pdrSamples = 5; // samples of the delivery ratio within pdrEpsilon for it to be steady
+  Time checkInterval = Seconds (0.5); // between two samples of the delivery ratio
   // bool useCa = false;
    
  
   CommandLine cmd;
   cmd.AddValue ("simTime", "Total duration of the simulation", simTime);
+  cmd.AddValue ("binaryTraces", "Write the application packet trace in the binary format (see packet-trace-convert)", binaryTraces);
+  cmd.AddValue ("traceFilter", "Packet trace subscription, e.g. \"nodes=3,4;ports=8000;dir=rx;size=0-512;sample=1/10\" (see packet-trace-filter.h)", traceFilter);
+  cmd.AddValue ("flightRecorderSize", "Trace records kept per UE and dumped on RLF, RRC timeout or RA error (0 to disable)", flightRecorderSize);
+  cmd.AddValue ("flightRecorderBefore", "Flight recorder window before a failure", flightRecorderBefore);
+  cmd.AddValue ("flightRecorderAfter", "Flight recorder window after a failure", flightRecorderAfter);
+  cmd.AddValue ("runCache", "Restore the FlowMonitor output of an identical earlier run instead of simulating", runCache);
+  cmd.AddValue ("invalidateCache", "Drop the cached results of this run and simulate again", invalidateCache);
+  cmd.AddValue ("runCacheDir", "Directory of the run cache (give an absolute path to share it between sweep runs)", runCacheDir);
+  cmd.AddValue ("lossCacheSize", "Pathloss values kept in the LRU cache (0 to disable it)", lossCacheSize);
+  cmd.AddValue ("lossCacheResolution", "Distance (m) a UE walks before its cached pathlosses are computed again", lossCacheResolution);
+  cmd.AddValue ("earlyStop", "End the run once the delivery ratio of the flows is steady, instead of at simTime", earlyStop);
+  cmd.AddValue ("pdrEpsilon", "Largest variation of the delivery ratio over pdrSamples for it to be steady", pdrEpsilon);
+  cmd.AddValue ("pdrSamples", "Number of last delivery ratio samples within pdrEpsilon for it to be steady", pdrSamples);
+  cmd.AddValue ("checkInterval", "Time between two samples of the delivery ratio for earlyStop", checkInterval);
   // cmd.AddValue ("useCa", "Whether to use carrier aggregation.", useCa);
   cmd.Parse (argc, argv);
   // Command line arguments
@@ -407,7 +398,17 @@ main (int argc, char *argv[])
   Config::SetDefault ("ns3::LteHelper::Scheduler", StringValue("ns3::PfFfMacScheduler"));
 
   // Config::SetDefault ("ns3::LteHelper::PathlossModel", StringValue( "ns3::ThreeGppIndoorFactoryPropagationLossModel"));
-  Config::SetDefault ("ns3::LteHelper::PathlossModel", StringValue( "ns3::Cost231PropagationLossModel"));
+  if (lossCacheSize > 0)
+    {
+      Config::SetDefault ("ns3::LteHelper::PathlossModel", StringValue ("ns3::LruPropagationLossModel"));
+      Config::SetDefault ("ns3::LruPropagationLossModel::Model", StringValue ("ns3::Cost231PropagationLossModel"));
+      Config::SetDefault ("ns3::LruPropagationLossModel::Capacity", UintegerValue (lossCacheSize));
+      Config::SetDefault ("ns3::LruPropagationLossModel::Resolution", DoubleValue (lossCacheResolution));
+    }
+  else
+    {
+      Config::SetDefault ("ns3::LteHelper::PathlossModel", StringValue( "ns3::Cost231PropagationLossModel"));
+    }
   // Config::SetDefault ("ns3::MmWave3gppPropagationLossModel::Frequency", DoubleValue(6e9));
   //   Config::SetDefault ("ns3::MmWave3gppPropagationLossModel::Shadowing", BooleanValue(true));
   Config::SetDefault ("ns3::ThreeGppPropagationLossModel::ShadowingEnabled",  BooleanValue (true));
@@ -450,6 +451,26 @@ main (int argc, char *argv[])
   //    Config::SetDefault ("ns3::LteHelper::EnbComponentCarrierManager", StringValue ("ns3::RrComponentCarrierManager"));
   //  }
 
+  // after the last Config::SetDefault, which are part of the key, and
+  // before any trace file is created, so that a hit leaves the traces of
+  // the cached run in place
+  Ptr<RunCache> cache;
+  if (runCache)
+    {
+      cache = Create<RunCache> (runCacheDir, argc, argv);
+      cache->AddOutput ("test1.xml");
+      if (invalidateCache)
+        {
+          cache->Invalidate ();
+        }
+      else if (cache->Restore ())
+        {
+          std::cout << "FlowMonitor output restored from " << cache->GetEntry () << std::endl;
+          Simulator::Destroy ();
+          return 0;
+        }
+    }
+
   Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
   Ptr<PointToPointEpcHelper> epcHelper = CreateObject<PointToPointEpcHelper> ();
   lteHelper->SetEpcHelper (epcHelper);
@@ -818,10 +839,16 @@ internetDevices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
   ApplicationContainer serverApps;
   AsciiTraceHelper asciiTraceHelper;
   std::ostringstream oss;
-  Ptr<OutputStreamWrapper> stream3 = asciiTraceHelper.CreateFileStream ("UePacketTrace.tr");
-
-  //Trace file table header
-  *stream3->GetStream () << "time(sec)\ttx/rx\tNodeID\tIMSI\tPktSize(bytes)\tIP[src]\tIP[dst]" << std::endl;
+  Ptr<AsyncPacketTraceWriter> packetTraceWriter = Create<AsyncPacketTraceWriter> (binaryTraces ? "UePacketTrace.bin" : "UePacketTrace.tr",
+    "time(sec)\ttx/rx\tNodeID\tIMSI\tPktSize(bytes)\tIP[src]\tIP[dst]",
+    PacketTraceRecord::SIZE_FIRST, binaryTraces ? AsyncPacketTraceWriter::BINARY : AsyncPacketTraceWriter::TEXT);
+  packetTraceWriter->SetFilter (Create<PacketTraceFilter> (traceFilter));
+  Ptr<LteFlightRecorder> flightRecorder;
+  if (flightRecorderSize > 0)
+    {
+      flightRecorder = Create<LteFlightRecorder> ("FlightRecorder.txt", flightRecorderSize,
+                                                  flightRecorderBefore, flightRecorderAfter);
+    }
   for (uint32_t u = 0; u < ueNodes.GetN (); ++u)
     {
       ++ulPort;
@@ -830,6 +857,7 @@ internetDevices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
       PacketSinkHelper ulPacketSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), ulPort));
       PacketSinkHelper dlPacketSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), dlPort));
       PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), otherPort));
+      uint32_t firstServerApp = serverApps.GetN ();
       serverApps.Add (dlPacketSinkHelper.Install (ueNodes.Get(u)));
       serverApps.Add (ulPacketSinkHelper.Install (remoteHost));
       serverApps.Add (packetSinkHelper.Install (ueNodes.Get(u)));
@@ -855,17 +883,32 @@ internetDevices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
       // sidelinkClient.SetConstantRate (DataRate ("16kb/s"), 200);
      
       // clientApps.Add(sidelinkClient.Install(ueNodes.Get(u+1)));
+      uint32_t firstClientApp = clientApps.GetN ();
       clientApps.Add (dlClient.Install (remoteHost));
       clientApps.Add (ulClient.Install (ueNodes.Get(u)));
       clientApps.Add (client.Install (remoteHost));
 
+      if (flightRecorder)
+        {
+          // Record the flows of this UE only
+          uint64_t imsi = ueNodes.Get (u)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
+          for (uint32_t ac = firstClientApp; ac < clientApps.GetN (); ac++)
+            {
+              flightRecorder->ConnectApp (clientApps.Get (ac), "TxWithAddresses", imsi);
+            }
+          for (uint32_t ac = firstServerApp; ac < serverApps.GetN (); ac++)
+            {
+              flightRecorder->ConnectApp (serverApps.Get (ac), "RxWithAddresses", imsi);
+            }
+        }
+
     
    for (uint16_t ac = 0; ac < clientApps.GetN (); ac++)
   {
     Ipv4Address localAddrs =  clientApps.Get (ac)->GetNode ()->GetObject<Ipv4L3Protocol> ()->GetAddress (1,0).GetLocal ();
     std::cout << "Tx address: " << localAddrs << std::endl;
     oss << "tx\t" << ueNodes.Get (u)->GetId () << "\t" << ueNodes.Get (u)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-    clientApps.Get (ac)->TraceConnect ("TxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream3, localAddrs));
+    packetTraceWriter->Connect (clientApps.Get (ac), "TxWithAddresses", oss.str (), localAddrs);
     oss.str ("");
   }
 
@@ -875,7 +918,7 @@ internetDevices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
     Ipv4Address localAddrs =  serverApps.Get (ac)->GetNode ()->GetObject<Ipv4L3Protocol> ()->GetAddress (1,0).GetLocal ();
     std::cout << "Rx address: " << localAddrs << std::endl;
     oss << "rx\t" << ueNodes.Get (u)->GetId () << "\t" << ueNodes.Get (u)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-    serverApps.Get (ac)->TraceConnect ("RxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream3, localAddrs));
+    packetTraceWriter->Connect (serverApps.Get (ac), "RxWithAddresses", oss.str (), localAddrs);
     oss.str ("");
   }
 
@@ -916,6 +959,10 @@ internetDevices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
                                  MakeBoundCallback (&PhySyncDetection, n310));
   Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteUeRrc/RadioLinkFailure",
                                  MakeBoundCallback (&RadioLinkFailure, t310));
+  if (flightRecorder)
+    {
+      flightRecorder->ConnectRrcTraces ();
+    }
  
 
   lteHelper->EnableTraces ();
@@ -930,11 +977,34 @@ internetDevices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
   // Uncomment to enable PCAP tracing
   p2ph.EnablePcapAll("basic_first");
 
+  Ptr<TerminationController> termination;
+  if (earlyStop)
+    {
+      termination = Create<TerminationController> (checkInterval);
+      termination->AddSteadyState ("delivery ratio", MakeBoundCallback (&FlowDeliveryRatio, flowMonitor), pdrEpsilon, pdrSamples);
+      termination->Start (Seconds (1) + checkInterval, Seconds (simTime + 0.5)); //the applications start at 1 s
+    }
+
   Simulator::Stop(Seconds(simTime+0.5));
   AnimationInterface anim("ltetryd2d.xml");
   anim.SetMaxPktsPerTraceFile(500000);
   anim.EnablePacketMetadata (true);
   Simulator::Run();
+  packetTraceWriter->Close ();
+  if (flightRecorder)
+    {
+      flightRecorder->Close ();
+      std::cout << "Flight recorder dumps: " << flightRecorder->GetDumps () << std::endl;
+    }
+  Ptr<LruPropagationLossModel> lossCache = lteHelper->GetUplinkPathlossModel ()->GetObject<LruPropagationLossModel> ();
+  if (lossCache)
+    {
+      lossCache->PrintStats (std::cout);
+    }
+  if (termination)
+    {
+      termination->PrintStats (std::cout);
+    }
 
   std::string outputDir = "./";
     std::string simTag= "test1";
@@ -1047,10 +1117,18 @@ internetDevices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
     
     outFile << "\n\n  Mean flow throughput: " << averageFlowThroughput / stats.size() << "\n";
     outFile << "  Mean flow delay: " << averageFlowDelay / stats.size () << "\n";
+    if (termination)
+      {
+        termination->PrintStats (outFile);
+      }
     outFile <<"----------------------------------------Next Simulation -------------------------------------------------------------------------------------" << "\n";
   outFile.close ();
 
   flowMonitor->SerializeToXmlFile("test1.xml", true, true);
+  if (cache)
+    {
+      cache->Store ();
+    }
   /*GtkConfigStore config;
   config.ConfigureAttributes();*/
 
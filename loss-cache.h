@@ -0,0 +1,270 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Bounded LRU cache of a propagation loss model (Hybrid3gpp by default),
+ * for scenarios with many links and slowly moving UEs, where the
+ * pair-loss matrix (pathloss-matrix.h) would be too big or always stale.
+ *
+ * An entry is keyed on (tx node, rx node, tx epoch, rx epoch). The
+ * position epoch of a node is bumped when it has moved more than
+ * Resolution from the position of its current epoch, so a walking UE
+ * reuses its losses for the first meters and then computes new ones;
+ * the entries of old epochs are evicted least recently used first once
+ * Capacity entries are held. Hits, misses and evictions are counted.
+ *
+ *   lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::LruPropagationLossModel"));
+ *   lteHelper->SetPathlossModelAttribute ("Model", StringValue ("ns3::Hybrid3gppPropagationLossModel"));
+ *   lteHelper->SetPathlossModelAttribute ("Capacity", UintegerValue (100000));
+ *   ...
+ *   lteHelper->GetUplinkPathlossModel ()->GetObject<LruPropagationLossModel> ()->PrintStats (std::cout);
+ *
+ * The Frequency set by LteHelper is forwarded to the wrapped model.
+ */
+
+#ifndef LOSS_CACHE_H
+#define LOSS_CACHE_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+
+#include <list>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace ns3 {
+
+class LruPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::LruPropagationLossModel")
+      .SetParent<PropagationLossModel> ()
+      .SetGroupName ("Propagation")
+      .AddConstructor<LruPropagationLossModel> ()
+      .AddAttribute ("Model",
+                     "The TypeId of the wrapped propagation loss model",
+                     StringValue ("ns3::Hybrid3gppPropagationLossModel"),
+                     MakeStringAccessor (&LruPropagationLossModel::m_modelType),
+                     MakeStringChecker ())
+      .AddAttribute ("Capacity",
+                     "The maximum number of cached losses",
+                     UintegerValue (100000),
+                     MakeUintegerAccessor (&LruPropagationLossModel::m_capacity),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("Resolution",
+                     "The distance (m) a node moves before its losses are computed again",
+                     DoubleValue (1.0),
+                     MakeDoubleAccessor (&LruPropagationLossModel::m_resolution),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("Frequency",
+                     "The carrier frequency (Hz) given to the wrapped model, 0 to keep its own",
+                     DoubleValue (0),
+                     MakeDoubleAccessor (&LruPropagationLossModel::SetFrequency,
+                                         &LruPropagationLossModel::GetFrequency),
+                     MakeDoubleChecker<double> (0))
+    ;
+    return tid;
+  }
+
+  LruPropagationLossModel (void)
+    : m_frequency (0),
+      m_hits (0),
+      m_misses (0),
+      m_evictions (0)
+  { }
+
+  /**
+   * \return The wrapped model.
+   */
+  Ptr<PropagationLossModel> GetModel (void) const
+  {
+    if (m_model == 0)
+      {
+        ObjectFactory factory;
+        factory.SetTypeId (m_modelType);
+        m_model = factory.Create<PropagationLossModel> ();
+        if (m_frequency > 0)
+          {
+            m_model->SetAttributeFailSafe ("Frequency", DoubleValue (m_frequency));
+          }
+      }
+    return m_model;
+  }
+
+  /**
+   * \param frequency The carrier frequency (Hz) of the wrapped model.
+   */
+  void SetFrequency (double frequency)
+  {
+    m_frequency = frequency;
+    if (m_model != 0 && frequency > 0)
+      {
+        m_model->SetAttributeFailSafe ("Frequency", DoubleValue (frequency));
+        Clear ();
+      }
+  }
+
+  /**
+   * \return The carrier frequency (Hz) given to the wrapped model, 0 if none.
+   */
+  double GetFrequency (void) const
+  {
+    return m_frequency;
+  }
+
+  /**
+   * Drop every cached loss, e.g. after a change of the wrapped model's
+   * attributes.
+   */
+  void Clear (void)
+  {
+    m_lru.clear ();
+    m_entries.clear ();
+  }
+
+  /**
+   * \return The number of losses found in the cache.
+   */
+  uint64_t GetHits (void) const
+  {
+    return m_hits;
+  }
+
+  /**
+   * \return The number of losses computed by the wrapped model.
+   */
+  uint64_t GetMisses (void) const
+  {
+    return m_misses;
+  }
+
+  /**
+   * \return The number of losses dropped to stay within the capacity.
+   */
+  uint64_t GetEvictions (void) const
+  {
+    return m_evictions;
+  }
+
+  /**
+   * \param os The stream to print the counters to.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    uint64_t lookups = m_hits + m_misses;
+    os << "loss cache: " << m_hits << " hits, " << m_misses << " misses ("
+       << (lookups ? 100.0 * m_hits / lookups : 0) << "% hit rate), "
+       << m_evictions << " evictions, " << m_entries.size () << "/" << m_capacity << " entries"
+       << std::endl;
+  }
+
+private:
+  struct Key
+  {
+    uint32_t tx;        //!< The index of the transmitter.
+    uint32_t rx;        //!< The index of the receiver.
+    uint32_t txEpoch;   //!< The position epoch of the transmitter.
+    uint32_t rxEpoch;   //!< The position epoch of the receiver.
+
+    bool operator== (const Key &other) const
+    {
+      return tx == other.tx && rx == other.rx && txEpoch == other.txEpoch && rxEpoch == other.rxEpoch;
+    }
+  };
+
+  struct KeyHash
+  {
+    std::size_t operator() (const Key &key) const
+    {
+      uint64_t nodes = ((uint64_t) key.tx << 32) | key.rx;
+      uint64_t epochs = ((uint64_t) key.txEpoch << 32) | key.rxEpoch;
+      return std::hash<uint64_t> () (nodes ^ (epochs * 0x9e3779b97f4a7c15ULL));
+    }
+  };
+
+  struct Node
+  {
+    uint32_t index;     //!< The index of the node.
+    uint32_t epoch;     //!< Its position epoch.
+    Vector position;    //!< Its position at the start of the epoch.
+  };
+
+  typedef std::list<std::pair<Key, double> > LruList;
+
+  virtual double DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+  {
+    const Node &tx = Track (a);
+    const Node &rx = Track (b);
+    Key key = { tx.index, rx.index, tx.epoch, rx.epoch };
+    std::unordered_map<Key, LruList::iterator, KeyHash>::iterator entry = m_entries.find (key);
+    if (entry != m_entries.end ())
+      {
+        ++m_hits;
+        m_lru.splice (m_lru.begin (), m_lru, entry->second);
+        return txPowerDbm - entry->second->second;
+      }
+    ++m_misses;
+    double loss = -GetModel ()->CalcRxPower (0, a, b);
+    if (m_entries.size () >= m_capacity)
+      {
+        m_entries.erase (m_lru.back ().first);
+        m_lru.pop_back ();
+        ++m_evictions;
+      }
+    m_lru.push_front (std::make_pair (key, loss));
+    m_entries[key] = m_lru.begin ();
+    return txPowerDbm - loss;
+  }
+
+  virtual int64_t DoAssignStreams (int64_t stream)
+  {
+    return GetModel ()->AssignStreams (stream);
+  }
+
+  virtual void DoDispose (void)
+  {
+    Clear ();
+    m_nodes.clear ();
+    m_model = 0;
+    PropagationLossModel::DoDispose ();
+  }
+
+  // the node of a mobility model, with its epoch brought up to date
+  const Node &Track (Ptr<MobilityModel> mobility) const
+  {
+    Vector position = mobility->GetPosition ();
+    std::unordered_map<const MobilityModel *, Node>::iterator it = m_nodes.find (PeekPointer (mobility));
+    if (it == m_nodes.end ())
+      {
+        Node node = { (uint32_t) m_nodes.size (), 0, position };
+        return m_nodes.insert (std::make_pair (PeekPointer (mobility), node)).first->second;
+      }
+    if (CalculateDistance (position, it->second.position) > m_resolution)
+      {
+        ++it->second.epoch;
+        it->second.position = position;
+      }
+    return it->second;
+  }
+
+  std::string m_modelType;                                                      //!< The TypeId of the wrapped model.
+  uint32_t m_capacity;                                                          //!< The maximum number of entries.
+  double m_resolution;                                                          //!< The distance that starts a new epoch (m).
+  double m_frequency;                                                           //!< The frequency of the wrapped model, 0 if its own.
+  mutable Ptr<PropagationLossModel> m_model;                                    //!< The wrapped model, created on first use.
+  mutable std::unordered_map<const MobilityModel *, Node> m_nodes;              //!< The nodes seen so far.
+  mutable LruList m_lru;                                                        //!< The losses (dB), most recently used first.
+  mutable std::unordered_map<Key, LruList::iterator, KeyHash> m_entries;        //!< The losses by key.
+  mutable uint64_t m_hits;                                                      //!< The lookups found in the cache.
+  mutable uint64_t m_misses;                                                    //!< The lookups computed.
+  mutable uint64_t m_evictions;                                                 //!< The entries dropped.
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LruPropagationLossModel);
+
+} // namespace ns3
+
+#endif /* LOSS_CACHE_H */
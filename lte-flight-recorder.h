@@ -0,0 +1,353 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Flight recorder for LTE UE failures.
+ *
+ * Every UE keeps an in-memory ring of its last N trace records (application
+ * packets, RRC state transitions, PHY in/out-of-sync indications). Records
+ * are fixed-size and nothing is formatted or written while the run is
+ * healthy. When RadioLinkFailure, RrcTimeout or RandomAccessError fires for
+ * a UE, the records of the preceding window are kept aside and, once the
+ * following window has elapsed, both are written to the dump file:
+ *
+ *   === IMSI 3 RadioLinkFailure at 4.236 s (window 1 s before, 0.5 s after)
+ *   4.1     tx     250 bytes  7.0.0.2:49153 -> 1.0.0.2:2001
+ *   4.2     sync   cell 1 RNTI 3 out of sync (1)
+ *   4.236   RLF    cell 1 RNTI 3  <<<
+ *
+ * The ring must be large enough to hold both windows for the busiest UE;
+ * a dump whose after-window was partly overwritten says so.
+ */
+
+#ifndef LTE_FLIGHT_RECORDER_H
+#define LTE_FLIGHT_RECORDER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/lte-module.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class LteFlightRecorder : public SimpleRefCount<LteFlightRecorder>
+{
+public:
+  enum Kind
+  {
+    PKT_TX,
+    PKT_RX,
+    RRC_STATE,
+    PHY_SYNC,
+    RLF,
+    RRC_TIMEOUT,
+    RA_ERROR
+  };
+
+  /**
+   * One trace event of a UE.
+   */
+  struct Record
+  {
+    int64_t timeNs;     //!< The simulation time, in nanoseconds.
+    uint8_t kind;       //!< The Kind.
+    uint8_t from;       //!< RRC_STATE: old state; PHY_SYNC: 1 if out of sync.
+    uint8_t to;         //!< RRC_STATE: new state; PHY_SYNC: indication count.
+    uint16_t cellId;    //!< The cell ID.
+    uint16_t rnti;      //!< The RNTI.
+    uint16_t srcPort;   //!< PKT_*: the source port.
+    uint16_t dstPort;   //!< PKT_*: the destination port.
+    uint32_t size;      //!< PKT_*: the packet size, in bytes.
+    uint32_t srcAddr;   //!< PKT_*: the IPv4 source address.
+    uint32_t dstAddr;   //!< PKT_*: the IPv4 destination address.
+  };
+
+  /**
+   * \param filename The dump file, created on the first dump.
+   * \param capacity The number of records kept per UE.
+   * \param before The window dumped before a failure.
+   * \param after The window dumped after a failure.
+   */
+  LteFlightRecorder (std::string filename, uint32_t capacity, Time before, Time after)
+    : m_filename (filename),
+      m_capacity (capacity),
+      m_before (before),
+      m_after (after),
+      m_dumps (0)
+  {
+    NS_ABORT_MSG_IF (capacity == 0, "Empty flight recorder");
+  }
+
+  /**
+   * Connect the RRC traces of every UE and eNB and the failure triggers.
+   */
+  void ConnectRrcTraces (void)
+  {
+    Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteUeRrc/StateTransition",
+                                   MakeCallback (&LteFlightRecorder::NotifyStateTransition, this));
+    Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteUeRrc/PhySyncDetection",
+                                   MakeCallback (&LteFlightRecorder::NotifyPhySync, this));
+    Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteUeRrc/RadioLinkFailure",
+                                   MakeCallback (&LteFlightRecorder::NotifyRadioLinkFailure, this));
+    Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteUeRrc/RandomAccessError",
+                                   MakeCallback (&LteFlightRecorder::NotifyRandomAccessError, this));
+    Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteEnbRrc/RrcTimeout",
+                                   MakeCallback (&LteFlightRecorder::NotifyRrcTimeout, this));
+  }
+
+  /**
+   * Record the packets of an application ("TxWithAddresses" or
+   * "RxWithAddresses") in the ring of a UE.
+   * \param app The application.
+   * \param traceSource The trace source name.
+   * \param imsi The UE the packets belong to.
+   */
+  void ConnectApp (Ptr<Application> app, std::string traceSource, uint64_t imsi)
+  {
+    uint8_t kind = traceSource.compare (0, 2, "Tx") == 0 ? PKT_TX : PKT_RX;
+    app->TraceConnectWithoutContext (traceSource, MakeBoundCallback (&LteFlightRecorder::PacketTrace,
+                                                                     Ptr<LteFlightRecorder> (this),
+                                                                     imsi, kind));
+  }
+
+  /**
+   * Write the dumps whose after-window has not elapsed yet. Call after
+   * Simulator::Run.
+   */
+  void Close (void)
+  {
+    for (uint32_t i = 0; i < m_pending.size (); ++i)
+      {
+        if (!m_pending[i].done)
+          {
+            Dump (i);
+          }
+      }
+    if (m_file.is_open ())
+      {
+        m_file.close ();
+      }
+  }
+
+  /**
+   * \return The number of dumps written.
+   */
+  uint32_t GetDumps (void) const
+  {
+    return m_dumps;
+  }
+
+  static void PacketTrace (Ptr<LteFlightRecorder> recorder, uint64_t imsi, uint8_t kind,
+                           Ptr<const Packet> p, const Address &srcAddrs, const Address &dstAddrs)
+  {
+    Record &r = recorder->Append (imsi, kind);
+    r.size = p->GetSize ();
+    if (InetSocketAddress::IsMatchingType (srcAddrs))
+      {
+        r.srcAddr = InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 ().Get ();
+        r.srcPort = InetSocketAddress::ConvertFrom (srcAddrs).GetPort ();
+        r.dstAddr = InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 ().Get ();
+        r.dstPort = InetSocketAddress::ConvertFrom (dstAddrs).GetPort ();
+      }
+  }
+
+  void NotifyStateTransition (uint64_t imsi, uint16_t cellId, uint16_t rnti,
+                              LteUeRrc::State oldState, LteUeRrc::State newState)
+  {
+    Record &r = Append (imsi, RRC_STATE, cellId, rnti);
+    r.from = oldState;
+    r.to = newState;
+  }
+
+  void NotifyPhySync (uint64_t imsi, uint16_t rnti, uint16_t cellId, std::string type, uint8_t count)
+  {
+    Record &r = Append (imsi, PHY_SYNC, cellId, rnti);
+    r.from = type == "Notify out of sync";
+    r.to = count;
+  }
+
+  void NotifyRadioLinkFailure (uint64_t imsi, uint16_t cellId, uint16_t rnti)
+  {
+    Append (imsi, RLF, cellId, rnti);
+    Trigger (imsi, "RadioLinkFailure");
+  }
+
+  void NotifyRandomAccessError (uint64_t imsi, uint16_t cellId, uint16_t rnti)
+  {
+    Append (imsi, RA_ERROR, cellId, rnti);
+    Trigger (imsi, "RandomAccessError");
+  }
+
+  void NotifyRrcTimeout (uint64_t imsi, uint16_t rnti, uint16_t cellId, std::string cause)
+  {
+    Append (imsi, RRC_TIMEOUT, cellId, rnti);
+    Trigger (imsi, "RrcTimeout (" + cause + ")");
+  }
+
+private:
+  /**
+   * The last records of one UE.
+   */
+  struct Ring
+  {
+    std::vector<Record> records; //!< The storage, filled up to the capacity.
+    uint64_t next;               //!< The total number of records appended.
+  };
+
+  /**
+   * A failure whose dump is pending or written.
+   */
+  struct Pending
+  {
+    uint64_t imsi;                //!< The UE.
+    std::string cause;            //!< The trigger.
+    int64_t timeNs;               //!< The time of the trigger.
+    uint64_t seq;                 //!< The ring position of the trigger record.
+    std::vector<Record> before;   //!< The records of the before-window.
+    bool done;                    //!< True once written.
+  };
+
+  Record & Append (uint64_t imsi, uint8_t kind, uint16_t cellId = 0, uint16_t rnti = 0)
+  {
+    Ring &ring = m_rings[imsi];
+    if (ring.records.empty ())
+      {
+        ring.records.reserve (m_capacity);
+        ring.next = 0;
+      }
+    Record r;
+    std::memset (&r, 0, sizeof (r));
+    r.timeNs = Simulator::Now ().GetNanoSeconds ();
+    r.kind = kind;
+    r.cellId = cellId;
+    r.rnti = rnti;
+    uint64_t pos = ring.next++;
+    if (ring.records.size () < m_capacity)
+      {
+        ring.records.push_back (r);
+        return ring.records.back ();
+      }
+    ring.records[pos % m_capacity] = r;
+    return ring.records[pos % m_capacity];
+  }
+
+  void Trigger (uint64_t imsi, std::string cause)
+  {
+    const Ring &ring = m_rings[imsi];
+    Pending pending;
+    pending.imsi = imsi;
+    pending.cause = cause;
+    pending.timeNs = Simulator::Now ().GetNanoSeconds ();
+    pending.seq = ring.next - 1;
+    pending.done = false;
+    uint64_t first = ring.next > ring.records.size () ? ring.next - ring.records.size () : 0;
+    for (uint64_t s = first; s <= pending.seq; ++s)
+      {
+        const Record &r = ring.records[s % m_capacity];
+        if (r.timeNs >= pending.timeNs - m_before.GetNanoSeconds ())
+          {
+            pending.before.push_back (r);
+          }
+      }
+    m_pending.push_back (pending);
+    Simulator::Schedule (m_after, &LteFlightRecorder::Dump, this, (uint32_t) m_pending.size () - 1);
+  }
+
+  void Dump (uint32_t id)
+  {
+    Pending &pending = m_pending[id];
+    if (pending.done)
+      {
+        return;
+      }
+    pending.done = true;
+    if (!m_file.is_open ())
+      {
+        m_file.open (m_filename.c_str (), std::ofstream::out | std::ofstream::trunc);
+        NS_ABORT_MSG_UNLESS (m_file.is_open (), "Can't open file " << m_filename);
+      }
+    m_file << "=== IMSI " << pending.imsi << " " << pending.cause << " at " << pending.timeNs / (double) 1e9
+           << " s (window " << m_before.GetSeconds () << " s before, " << m_after.GetSeconds () << " s after)\n";
+    for (uint32_t i = 0; i < pending.before.size (); ++i)
+      {
+        Print (pending.before[i]);
+        if (i + 1 == pending.before.size ())
+          {
+            m_file << "  <<<";
+          }
+        m_file << "\n";
+      }
+    const Ring &ring = m_rings[pending.imsi];
+    uint64_t first = ring.next > ring.records.size () ? ring.next - ring.records.size () : 0;
+    if (first > pending.seq + 1)
+      {
+        m_file << "(" << first - pending.seq - 1 << " records after the failure were overwritten; increase the ring size)\n";
+      }
+    int64_t end = pending.timeNs + m_after.GetNanoSeconds ();
+    for (uint64_t s = std::max (first, pending.seq + 1); s < ring.next; ++s)
+      {
+        const Record &r = ring.records[s % m_capacity];
+        if (r.timeNs > end)
+          {
+            break;
+          }
+        Print (r);
+        m_file << "\n";
+      }
+    m_file << "\n";
+    m_file.flush ();
+    ++m_dumps;
+  }
+
+  void Print (const Record &r)
+  {
+    static const char *kindName[] = { "tx", "rx", "rrc", "sync", "RLF", "RrcTimeout", "RAError" };
+    m_file << r.timeNs / (double) 1e9 << "\t" << kindName[r.kind] << "\t";
+    switch (r.kind)
+      {
+      case PKT_TX:
+      case PKT_RX:
+        m_file << r.size << " bytes\t" << Ipv4Address (r.srcAddr) << ":" << r.srcPort
+               << " -> " << Ipv4Address (r.dstAddr) << ":" << r.dstPort;
+        break;
+      case RRC_STATE:
+        m_file << "cell " << r.cellId << " RNTI " << r.rnti << " " << StateName (r.from) << " -> " << StateName (r.to);
+        break;
+      case PHY_SYNC:
+        m_file << "cell " << r.cellId << " RNTI " << r.rnti << (r.from ? " out of sync (" : " in sync (") << +r.to << ")";
+        break;
+      default:
+        m_file << "cell " << r.cellId << " RNTI " << r.rnti;
+        break;
+      }
+  }
+
+  static std::string StateName (uint8_t s)
+  {
+    static const char *names[] =
+    {
+      "IDLE_START", "IDLE_CELL_SEARCH", "IDLE_WAIT_MIB_SIB1", "IDLE_WAIT_MIB", "IDLE_WAIT_SIB1",
+      "IDLE_CAMPED_NORMALLY", "IDLE_WAIT_SIB2", "IDLE_RANDOM_ACCESS", "IDLE_CONNECTING",
+      "CONNECTED_NORMALLY", "CONNECTED_HANDOVER", "CONNECTED_PHY_PROBLEM", "CONNECTED_REESTABLISHING"
+    };
+    return s < sizeof (names) / sizeof (names[0]) ? names[s] : "UNKNOWN";
+  }
+
+  std::string m_filename;                  //!< The dump file name.
+  std::ofstream m_file;                    //!< The dump file.
+  uint32_t m_capacity;                     //!< The records kept per UE.
+  Time m_before;                           //!< The window before a failure.
+  Time m_after;                            //!< The window after a failure.
+  std::map<uint64_t, Ring> m_rings;        //!< The ring of each IMSI.
+  std::vector<Pending> m_pending;          //!< The failures seen so far.
+  uint32_t m_dumps;                        //!< The dumps written.
+};
+
+} // namespace ns3
+
+#endif /* LTE_FLIGHT_RECORDER_H */
@@ -47,6 +47,8 @@
 #include <math.h>
 #include "ns3/gnuplot.h"
 #include "ns3/netanim-module.h"
+#include "packet-trace-writer.h"
+#include "grid-spectrum-channel.h"
 
 using namespace ns3;
 
@@ -109,27 +111,6 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("lte-sl-relay-cluster");
 
-/*
- * Trace sink function for logging when a packet is transmitted or received
- * at the application layer
- */
-void
-UePacketTrace (Ptr<OutputStreamWrapper> stream, std::string context, Ptr<const Packet> p, const Address &srcAddrs, const Address &dstAddrs)
-{
-  std::ostringstream oss;
-  stream->GetStream ()->precision (6);
-
-  *stream->GetStream () << Simulator::Now ().GetNanoSeconds () / (double) 1e9 << "\t"
-                        << context << "\t"
-                        << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 () << ":"
-                        << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t"
-                        << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 () << ":"
-                        << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << "\t"
-                        << p->GetSize () << "\t"
-                        << std::endl;
-
-}
-
 /**
  * Function that generates a gnuplot script file that can be used to plot the
  * topology of the scenario access network (eNBs, Relay UEs and Remote UEs)
@@ -207,11 +188,17 @@ GenerateTopologyPlotFile (NodeContainer enbNode, NodeContainer relayUeNodes, Nod
  * Trace sink function for logging when PC5 signaling messages are received
  */
 void
-TraceSinkPC5SignalingPacketTrace (Ptr<OutputStreamWrapper> stream, uint32_t srcL2Id, uint32_t dstL2Id, Ptr<Packet> p)
+TraceSinkPC5SignalingPacketTrace (Ptr<FilteredTraceStream> trace, uint32_t srcL2Id, uint32_t dstL2Id, Ptr<Packet> p)
 {
+  if (!trace->Accept (p->GetSize ()))
+    {
+      return;
+    }
   LteSlPc5SignallingMessageType lpc5smt;
   p->PeekHeader (lpc5smt);
-  *stream->GetStream () << Simulator::Now ().GetSeconds () << "\t" << srcL2Id << "\t" << dstL2Id << "\t" << lpc5smt.GetMessageName () << std::endl;
+  std::ostringstream line;
+  line << Simulator::Now ().GetSeconds () << "\t" << srcL2Id << "\t" << dstL2Id << "\t" << lpc5smt.GetMessageName () << "\n";
+  trace->Write (line.str ());
 }
 
 /**
@@ -247,6 +234,11 @@ int main (int argc, char *argv[])
   uint32_t nRemoteUesPerRelay = 2;
   bool remoteUesOoc = true;
   std::string echoServerNode ("RemoteUE");
+  bool binaryTraces = false;
+  std::string traceFilter = "";
+  bool gridChannel = false;
+  double cullMargin = 10; //dB
+  double cullExponent = 3.5;
 
   CommandLine cmd;
 
@@ -256,6 +248,11 @@ int main (int argc, char *argv[])
   cmd.AddValue ("nRemoteUesPerRelay", "Number of Remote UEs per deployed Relay UE", nRemoteUesPerRelay);
   cmd.AddValue ("remoteUesOoc", "The Remote UEs are out-of-coverage", remoteUesOoc);
   cmd.AddValue ("echoServerNode", "The node towards which the Remote UE traffic is directed to (RemoteHost|RemoteUE)", echoServerNode);
+  cmd.AddValue ("binaryTraces", "Write the application packet trace in the binary format (see packet-trace-convert)", binaryTraces);
+  cmd.AddValue ("traceFilter", "Packet trace subscription, e.g. \"nodes=3,4;ports=8000;dir=rx;size=0-512;sample=1/10\" (see packet-trace-filter.h)", traceFilter);
+  cmd.AddValue ("gridChannel", "Only forward a signal to the UEs in range of it (see grid-spectrum-channel.h)", gridChannel);
+  cmd.AddValue ("cullMargin", "With gridChannel, how far (dB) under the noise level a receiver is skipped", cullMargin);
+  cmd.AddValue ("cullExponent", "With gridChannel, the path loss exponent bounding the range of a signal", cullExponent);
 
   cmd.Parse (argc, argv);
 
@@ -363,6 +360,14 @@ int main (int argc, char *argv[])
   //Set pathloss model
   lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Hybrid3gppPropagationLossModel"));
 
+  //Skip the receivers out of range of a signal, for large deployments
+  if (gridChannel)
+    {
+      lteHelper->SetSpectrumChannelType ("ns3::GridSpectrumChannel");
+      lteHelper->SetSpectrumChannelAttribute ("CullMargin", DoubleValue (cullMargin));
+      lteHelper->SetSpectrumChannelAttribute ("LossExponent", DoubleValue (cullExponent));
+    }
+
   //Enable Sidelink
   lteHelper->SetAttribute ("UseSidelink", BooleanValue (true));
 
@@ -648,8 +653,10 @@ int main (int argc, char *argv[])
   AsciiTraceHelper ascii;
 
   std::ostringstream oss;
-  Ptr<OutputStreamWrapper> packetOutputStream = ascii.CreateFileStream ("AppPacketTrace.txt");
-  *packetOutputStream->GetStream () << "time(sec)\ttx/rx\tC/S\tNodeID\tIP[src]\tIP[dst]\tPktSize(bytes)" << std::endl;
+  Ptr<AsyncPacketTraceWriter> packetTraceWriter = Create<AsyncPacketTraceWriter> (binaryTraces ? "AppPacketTrace.bin" : "AppPacketTrace.txt",
+    "time(sec)\ttx/rx\tC/S\tNodeID\tIP[src]\tIP[dst]\tPktSize(bytes)",
+    PacketTraceRecord::SIZE_LAST, binaryTraces ? AsyncPacketTraceWriter::BINARY : AsyncPacketTraceWriter::TEXT);
+  packetTraceWriter->SetFilter (Create<PacketTraceFilter> (traceFilter));
 
   for (uint16_t remUeIdx = 0; remUeIdx < remoteUeNodes.GetN (); remUeIdx++)
     {
@@ -680,10 +687,10 @@ int main (int argc, char *argv[])
 
       //Tracing packets on the UdpEchoServer (S)
       oss << "rx\tS\t" << echoServerNodeId;
-      singleServerApp.Get (0)->TraceConnect ("RxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, packetOutputStream));
+      packetTraceWriter->Connect (singleServerApp.Get (0), "RxWithAddresses", oss.str ());
       oss.str ("");
       oss << "tx\tS\t" << echoServerNodeId;
-      singleServerApp.Get (0)->TraceConnect ("TxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, packetOutputStream));
+      packetTraceWriter->Connect (singleServerApp.Get (0), "TxWithAddresses", oss.str ());
       oss.str ("");
 
       serverApps.Add (singleServerApp);
@@ -704,10 +711,10 @@ int main (int argc, char *argv[])
 
       //Tracing packets on the UdpEchoClient (C)
       oss << "tx\tC\t" << remoteUeNodes.Get (remUeIdx)->GetId ();
-      singleClientApp.Get (0)->TraceConnect ("TxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, packetOutputStream));
+      packetTraceWriter->Connect (singleClientApp.Get (0), "TxWithAddresses", oss.str ());
       oss.str ("");
       oss << "rx\tC\t" << remoteUeNodes.Get (remUeIdx)->GetId ();
-      singleClientApp.Get (0)->TraceConnect ("RxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, packetOutputStream));
+      packetTraceWriter->Connect (singleClientApp.Get (0), "RxWithAddresses", oss.str ());
       oss.str ("");
 
       clientApps.Add (singleClientApp);
@@ -757,26 +764,37 @@ int main (int argc, char *argv[])
   //Tracing PC5 signaling messages
   Ptr<OutputStreamWrapper> PC5SignalingPacketTraceStream = ascii.CreateFileStream ("PC5SignalingPacketTrace.txt");
   *PC5SignalingPacketTraceStream->GetStream () << "time(s)\ttxId\tRxId\tmsgType" << std::endl;
+  Ptr<PacketTraceFilter> pc5TraceFilter = Create<PacketTraceFilter> (traceFilter);
+  Ptr<FilteredTraceStream> pc5Trace = Create<FilteredTraceStream> (PC5SignalingPacketTraceStream, pc5TraceFilter);
+  //the direction term is for the application traces: this one only has receptions
 
   for (uint32_t ueDevIdx = 0; ueDevIdx < relayUeDevs.GetN (); ueDevIdx++)
     {
+      if (!pc5TraceFilter->IsSubscribed (relayUeDevs.Get (ueDevIdx)->GetNode ()->GetId (), PacketTraceFilter::BOTH))
+        {
+          continue;
+        }
       Ptr<LteUeRrc> rrc = relayUeDevs.Get (ueDevIdx)->GetObject<LteUeNetDevice> ()->GetRrc ();
       PointerValue ptrOne;
       rrc->GetAttribute ("SidelinkConfiguration", ptrOne);
       Ptr<LteSlUeRrc> slUeRrc = ptrOne.Get<LteSlUeRrc> ();
       slUeRrc->TraceConnectWithoutContext ("PC5SignalingPacketTrace",
                                            MakeBoundCallback (&TraceSinkPC5SignalingPacketTrace,
-                                                              PC5SignalingPacketTraceStream));
+                                                              pc5Trace));
     }
   for (uint32_t ueDevIdx = 0; ueDevIdx < remoteUeDevs.GetN (); ueDevIdx++)
     {
+      if (!pc5TraceFilter->IsSubscribed (remoteUeDevs.Get (ueDevIdx)->GetNode ()->GetId (), PacketTraceFilter::BOTH))
+        {
+          continue;
+        }
       Ptr<LteUeRrc> rrc = remoteUeDevs.Get (ueDevIdx)->GetObject<LteUeNetDevice> ()->GetRrc ();
       PointerValue ptrOne;
       rrc->GetAttribute ("SidelinkConfiguration", ptrOne);
       Ptr<LteSlUeRrc> slUeRrc = ptrOne.Get<LteSlUeRrc> ();
       slUeRrc->TraceConnectWithoutContext ("PC5SignalingPacketTrace",
                                            MakeBoundCallback (&TraceSinkPC5SignalingPacketTrace,
-                                                              PC5SignalingPacketTraceStream));
+                                                              pc5Trace));
     }
 
   lteHelper->EnablePdcpTraces ();
@@ -794,6 +812,13 @@ int main (int argc, char *argv[])
   Simulator::Stop (Seconds (simTime));
    std::cout << 8 << std::endl;
   Simulator::Run ();
+  packetTraceWriter->Close ();
+  pc5Trace->Close ();
+  Ptr<GridSpectrumChannel> gridUlChannel = DynamicCast<GridSpectrumChannel> (lteHelper->GetUplinkSpectrumChannel ());
+  if (gridUlChannel)
+    {
+      gridUlChannel->PrintStats (std::cout);
+    }
  std::cout << 9 << std::endl;
   Simulator::Destroy ();
   return 0;
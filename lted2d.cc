@@ -6,6 +6,7 @@
 #include "ns3/applications-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/config-store.h"
+#include "packet-trace-writer.h"
 #include <cfloat>
 #include <sstream>
 #include <iostream>
@@ -32,64 +33,6 @@
 
 using namespace ns3;
 
-// This trace will log packet transmissions and receptions from the application
-// layer.  The parameter 'localAddrs' is passed to this trace in case the
-// address passed by the trace is not set (i.e., is '0.0.0.0' or '::').  The
-// trace writes to a file stream provided by the first argument; by default,
-// this trace file is 'UePacketTrace.tr'
-void
-UePacketTrace (Ptr<OutputStreamWrapper> stream, const Address &localAddrs, std::string context, Ptr<const Packet> p, const Address &srcAddrs, const Address &dstAddrs)
-{
-  std::ostringstream oss;
-  *stream->GetStream () << Simulator::Now ().GetNanoSeconds () / (double) 1e9 << "\t" << context << "\t" << p->GetSize () << "\t";
-  if (InetSocketAddress::IsMatchingType (srcAddrs))
-    {
-      oss << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 ();
-      if (!oss.str ().compare ("0.0.0.0")) //srcAddrs not set
-        {
-          *stream->GetStream () << Ipv4Address::ConvertFrom (localAddrs) << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-        }
-      else
-        {
-          oss.str ("");
-          oss << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 ();
-          if (!oss.str ().compare ("0.0.0.0")) //dstAddrs not set
-            {
-              *stream->GetStream () << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" <<  Ipv4Address::ConvertFrom (localAddrs) << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-          else
-            {
-              *stream->GetStream () << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-        }
-    }
-  else if (Inet6SocketAddress::IsMatchingType (srcAddrs))
-    {
-      oss << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 ();
-      if (!oss.str ().compare ("::")) //srcAddrs not set
-        {
-          *stream->GetStream () << Ipv6Address::ConvertFrom (localAddrs) << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-        }
-      else
-        {
-          oss.str ("");
-          oss << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 ();
-          if (!oss.str ().compare ("::")) //dstAddrs not set
-            {
-              *stream->GetStream () << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Ipv6Address::ConvertFrom (localAddrs) << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-          else
-            {
-              *stream->GetStream () << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-        }
-    }
-  else
-    {
-      *stream->GetStream () << "Unknown address type!" << std::endl;
-    }
-}
-
 /*
  * The topology is the following:
  *
@@ -106,6 +49,8 @@ int main (int argc, char *argv[])
   Time simTime = Seconds (10);
   bool enableNsLogs = false;
   bool useIPv6 = false;
+  bool binaryTraces = false;
+  std::string traceFilter = "";
   int ueNodeNum =25;
   bool useCa = false;
   int m_nodeSpeed = 20;
@@ -115,6 +60,8 @@ int main (int argc, char *argv[])
   cmd.AddValue ("simTime", "Total duration of the simulation", simTime);
   cmd.AddValue ("enableNsLogs", "Enable ns-3 logging (debug builds)", enableNsLogs);
   cmd.AddValue ("useIPv6", "Use IPv6 instead of IPv4", useIPv6);
+  cmd.AddValue ("binaryTraces", "Write the application packet trace in the binary format (see packet-trace-convert)", binaryTraces);
+  cmd.AddValue ("traceFilter", "Packet trace subscription, e.g. \"nodes=3,4;ports=8000;dir=rx;size=0-512;sample=1/10\" (see packet-trace-filter.h)", traceFilter);
   cmd.Parse (argc, argv);
 
   // Configure the scheduler
@@ -388,11 +335,10 @@ int main (int argc, char *argv[])
   proseHelper->ActivateSidelinkBearer (slBearersActivationTime, ueDevs, tft);
   ///*** End of application configuration ***///
 
-  AsciiTraceHelper ascii;
-  Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream ("UePacketTrace.tr");
-
-  //Trace file table header
-  *stream->GetStream () << "time(sec)\ttx/rx\tNodeID\tIMSI\tPktSize(bytes)\tIP[src]\tIP[dst]" << std::endl;
+  Ptr<AsyncPacketTraceWriter> packetTraceWriter = Create<AsyncPacketTraceWriter> (binaryTraces ? "UePacketTrace.bin" : "UePacketTrace.tr",
+    "time(sec)\ttx/rx\tNodeID\tIMSI\tPktSize(bytes)\tIP[src]\tIP[dst]",
+    PacketTraceRecord::SIZE_FIRST, binaryTraces ? AsyncPacketTraceWriter::BINARY : AsyncPacketTraceWriter::TEXT);
+  packetTraceWriter->SetFilter (Create<PacketTraceFilter> (traceFilter));
 
   std::ostringstream oss;
   for (uint16_t i=0; i< ueNodes.GetN()  ; i++)
@@ -405,7 +351,7 @@ int main (int argc, char *argv[])
           Ipv4Address localAddrs =  clientApps.Get (ac)->GetNode ()->GetObject<Ipv4L3Protocol> ()->GetAddress (1,0).GetLocal ();
           std::cout << "Tx address: " << localAddrs << std::endl;
           oss << "tx\t" << ueNodes.Get (i)->GetId () << "\t" << ueNodes.Get (0)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-          clientApps.Get (ac)->TraceConnect ("TxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream, localAddrs));
+          packetTraceWriter->Connect (clientApps.Get (ac), "TxWithAddresses", oss.str (), localAddrs);
           oss.str ("");
         }
 
@@ -415,7 +361,7 @@ int main (int argc, char *argv[])
           Ipv4Address localAddrs =  serverApps.Get (ac)->GetNode ()->GetObject<Ipv4L3Protocol> ()->GetAddress (1,0).GetLocal ();
           std::cout << "Rx address: " << localAddrs << std::endl;
           oss << "rx\t" << ueNodes.Get (i)->GetId () << "\t" << ueNodes.Get (1)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-          serverApps.Get (ac)->TraceConnect ("RxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream, localAddrs));
+          packetTraceWriter->Connect (serverApps.Get (ac), "RxWithAddresses", oss.str (), localAddrs);
           oss.str ("");
         }
     }
@@ -428,7 +374,7 @@ int main (int argc, char *argv[])
           Ipv6Address localAddrs =  clientApps.Get (ac)->GetNode ()->GetObject<Ipv6L3Protocol> ()->GetAddress (1,1).GetAddress ();
           std::cout << "Tx address: " << localAddrs << std::endl;
           oss << "tx\t" << ueNodes.Get (i)->GetId () << "\t" << ueNodes.Get (0)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-          clientApps.Get (ac)->TraceConnect ("TxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream, localAddrs));
+          packetTraceWriter->Connect (clientApps.Get (ac), "TxWithAddresses", oss.str (), localAddrs);
           oss.str ("");
         }
 
@@ -439,7 +385,7 @@ int main (int argc, char *argv[])
           Ipv6Address localAddrs =  serverApps.Get (ac)->GetNode ()->GetObject<Ipv6L3Protocol> ()->GetAddress (1,1).GetAddress ();
           std::cout << "Rx address: " << localAddrs << std::endl;
           oss << "rx\t" << ueNodes.Get (i)->GetId () << "\t" << ueNodes.Get (1)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-          serverApps.Get (ac)->TraceConnect ("RxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream, localAddrs));
+          packetTraceWriter->Connect (serverApps.Get (ac), "RxWithAddresses", oss.str (), localAddrs);
           oss.str ("");
         }
     }
@@ -462,6 +408,7 @@ int main (int argc, char *argv[])
   anim.SetConstantPosition (pgw, 0,0,0);
   anim.SetConstantPosition (sgw, 1,0,0);
   Simulator::Run ();
+  packetTraceWriter->Close ();
   Simulator::Destroy ();
   return 0;
 
@@ -0,0 +1,373 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Source-side subscription for the packet trace sinks (UePacketTrace via
+ * AsyncPacketTraceWriter, TraceSinkPC5SignalingPacketTrace), so that long
+ * runs only pay for the flows that are analysed.
+ *
+ * A filter is built from a specification string, typically given on the
+ * command line (--traceFilter), made of ';'-separated terms:
+ *
+ *   nodes=1,4,7       only these node IDs (default: all)
+ *   ports=8000,5000   only packets with one of these source or destination
+ *                     ports (application traces only; default: all)
+ *   dir=tx|rx|both    only transmissions or receptions (application
+ *                     traces only; default: both)
+ *   size=64-1500      only packets whose size is in this range, in bytes
+ *   sample=1/N        keep the 1st, (N+1)th, ... matching packet
+ *   sample=reservoir:K  keep a uniform random sample of K matching packets,
+ *                     written when the trace is closed
+ *
+ * e.g. --traceFilter="nodes=3,4;dir=rx;sample=1/10". The node and direction
+ * terms are checked when the sink is connected, so a filtered-out source
+ * costs nothing at run time. TraceSinkPC5SignalingPacketTrace only logs
+ * receptions and is connected with direction BOTH, so dir does not apply
+ * to it. Sampling is deterministic: 1/N only depends on
+ * the packet order and the reservoir draws from an ns-3 random stream.
+ */
+
+#ifndef PACKET_TRACE_FILTER_H
+#define PACKET_TRACE_FILTER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+class PacketTraceFilter : public SimpleRefCount<PacketTraceFilter>
+{
+public:
+  enum Direction
+  {
+    TX = 1,
+    RX = 2,
+    BOTH = 3
+  };
+
+  enum Sampling
+  {
+    ALL,       //!< Keep every matching packet.
+    ONE_IN_N,  //!< Keep one matching packet out of N.
+    RESERVOIR  //!< Keep a uniform sample of K matching packets.
+  };
+
+  /**
+   * \param spec The filter specification, see the top of this file. The
+   *             empty string subscribes to everything.
+   */
+  explicit PacketTraceFilter (std::string spec = "")
+    : m_direction (BOTH),
+      m_minSize (0),
+      m_maxSize (std::numeric_limits<uint32_t>::max ()),
+      m_sampling (ALL),
+      m_n (1),
+      m_seen (0)
+  {
+    std::istringstream terms (spec);
+    std::string term;
+    while (std::getline (terms, term, ';'))
+      {
+        if (!term.empty ())
+          {
+            ParseTerm (term);
+          }
+      }
+  }
+
+  /**
+   * \param nodeId A node ID to subscribe to.
+   */
+  void AddNode (uint32_t nodeId)
+  {
+    m_nodes.insert (nodeId);
+  }
+
+  /**
+   * \param port A source or destination port to subscribe to.
+   */
+  void AddPort (uint16_t port)
+  {
+    m_ports.insert (port);
+  }
+
+  /**
+   * \param direction The directions to subscribe to.
+   */
+  void SetDirection (Direction direction)
+  {
+    m_direction = direction;
+  }
+
+  /**
+   * \param minSize The smallest packet size kept, in bytes.
+   * \param maxSize The largest packet size kept, in bytes.
+   */
+  void SetSizeRange (uint32_t minSize, uint32_t maxSize)
+  {
+    NS_ABORT_MSG_IF (minSize > maxSize, "Empty trace size range " << minSize << "-" << maxSize);
+    m_minSize = minSize;
+    m_maxSize = maxSize;
+  }
+
+  /**
+   * \param n Keep one matching packet out of n.
+   */
+  void SetOneInN (uint32_t n)
+  {
+    NS_ABORT_MSG_IF (n == 0, "Trace sampling 1/0");
+    m_sampling = n == 1 ? ALL : ONE_IN_N;
+    m_n = n;
+  }
+
+  /**
+   * \param k The number of matching packets kept.
+   */
+  void SetReservoir (uint32_t k)
+  {
+    NS_ABORT_MSG_IF (k == 0, "Empty trace reservoir");
+    m_sampling = RESERVOIR;
+    m_n = k;
+    if (m_rng == 0)
+      {
+        m_rng = CreateObject<UniformRandomVariable> ();
+      }
+  }
+
+  /**
+   * \param stream The first random stream index used by the reservoir.
+   * \return The number of streams used.
+   */
+  int64_t AssignStreams (int64_t stream)
+  {
+    if (m_rng == 0)
+      {
+        return 0;
+      }
+    m_rng->SetStream (stream);
+    return 1;
+  }
+
+  /**
+   * Check, when connecting a sink, whether a source is subscribed.
+   * \param nodeId The node of the source.
+   * \param direction TX or RX.
+   * \return True if the sink should be connected.
+   */
+  bool IsSubscribed (uint32_t nodeId, Direction direction) const
+  {
+    return (m_direction & direction) && (m_nodes.empty () || m_nodes.count (nodeId));
+  }
+
+  /**
+   * \param size The packet size, in bytes.
+   * \return True if the packet passes the size term.
+   */
+  bool MatchesSize (uint32_t size) const
+  {
+    return size >= m_minSize && size <= m_maxSize;
+  }
+
+  /**
+   * \param srcPort The source port.
+   * \param dstPort The destination port.
+   * \return True if the packet passes the ports term.
+   */
+  bool MatchesPorts (uint16_t srcPort, uint16_t dstPort) const
+  {
+    return m_ports.empty () || m_ports.count (srcPort) || m_ports.count (dstPort);
+  }
+
+  /**
+   * Sampling decision for a packet that passed the predicates.
+   * \param slot Set to the reservoir slot the packet goes to, in RESERVOIR
+   *             mode.
+   * \return False if the packet is dropped.
+   */
+  bool Sample (uint32_t &slot)
+  {
+    uint64_t seen = m_seen++;
+    if (m_sampling == ONE_IN_N)
+      {
+        return seen % m_n == 0;
+      }
+    if (m_sampling == RESERVOIR)
+      {
+        // Algorithm R: the i-th packet replaces a random slot with probability K/(i+1)
+        uint64_t j = seen < m_n ? seen : (uint64_t) m_rng->GetValue (0, (double) seen + 1);
+        slot = j;
+        return j < m_n;
+      }
+    return true;
+  }
+
+  /**
+   * \return The sampling mode.
+   */
+  Sampling GetSampling (void) const
+  {
+    return m_sampling;
+  }
+
+  /**
+   * \return The reservoir size, in RESERVOIR mode.
+   */
+  uint32_t GetReservoirSize (void) const
+  {
+    return m_n;
+  }
+
+private:
+  void ParseTerm (const std::string &term)
+  {
+    std::string::size_type eq = term.find ('=');
+    NS_ABORT_MSG_IF (eq == std::string::npos, "Bad trace filter term '" << term << "'");
+    std::string key = term.substr (0, eq);
+    std::string value = term.substr (eq + 1);
+    if (key == "nodes" || key == "ports")
+      {
+        std::istringstream items (value);
+        std::string item;
+        while (std::getline (items, item, ','))
+          {
+            uint32_t v = ParseUint (item, term);
+            if (key == "nodes")
+              {
+                AddNode (v);
+              }
+            else
+              {
+                NS_ABORT_MSG_IF (v > 65535, "Bad port " << v << " in trace filter term '" << term << "'");
+                AddPort (v);
+              }
+          }
+      }
+    else if (key == "dir")
+      {
+        NS_ABORT_MSG_UNLESS (value == "tx" || value == "rx" || value == "both", "Bad trace filter term '" << term << "'");
+        SetDirection (value == "tx" ? TX : (value == "rx" ? RX : BOTH));
+      }
+    else if (key == "size")
+      {
+        std::string::size_type dash = value.find ('-');
+        NS_ABORT_MSG_IF (dash == std::string::npos, "Bad trace filter term '" << term << "'");
+        SetSizeRange (ParseUint (value.substr (0, dash), term), ParseUint (value.substr (dash + 1), term));
+      }
+    else if (key == "sample" && value.compare (0, 2, "1/") == 0)
+      {
+        SetOneInN (ParseUint (value.substr (2), term));
+      }
+    else if (key == "sample" && value.compare (0, 10, "reservoir:") == 0)
+      {
+        SetReservoir (ParseUint (value.substr (10), term));
+      }
+    else
+      {
+        NS_ABORT_MSG ("Bad trace filter term '" << term << "'");
+      }
+  }
+
+  static uint32_t ParseUint (const std::string &s, const std::string &term)
+  {
+    std::istringstream is (s);
+    uint32_t v;
+    NS_ABORT_MSG_UNLESS ((is >> v) && is.eof (), "Bad trace filter term '" << term << "'");
+    return v;
+  }
+
+  std::set<uint32_t> m_nodes;              //!< The subscribed nodes, empty for all.
+  std::set<uint16_t> m_ports;              //!< The subscribed ports, empty for all.
+  Direction m_direction;                   //!< The subscribed directions.
+  uint32_t m_minSize;                      //!< The smallest size kept.
+  uint32_t m_maxSize;                      //!< The largest size kept.
+  Sampling m_sampling;                     //!< The sampling mode.
+  uint32_t m_n;                            //!< N (ONE_IN_N) or K (RESERVOIR).
+  uint64_t m_seen;                         //!< Matching packets so far.
+  Ptr<UniformRandomVariable> m_rng;        //!< The reservoir random stream.
+};
+
+/**
+ * Filtered text trace, for the sinks that write their lines directly
+ * (TraceSinkPC5SignalingPacketTrace). In RESERVOIR mode the kept lines are
+ * buffered and written, in their original order, by Close.
+ */
+class FilteredTraceStream : public SimpleRefCount<FilteredTraceStream>
+{
+public:
+  /**
+   * \param stream The trace file.
+   * \param filter The subscription.
+   */
+  FilteredTraceStream (Ptr<OutputStreamWrapper> stream, Ptr<PacketTraceFilter> filter)
+    : m_stream (stream),
+      m_filter (filter),
+      m_slot (0),
+      m_seq (0)
+  { }
+
+  /**
+   * \return The subscription.
+   */
+  Ptr<PacketTraceFilter> GetFilter (void) const
+  {
+    return m_filter;
+  }
+
+  /**
+   * Decide whether to log a packet; when true the sink must call Write.
+   * \param size The packet size, in bytes.
+   * \return True if the packet is kept.
+   */
+  bool Accept (uint32_t size)
+  {
+    return m_filter->MatchesSize (size) && m_filter->Sample (m_slot);
+  }
+
+  /**
+   * \param line The line of the packet last accepted, with its end of line.
+   */
+  void Write (const std::string &line)
+  {
+    if (m_filter->GetSampling () != PacketTraceFilter::RESERVOIR)
+      {
+        *m_stream->GetStream () << line;
+        return;
+      }
+    if (m_slot >= m_reservoir.size ())
+      {
+        m_reservoir.resize (m_slot + 1);
+      }
+    m_reservoir[m_slot] = std::make_pair (m_seq++, line);
+  }
+
+  /**
+   * Write the reservoir, if any.
+   */
+  void Close (void)
+  {
+    std::sort (m_reservoir.begin (), m_reservoir.end ());
+    for (uint32_t i = 0; i < m_reservoir.size (); ++i)
+      {
+        *m_stream->GetStream () << m_reservoir[i].second;
+      }
+    m_reservoir.clear ();
+    m_stream->GetStream ()->flush ();
+  }
+
+private:
+  Ptr<OutputStreamWrapper> m_stream;                            //!< The trace file.
+  Ptr<PacketTraceFilter> m_filter;                              //!< The subscription.
+  uint32_t m_slot;                                              //!< The slot of the last accepted packet.
+  uint64_t m_seq;                                               //!< The arrival order of the kept lines.
+  std::vector<std::pair<uint64_t, std::string> > m_reservoir;   //!< The kept lines, in RESERVOIR mode.
+};
+
+} // namespace ns3
+
+#endif /* PACKET_TRACE_FILTER_H */
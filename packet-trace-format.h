@@ -0,0 +1,457 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Application packet trace records and their two on-disk encodings:
+ *
+ * - text: the tab-separated layout of UePacketTrace.tr / AppPacketTrace.txt;
+ * - binary: a compact columnar stream converted back to text offline with
+ *   packet-trace-convert.
+ *
+ * Binary file layout (integers are little-endian, "varint" is LEB128):
+ *
+ *   magic "NS3PTRC1", layout (u8), header length (varint), header bytes
+ *   then a sequence of entries, each starting with a one-byte tag:
+ *     'C' context:  id (varint), length (varint), bytes
+ *     'E' endpoint: id (varint), family (u8), port (u16),
+ *                   address (4 bytes for IPv4, 16 for IPv6, none otherwise)
+ *     'R' records:  count (varint), then five columns of count varints:
+ *                   time delta in ns (zigzag), context ID, size,
+ *                   source endpoint ID, destination endpoint ID
+ *
+ * Contexts ("tx\tNodeID\tIMSI") and endpoints (address:port) repeat on
+ * almost every line, so they are written once and records only carry their
+ * IDs. A context or endpoint entry always precedes the first record block
+ * that refers to it, so the file can be decoded in a single pass.
+ */
+
+#ifndef PACKET_TRACE_FORMAT_H
+#define PACKET_TRACE_FORMAT_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * One application-layer packet event. Trivially copyable so that pushing it
+ * onto the ring is a plain copy.
+ */
+struct PacketTraceRecord
+{
+  enum Family
+  {
+    UNKNOWN = 0,
+    IPV4 = 4,
+    IPV6 = 6
+  };
+
+  /**
+   * Column layout of the text output.
+   */
+  enum Layout
+  {
+    SIZE_FIRST, //!< time ctx size src dst, as UePacketTrace with a local address.
+    SIZE_LAST   //!< time ctx src dst size, as the relay-cluster UePacketTrace.
+  };
+
+  int64_t timeNs;      //!< The simulation time, in nanoseconds.
+  uint32_t contextId;  //!< The interned trace context ("tx\tNodeID\tIMSI").
+  uint32_t size;       //!< The packet size, in bytes.
+  uint16_t srcPort;    //!< The source port.
+  uint16_t dstPort;    //!< The destination port.
+  uint8_t family;      //!< The address family of src, dst and local.
+  uint8_t src[16];     //!< The source address (IPv4 uses the first 4 bytes).
+  uint8_t dst[16];     //!< The destination address.
+  uint8_t local[16];   //!< The local address used when src or dst is unset.
+
+  /**
+   * Replace an unset ('0.0.0.0' or '::') source address, or failing that an
+   * unset destination address, by the local address, as UePacketTrace did.
+   */
+  void ResolveLocal (void)
+  {
+    static const uint8_t any[16] = { 0 };
+    std::size_t len = family == IPV4 ? 4 : 16;
+    if (family == UNKNOWN)
+      {
+        return;
+      }
+    if (std::memcmp (src, any, len) == 0) //srcAddrs not set
+      {
+        std::memcpy (src, local, len);
+      }
+    else if (std::memcmp (dst, any, len) == 0) //dstAddrs not set
+      {
+        std::memcpy (dst, local, len);
+      }
+  }
+
+  /**
+   * Write the record as one text line.
+   * \param os The output stream.
+   * \param context The context string of contextId.
+   * \param layout The column layout.
+   */
+  void Print (std::ostream &os, const std::string &context, Layout layout) const
+  {
+    os << timeNs / (double) 1e9 << "\t" << context << "\t";
+    if (layout == SIZE_FIRST)
+      {
+        os << size << "\t";
+      }
+    if (family == IPV4)
+      {
+        os << Ipv4Address::Deserialize (src) << ":" << srcPort << "\t"
+           << Ipv4Address::Deserialize (dst) << ":" << dstPort;
+      }
+    else if (family == IPV6)
+      {
+        os << Ipv6Address::Deserialize (src) << ":" << srcPort << "\t"
+           << Ipv6Address::Deserialize (dst) << ":" << dstPort;
+      }
+    else
+      {
+        os << "Unknown address type!";
+      }
+    if (layout == SIZE_LAST)
+      {
+        os << "\t" << size << "\t";
+      }
+    os << "\n";
+  }
+};
+
+/**
+ * Encoder of the binary trace format described at the top of this file.
+ * Records are buffered and written one column block at a time.
+ */
+class PacketTraceBinaryWriter
+{
+public:
+  /// The number of records per column block.
+  static const uint32_t BLOCK_RECORDS = 4096;
+
+  /**
+   * Write the file header.
+   * \param os The output stream, opened in binary mode.
+   * \param header The text table header, restored by the converter.
+   * \param layout The text layout, restored by the converter.
+   */
+  PacketTraceBinaryWriter (std::ostream &os, const std::string &header, PacketTraceRecord::Layout layout)
+    : m_os (os),
+      m_lastTimeNs (0),
+      m_count (0)
+  {
+    m_os.write ("NS3PTRC1", 8);
+    std::string out;
+    out.push_back ((char) layout);
+    PutVarint (out, header.size ());
+    out += header;
+    m_os.write (out.data (), out.size ());
+  }
+
+  /**
+   * Define a context before records refer to it.
+   * \param id The context ID.
+   * \param context The context string.
+   */
+  void AddContext (uint32_t id, const std::string &context)
+  {
+    m_dictionary.push_back ('C');
+    PutVarint (m_dictionary, id);
+    PutVarint (m_dictionary, context.size ());
+    m_dictionary += context;
+  }
+
+  /**
+   * \param r The record, with ResolveLocal already applied.
+   */
+  void Add (const PacketTraceRecord &r)
+  {
+    int64_t delta = r.timeNs - m_lastTimeNs;
+    m_lastTimeNs = r.timeNs;
+    PutVarint (m_time, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+    PutVarint (m_context, r.contextId);
+    PutVarint (m_size, r.size);
+    PutVarint (m_src, GetEndpoint (r.family, r.src, r.srcPort));
+    PutVarint (m_dst, GetEndpoint (r.family, r.dst, r.dstPort));
+    if (++m_count == BLOCK_RECORDS)
+      {
+        Flush ();
+      }
+  }
+
+  /**
+   * Write the pending dictionary entries and records to the stream.
+   */
+  void Flush (void)
+  {
+    m_os.write (m_dictionary.data (), m_dictionary.size ());
+    m_dictionary.clear ();
+    if (m_count == 0)
+      {
+        return;
+      }
+    std::string block;
+    block.push_back ('R');
+    PutVarint (block, m_count);
+    m_os.write (block.data (), block.size ());
+    std::string *columns[] = { &m_time, &m_context, &m_size, &m_src, &m_dst };
+    for (uint32_t c = 0; c < 5; ++c)
+      {
+        m_os.write (columns[c]->data (), columns[c]->size ());
+        columns[c]->clear ();
+      }
+    m_count = 0;
+  }
+
+  /**
+   * Append an unsigned LEB128 integer.
+   */
+  static void PutVarint (std::string &out, uint64_t v)
+  {
+    while (v >= 0x80)
+      {
+        out.push_back ((char) (v | 0x80));
+        v >>= 7;
+      }
+    out.push_back ((char) v);
+  }
+
+private:
+  uint32_t GetEndpoint (uint8_t family, const uint8_t *addr, uint16_t port)
+  {
+    std::size_t len = family == PacketTraceRecord::IPV4 ? 4 : (family == PacketTraceRecord::IPV6 ? 16 : 0);
+    std::string key (1, (char) family);
+    key.push_back ((char) (port & 0xff));
+    key.push_back ((char) (port >> 8));
+    key.append ((const char *) addr, len);
+    std::map<std::string, uint32_t>::iterator it = m_endpoints.find (key);
+    if (it != m_endpoints.end ())
+      {
+        return it->second;
+      }
+    uint32_t id = m_endpoints.size ();
+    m_endpoints[key] = id;
+    m_dictionary.push_back ('E');
+    PutVarint (m_dictionary, id);
+    m_dictionary += key;
+    return id;
+  }
+
+  std::ostream &m_os;                            //!< The output stream.
+  int64_t m_lastTimeNs;                          //!< The time of the previous record.
+  uint32_t m_count;                              //!< The records in the current block.
+  std::string m_dictionary;                      //!< Pending context and endpoint entries.
+  std::string m_time;                            //!< The time delta column.
+  std::string m_context;                         //!< The context ID column.
+  std::string m_size;                            //!< The size column.
+  std::string m_src;                             //!< The source endpoint column.
+  std::string m_dst;                             //!< The destination endpoint column.
+  std::map<std::string, uint32_t> m_endpoints;   //!< The endpoint IDs.
+};
+
+/**
+ * Streaming decoder of the binary trace format.
+ */
+class PacketTraceBinaryReader
+{
+public:
+  /**
+   * Read the file header.
+   * \param is The input stream, opened in binary mode.
+   */
+  explicit PacketTraceBinaryReader (std::istream &is)
+    : m_is (is),
+      m_lastTimeNs (0),
+      m_next (0)
+  {
+    char magic[8];
+    m_is.read (magic, 8);
+    NS_ABORT_MSG_UNLESS (m_is && std::memcmp (magic, "NS3PTRC1", 8) == 0, "Not a binary packet trace");
+    m_layout = (PacketTraceRecord::Layout) GetByte ();
+    m_header = GetString ();
+  }
+
+  /**
+   * \return The text table header.
+   */
+  const std::string & GetHeader (void) const
+  {
+    return m_header;
+  }
+
+  /**
+   * \return The text layout.
+   */
+  PacketTraceRecord::Layout GetLayout (void) const
+  {
+    return m_layout;
+  }
+
+  /**
+   * \param id A context ID.
+   * \return The context string.
+   */
+  const std::string & GetContext (uint32_t id) const
+  {
+    NS_ABORT_MSG_IF (id >= m_contexts.size (), "Undefined trace context " << id);
+    return m_contexts[id];
+  }
+
+  /**
+   * \param r The next record.
+   * \return False at the end of the file.
+   */
+  bool Next (PacketTraceRecord &r)
+  {
+    while (m_next == m_block.size ())
+      {
+        if (!ReadEntry ())
+          {
+            return false;
+          }
+      }
+    r = m_block[m_next++];
+    return true;
+  }
+
+private:
+  struct Endpoint
+  {
+    uint8_t family;
+    uint16_t port;
+    uint8_t addr[16];
+  };
+
+  bool ReadEntry (void)
+  {
+    int tag = m_is.get ();
+    if (tag == std::char_traits<char>::eof ())
+      {
+        return false;
+      }
+    if (tag == 'C')
+      {
+        uint32_t id = GetVarint ();
+        m_contexts.resize (std::max<std::size_t> (m_contexts.size (), id + 1));
+        m_contexts[id] = GetString ();
+      }
+    else if (tag == 'E')
+      {
+        uint32_t id = GetVarint ();
+        Endpoint e;
+        std::memset (&e, 0, sizeof (e));
+        e.family = GetByte ();
+        e.port = GetByte ();
+        e.port |= GetByte () << 8;
+        std::size_t len = e.family == PacketTraceRecord::IPV4 ? 4 : (e.family == PacketTraceRecord::IPV6 ? 16 : 0);
+        m_is.read ((char *) e.addr, len);
+        m_endpoints.resize (std::max<std::size_t> (m_endpoints.size (), id + 1));
+        m_endpoints[id] = e;
+      }
+    else if (tag == 'R')
+      {
+        ReadBlock (GetVarint ());
+      }
+    else
+      {
+        NS_ABORT_MSG ("Corrupt binary packet trace, tag " << tag);
+      }
+    NS_ABORT_MSG_UNLESS (m_is, "Truncated binary packet trace");
+    return true;
+  }
+
+  void ReadBlock (uint32_t count)
+  {
+    PacketTraceRecord zero;
+    std::memset (&zero, 0, sizeof (zero));
+    m_block.assign (count, zero);
+    m_next = 0;
+    for (uint32_t i = 0; i < count; ++i)
+      {
+        uint64_t z = GetVarint ();
+        m_lastTimeNs += (int64_t) (z >> 1) ^ -(int64_t) (z & 1);
+        m_block[i].timeNs = m_lastTimeNs;
+      }
+    for (uint32_t i = 0; i < count; ++i)
+      {
+        m_block[i].contextId = GetVarint ();
+      }
+    for (uint32_t i = 0; i < count; ++i)
+      {
+        m_block[i].size = GetVarint ();
+      }
+    for (uint32_t i = 0; i < count; ++i)
+      {
+        const Endpoint &e = GetEndpoint (GetVarint ());
+        m_block[i].family = e.family;
+        m_block[i].srcPort = e.port;
+        std::memcpy (m_block[i].src, e.addr, 16);
+      }
+    for (uint32_t i = 0; i < count; ++i)
+      {
+        const Endpoint &e = GetEndpoint (GetVarint ());
+        m_block[i].dstPort = e.port;
+        std::memcpy (m_block[i].dst, e.addr, 16);
+      }
+  }
+
+  const Endpoint & GetEndpoint (uint64_t id) const
+  {
+    NS_ABORT_MSG_IF (id >= m_endpoints.size (), "Undefined trace endpoint " << id);
+    return m_endpoints[id];
+  }
+
+  uint8_t GetByte (void)
+  {
+    return (uint8_t) m_is.get ();
+  }
+
+  uint64_t GetVarint (void)
+  {
+    uint64_t v = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+      {
+        int b = m_is.get ();
+        NS_ABORT_MSG_IF (b == std::char_traits<char>::eof (), "Truncated binary packet trace");
+        v |= (uint64_t) (b & 0x7f) << shift;
+        if (!(b & 0x80))
+          {
+            break;
+          }
+      }
+    return v;
+  }
+
+  std::string GetString (void)
+  {
+    std::string s (GetVarint (), '\0');
+    if (!s.empty ())
+      {
+        m_is.read (&s[0], s.size ());
+      }
+    return s;
+  }
+
+  std::istream &m_is;                           //!< The input stream.
+  PacketTraceRecord::Layout m_layout;           //!< The text layout.
+  std::string m_header;                         //!< The text table header.
+  std::vector<std::string> m_contexts;          //!< The contexts read so far.
+  std::vector<Endpoint> m_endpoints;            //!< The endpoints read so far.
+  std::vector<PacketTraceRecord> m_block;       //!< The current record block.
+  int64_t m_lastTimeNs;                         //!< The time of the previous record.
+  std::size_t m_next;                           //!< The next record of m_block.
+};
+
+} // namespace ns3
+
+#endif /* PACKET_TRACE_FORMAT_H */
@@ -0,0 +1,417 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Asynchronous writer for the application packet traces (UePacketTrace,
+ * AppPacketTrace.txt).
+ *
+ * The trace sink running on the simulation thread only copies a fixed-size
+ * record into a lock-free single-producer/single-consumer ring. A background
+ * thread drains the ring, formats the records exactly like UePacketTrace
+ * did (or encodes them in the binary format of packet-trace-format.h) and
+ * writes them to the file, flushing according to the configured policy
+ * instead of once per packet.
+ *
+ * Usage, in place of TraceConnect (..., MakeBoundCallback (&UePacketTrace, stream, localAddrs)):
+ *
+ *   Ptr<AsyncPacketTraceWriter> writer = Create<AsyncPacketTraceWriter> ("UePacketTrace.tr", header);
+ *   writer->Connect (clientApps.Get (ac), "TxWithAddresses", oss.str (), localAddrs);
+ *   ...
+ *   Simulator::Run ();
+ *   writer->Close ();
+ */
+
+#ifndef PACKET_TRACE_WRITER_H
+#define PACKET_TRACE_WRITER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "packet-trace-filter.h"
+#include "packet-trace-format.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Lock-free ring of PacketTraceRecord for exactly one producer thread and
+ * one consumer thread.
+ */
+class PacketTraceRing
+{
+public:
+  /**
+   * \param capacity The number of records, rounded up to a power of two.
+   */
+  explicit PacketTraceRing (uint32_t capacity)
+    : m_head (0),
+      m_tail (0)
+  {
+    uint32_t size = 1;
+    while (size < capacity)
+      {
+        size <<= 1;
+      }
+    m_buffer.resize (size);
+    m_mask = size - 1;
+  }
+
+  /**
+   * \param record The record to append.
+   * \return False if the ring is full.
+   */
+  bool Push (const PacketTraceRecord &record)
+  {
+    uint64_t tail = m_tail.load (std::memory_order_relaxed);
+    if (tail - m_head.load (std::memory_order_acquire) > m_mask)
+      {
+        return false;
+      }
+    m_buffer[tail & m_mask] = record;
+    m_tail.store (tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * \param record The oldest record, if any.
+   * \return False if the ring is empty.
+   */
+  bool Pop (PacketTraceRecord &record)
+  {
+    uint64_t head = m_head.load (std::memory_order_relaxed);
+    if (head == m_tail.load (std::memory_order_acquire))
+      {
+        return false;
+      }
+    record = m_buffer[head & m_mask];
+    m_head.store (head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::vector<PacketTraceRecord> m_buffer; //!< The storage.
+  uint64_t m_mask;                          //!< The capacity minus one.
+  std::atomic<uint64_t> m_head;             //!< The next record to pop.
+  std::atomic<uint64_t> m_tail;             //!< The next free slot.
+};
+
+class AsyncPacketTraceWriter : public SimpleRefCount<AsyncPacketTraceWriter>
+{
+public:
+  /**
+   * The file encoding.
+   */
+  enum Encoding
+  {
+    TEXT,   //!< Tab-separated text, one line per packet.
+    BINARY  //!< Columnar binary, see packet-trace-format.h.
+  };
+
+  /**
+   * When the background thread flushes the file.
+   */
+  enum FlushPolicy
+  {
+    FLUSH_ON_CLOSE,   //!< Only when the writer is closed.
+    FLUSH_EVERY_N,    //!< After every N records.
+    FLUSH_PERIODIC    //!< Every N milliseconds of wall-clock time.
+  };
+
+  /**
+   * Open the trace file and start the writer thread.
+   * \param filename The trace file.
+   * \param header The table header line, without the end of line.
+   * \param layout The text column layout.
+   * \param encoding The file encoding.
+   * \param capacity The number of records the ring can hold.
+   */
+  AsyncPacketTraceWriter (std::string filename, std::string header,
+                          PacketTraceRecord::Layout layout = PacketTraceRecord::SIZE_FIRST,
+                          Encoding encoding = TEXT, uint32_t capacity = 65536)
+    : m_ring (capacity),
+      m_layout (layout),
+      m_flushPolicy (FLUSH_PERIODIC),
+      m_flushValue (1000),
+      m_stop (false),
+      m_closed (false),
+      m_stalls (0)
+  {
+    m_file.open (filename.c_str (), std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    NS_ABORT_MSG_UNLESS (m_file.is_open (), "Can't open file " << filename);
+    if (encoding == BINARY)
+      {
+        m_binary.reset (new PacketTraceBinaryWriter (m_file, header, layout));
+      }
+    else if (!header.empty ())
+      {
+        m_file << header << "\n";
+      }
+    m_thread = std::thread (&AsyncPacketTraceWriter::Drain, this);
+  }
+
+  ~AsyncPacketTraceWriter (void)
+  {
+    Close ();
+  }
+
+  /**
+   * \param policy When the file is flushed.
+   * \param value The number of records (FLUSH_EVERY_N) or milliseconds
+   *              (FLUSH_PERIODIC) between flushes.
+   */
+  void SetFlushPolicy (FlushPolicy policy, uint32_t value)
+  {
+    m_flushPolicy.store (policy);
+    m_flushValue.store (value);
+  }
+
+  /**
+   * Only log the packets a subscription selects. Must be called before
+   * Connect.
+   * \param filter The subscription.
+   */
+  void SetFilter (Ptr<PacketTraceFilter> filter)
+  {
+    m_filter = filter;
+  }
+
+  /**
+   * Connect an application trace source ("TxWithAddresses" or
+   * "RxWithAddresses") to this writer, unless the filter does not
+   * subscribe to the node and direction.
+   * \param app The application.
+   * \param traceSource The trace source name.
+   * \param context The line prefix, e.g. "tx\tNodeID\tIMSI".
+   * \param localAddrs The address printed when the packet's own is unset.
+   */
+  void Connect (Ptr<Application> app, std::string traceSource, std::string context,
+                const Address &localAddrs = Address ())
+  {
+    PacketTraceFilter::Direction direction = traceSource.compare (0, 2, "Tx") == 0 ? PacketTraceFilter::TX : PacketTraceFilter::RX;
+    if (m_filter && !m_filter->IsSubscribed (app->GetNode ()->GetId (), direction))
+      {
+        return;
+      }
+    uint32_t contextId = RegisterContext (context);
+    app->TraceConnectWithoutContext (traceSource, MakeBoundCallback (&AsyncPacketTraceWriter::Trace,
+                                                                     Ptr<AsyncPacketTraceWriter> (this),
+                                                                     contextId, localAddrs));
+  }
+
+  /**
+   * Stop the writer thread once every queued record is written and close
+   * the file. Called by the destructor if needed.
+   */
+  void Close (void)
+  {
+    if (m_closed)
+      {
+        return;
+      }
+    m_closed = true;
+    // Reservoir samples are only final now; queue them in time order
+    std::stable_sort (m_reservoir.begin (), m_reservoir.end (), &AsyncPacketTraceWriter::Earlier);
+    for (uint32_t i = 0; i < m_reservoir.size (); ++i)
+      {
+        Push (m_reservoir[i]);
+      }
+    m_reservoir.clear ();
+    m_stop.store (true, std::memory_order_release);
+    m_thread.join ();
+    Flush ();
+    m_file.close ();
+  }
+
+  /**
+   * \return How many times the simulation thread found the ring full and
+   *         had to wait for the writer thread.
+   */
+  uint64_t GetStalls (void) const
+  {
+    return m_stalls;
+  }
+
+  /**
+   * Trace sink bound by Connect.
+   */
+  static void Trace (Ptr<AsyncPacketTraceWriter> writer, uint32_t contextId, Address localAddrs,
+                     Ptr<const Packet> p, const Address &srcAddrs, const Address &dstAddrs)
+  {
+    Ptr<PacketTraceFilter> filter = writer->m_filter;
+    if (filter && !filter->MatchesSize (p->GetSize ()))
+      {
+        return;
+      }
+    PacketTraceRecord r;
+    std::memset (&r, 0, sizeof (r));
+    r.timeNs = Simulator::Now ().GetNanoSeconds ();
+    r.contextId = contextId;
+    r.size = p->GetSize ();
+    if (InetSocketAddress::IsMatchingType (srcAddrs))
+      {
+        r.family = PacketTraceRecord::IPV4;
+        InetSocketAddress src = InetSocketAddress::ConvertFrom (srcAddrs);
+        InetSocketAddress dst = InetSocketAddress::ConvertFrom (dstAddrs);
+        src.GetIpv4 ().Serialize (r.src);
+        dst.GetIpv4 ().Serialize (r.dst);
+        r.srcPort = src.GetPort ();
+        r.dstPort = dst.GetPort ();
+        if (Ipv4Address::IsMatchingType (localAddrs))
+          {
+            Ipv4Address::ConvertFrom (localAddrs).Serialize (r.local);
+          }
+      }
+    else if (Inet6SocketAddress::IsMatchingType (srcAddrs))
+      {
+        r.family = PacketTraceRecord::IPV6;
+        Inet6SocketAddress src = Inet6SocketAddress::ConvertFrom (srcAddrs);
+        Inet6SocketAddress dst = Inet6SocketAddress::ConvertFrom (dstAddrs);
+        src.GetIpv6 ().GetBytes (r.src);
+        dst.GetIpv6 ().GetBytes (r.dst);
+        r.srcPort = src.GetPort ();
+        r.dstPort = dst.GetPort ();
+        if (Ipv6Address::IsMatchingType (localAddrs))
+          {
+            Ipv6Address::ConvertFrom (localAddrs).GetBytes (r.local);
+          }
+      }
+    uint32_t slot = 0;
+    if (filter && (!filter->MatchesPorts (r.srcPort, r.dstPort) || !filter->Sample (slot)))
+      {
+        return;
+      }
+    if (filter && filter->GetSampling () == PacketTraceFilter::RESERVOIR)
+      {
+        if (slot >= writer->m_reservoir.size ())
+          {
+            writer->m_reservoir.resize (slot + 1);
+          }
+        writer->m_reservoir[slot] = r;
+        return;
+      }
+    writer->Push (r);
+  }
+
+private:
+  static bool Earlier (const PacketTraceRecord &a, const PacketTraceRecord &b)
+  {
+    return a.timeNs < b.timeNs;
+  }
+
+  uint32_t RegisterContext (const std::string &context)
+  {
+    std::lock_guard<std::mutex> lock (m_contextMutex);
+    m_contexts.push_back (context);
+    return m_contexts.size () - 1;
+  }
+
+  void Push (const PacketTraceRecord &r)
+  {
+    while (!m_ring.Push (r))
+      {
+        ++m_stalls;
+        std::this_thread::yield ();
+      }
+  }
+
+  void Drain (void)
+  {
+    std::vector<std::string> contexts;
+    PacketTraceRecord r;
+    uint64_t sinceFlush = 0;
+    std::chrono::steady_clock::time_point lastFlush = std::chrono::steady_clock::now ();
+    while (true)
+      {
+        bool stopping = m_stop.load (std::memory_order_acquire);
+        bool any = false;
+        while (m_ring.Pop (r))
+          {
+            any = true;
+            if (r.contextId >= contexts.size ())
+              {
+                SyncContexts (contexts);
+              }
+            r.ResolveLocal ();
+            if (m_binary)
+              {
+                m_binary->Add (r);
+              }
+            else
+              {
+                r.Print (m_file, contexts[r.contextId], m_layout);
+              }
+            ++sinceFlush;
+            if (m_flushPolicy.load () == FLUSH_EVERY_N && sinceFlush >= m_flushValue.load ())
+              {
+                Flush ();
+                sinceFlush = 0;
+              }
+          }
+        if (m_flushPolicy.load () == FLUSH_PERIODIC && sinceFlush > 0
+            && std::chrono::steady_clock::now () - lastFlush >= std::chrono::milliseconds (m_flushValue.load ()))
+          {
+            Flush ();
+            sinceFlush = 0;
+            lastFlush = std::chrono::steady_clock::now ();
+          }
+        if (stopping)
+          {
+            // The producer stopped before m_stop was set, so the ring is empty
+            break;
+          }
+        if (!any)
+          {
+            std::this_thread::sleep_for (std::chrono::microseconds (200));
+          }
+      }
+  }
+
+  void SyncContexts (std::vector<std::string> &contexts)
+  {
+    std::lock_guard<std::mutex> lock (m_contextMutex);
+    for (uint32_t id = contexts.size (); id < m_contexts.size (); ++id)
+      {
+        contexts.push_back (m_contexts[id]);
+        if (m_binary)
+          {
+            m_binary->AddContext (id, m_contexts[id]);
+          }
+      }
+  }
+
+  void Flush (void)
+  {
+    if (m_binary)
+      {
+        m_binary->Flush ();
+      }
+    m_file.flush ();
+  }
+
+  PacketTraceRing m_ring;                    //!< The records waiting to be written.
+  PacketTraceRecord::Layout m_layout;        //!< The text column layout.
+  std::atomic<int> m_flushPolicy;            //!< The FlushPolicy.
+  std::atomic<uint32_t> m_flushValue;        //!< The flush period or record count.
+  std::ofstream m_file;                      //!< The trace file.
+  std::unique_ptr<PacketTraceBinaryWriter> m_binary; //!< The encoder, in BINARY encoding.
+  std::thread m_thread;                      //!< The writer thread.
+  std::atomic<bool> m_stop;                  //!< Set to stop the writer thread.
+  bool m_closed;                             //!< True once Close has run.
+  uint64_t m_stalls;                         //!< Pushes that found the ring full.
+  Ptr<PacketTraceFilter> m_filter;           //!< The subscription, if any.
+  std::vector<PacketTraceRecord> m_reservoir; //!< The sampled records, in RESERVOIR mode.
+  std::mutex m_contextMutex;                 //!< Protects m_contexts.
+  std::vector<std::string> m_contexts;       //!< The interned trace contexts.
+};
+
+} // namespace ns3
+
+#endif /* PACKET_TRACE_WRITER_H */
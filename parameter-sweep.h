@@ -0,0 +1,470 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Building blocks of the sweep driver (sweep-runner.cc): a grid of
+ * CommandLine values, a pool that runs scenario binaries in parallel child
+ * processes, each in its own output directory, and the readers that turn
+ * the outputs of a run into one row of KPIs.
+ *
+ * Two kinds of outputs are read from a run directory:
+ *  - FlowMonitor files (any *.xml holding a <FlowMonitor> element, as
+ *    written by FlowMonitor::SerializeToXmlFile), summed over the flows:
+ *    flows, txPackets, rxPackets, lostPackets, txBytes, rxBytes, pdr and
+ *    meanDelay(ms);
+ *  - KPI files, made of "name value" lines ('#' starts a comment).
+ */
+
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+#include "ns3/core-module.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * The Cartesian product of the values of some CommandLine parameters.
+ */
+class ParameterGrid
+{
+public:
+  typedef std::vector<std::pair<std::string, std::string> > Point; //!< One value per parameter.
+
+  /**
+   * \param spec The grid, as ';'-separated "name=value1,value2,..." terms,
+   *             e.g. "relayRadius=100,300;nRemoteUesPerRelay=1,5,10".
+   */
+  explicit ParameterGrid (std::string spec = "")
+  {
+    std::istringstream terms (spec);
+    std::string term;
+    while (std::getline (terms, term, ';'))
+      {
+        if (term.empty ())
+          {
+            continue;
+          }
+        std::string::size_type eq = term.find ('=');
+        NS_ABORT_MSG_IF (eq == std::string::npos || eq == 0, "Bad grid term '" << term << "'");
+        AddParameter (term.substr (0, eq), SplitList (term.substr (eq + 1)));
+      }
+  }
+
+  /**
+   * \param name The CommandLine parameter name.
+   * \param values Its values.
+   */
+  void AddParameter (std::string name, std::vector<std::string> values)
+  {
+    NS_ABORT_MSG_IF (values.empty (), "No values for parameter " << name);
+    m_names.push_back (name);
+    m_values.push_back (values);
+  }
+
+  /**
+   * \return The parameter names, in grid order.
+   */
+  const std::vector<std::string> &GetNames (void) const
+  {
+    return m_names;
+  }
+
+  /**
+   * \return The number of points of the grid.
+   */
+  uint32_t GetNPoints (void) const
+  {
+    uint32_t n = 1;
+    for (uint32_t p = 0; p < m_values.size (); ++p)
+      {
+        n *= m_values[p].size ();
+      }
+    return n;
+  }
+
+  /**
+   * \param i The point index, the last parameter varying fastest.
+   * \return The point.
+   */
+  Point GetPoint (uint32_t i) const
+  {
+    NS_ABORT_MSG_IF (i >= GetNPoints (), "No grid point " << i);
+    Point point (m_names.size ());
+    for (uint32_t p = m_names.size (); p-- > 0; )
+      {
+        point[p] = std::make_pair (m_names[p], m_values[p][i % m_values[p].size ()]);
+        i /= m_values[p].size ();
+      }
+    return point;
+  }
+
+  /**
+   * \param list A ','-separated list.
+   * \return Its non-empty items.
+   */
+  static std::vector<std::string> SplitList (const std::string &list)
+  {
+    std::vector<std::string> items;
+    std::istringstream is (list);
+    std::string item;
+    while (std::getline (is, item, ','))
+      {
+        if (!item.empty ())
+          {
+            items.push_back (item);
+          }
+      }
+    return items;
+  }
+
+private:
+  std::vector<std::string> m_names;                 //!< The parameter names.
+  std::vector<std::vector<std::string> > m_values;  //!< The values of every parameter.
+};
+
+/**
+ * Runs commands in at most a given number of concurrent child processes.
+ * Every command runs in its own directory, created if needed, with its
+ * standard output and error redirected to stdout.txt and stderr.txt there.
+ */
+class ProcessPool
+{
+public:
+  /**
+   * \param jobs The maximum number of concurrent processes; 0 for the
+   *             number of cores.
+   */
+  explicit ProcessPool (uint32_t jobs = 0)
+    : m_jobs (jobs)
+  {
+    if (m_jobs == 0)
+      {
+        long cores = sysconf (_SC_NPROCESSORS_ONLN);
+        m_jobs = cores > 0 ? cores : 1;
+      }
+  }
+
+  /**
+   * \return The maximum number of concurrent processes.
+   */
+  uint32_t GetJobs (void) const
+  {
+    return m_jobs;
+  }
+
+  /**
+   * Start a command, after waiting for a free slot.
+   * \param id An ID reported by Wait.
+   * \param dir The directory the command runs in.
+   * \param argv The program (an absolute path) and its arguments.
+   */
+  void Submit (uint32_t id, const std::string &dir, const std::vector<std::string> &argv)
+  {
+    while (m_running.size () >= m_jobs)
+      {
+        Reap ();
+      }
+    MakeDirectories (dir);
+    pid_t pid = fork ();
+    NS_ABORT_MSG_IF (pid < 0, "fork failed: " << std::strerror (errno));
+    if (pid == 0)
+      {
+        Exec (dir, argv);
+      }
+    m_running[pid] = id;
+  }
+
+  /**
+   * Wait for the next command to finish.
+   * \param id Set to the ID of the command.
+   * \param status Set to its exit status, or 128 + signal if it was killed.
+   * \param block If false, only report a command that already finished.
+   * \return False if no command is left (or, when not blocking, none has
+   *         finished).
+   */
+  bool Wait (uint32_t &id, int &status, bool block = true)
+  {
+    if (m_done.empty ())
+      {
+        if (m_running.empty () || !block)
+          {
+            return false;
+          }
+        Reap ();
+      }
+    id = m_done.front ().first;
+    status = m_done.front ().second;
+    m_done.erase (m_done.begin ());
+    return true;
+  }
+
+  /**
+   * Kill the running commands and forget the unreported ones.
+   */
+  void Terminate (void)
+  {
+    for (std::map<pid_t, uint32_t>::iterator it = m_running.begin (); it != m_running.end (); ++it)
+      {
+        kill (it->first, SIGTERM);
+      }
+    while (!m_running.empty ())
+      {
+        Reap ();
+      }
+    m_done.clear ();
+  }
+
+  /**
+   * \param dir A directory path; its missing parents are created too.
+   */
+  static void MakeDirectories (const std::string &dir)
+  {
+    for (std::string::size_type i = 1; i <= dir.size (); ++i)
+      {
+        if (i == dir.size () || dir[i] == '/')
+          {
+            int ret = mkdir (dir.substr (0, i).c_str (), 0755);
+            NS_ABORT_MSG_IF (ret != 0 && errno != EEXIST, "Can't create directory " << dir.substr (0, i));
+          }
+      }
+  }
+
+private:
+  void Reap (void)
+  {
+    int wstatus;
+    pid_t pid = waitpid (-1, &wstatus, 0);
+    NS_ABORT_MSG_IF (pid < 0, "waitpid failed: " << std::strerror (errno));
+    std::map<pid_t, uint32_t>::iterator it = m_running.find (pid);
+    if (it == m_running.end ())
+      {
+        return;
+      }
+    int status = WIFEXITED (wstatus) ? WEXITSTATUS (wstatus) : 128 + WTERMSIG (wstatus);
+    m_done.push_back (std::make_pair (it->second, status));
+    m_running.erase (it);
+  }
+
+  // in the child: never returns
+  static void Exec (const std::string &dir, const std::vector<std::string> &argv)
+  {
+    if (chdir (dir.c_str ()) != 0)
+      {
+        _exit (127);
+      }
+    int out = open ("stdout.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int err = open ("stderr.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0 || err < 0 || dup2 (out, 1) < 0 || dup2 (err, 2) < 0)
+      {
+        _exit (127);
+      }
+    std::vector<char *> args;
+    for (uint32_t i = 0; i < argv.size (); ++i)
+      {
+        args.push_back (const_cast<char *> (argv[i].c_str ()));
+      }
+    args.push_back (0);
+    execv (args[0], &args[0]);
+    _exit (127);
+  }
+
+  uint32_t m_jobs;                                        //!< The maximum number of concurrent processes.
+  std::map<pid_t, uint32_t> m_running;                    //!< The ID of every running process.
+  std::vector<std::pair<uint32_t, int> > m_done;          //!< The finished commands not yet reported.
+};
+
+/**
+ * One row of named KPI values per run, printed as a tab-separated table
+ * whose columns are all the names seen, in first-seen order.
+ */
+class KpiTable
+{
+public:
+  typedef std::vector<std::pair<std::string, std::string> > Row; //!< Named values.
+
+  /**
+   * \param row The values of a run.
+   */
+  void AddRow (const Row &row)
+  {
+    std::map<std::string, std::string> values;
+    for (uint32_t c = 0; c < row.size (); ++c)
+      {
+        if (!m_known.count (row[c].first))
+          {
+            m_known.insert (row[c].first);
+            m_columns.push_back (row[c].first);
+          }
+        values[row[c].first] = row[c].second;
+      }
+    m_rows.push_back (values);
+  }
+
+  /**
+   * \param os The stream to print the table to; missing values are "-".
+   */
+  void Print (std::ostream &os) const
+  {
+    for (uint32_t c = 0; c < m_columns.size (); ++c)
+      {
+        os << (c ? "\t" : "") << m_columns[c];
+      }
+    os << std::endl;
+    for (uint32_t r = 0; r < m_rows.size (); ++r)
+      {
+        for (uint32_t c = 0; c < m_columns.size (); ++c)
+          {
+            std::map<std::string, std::string>::const_iterator it = m_rows[r].find (m_columns[c]);
+            os << (c ? "\t" : "") << (it == m_rows[r].end () ? "-" : it->second);
+          }
+        os << std::endl;
+      }
+  }
+
+  /**
+   * Append the "name value" lines of a KPI file to a row.
+   * \param filename The KPI file.
+   * \param row The row.
+   * \return False if the file can't be read.
+   */
+  static bool ReadKpiFile (const std::string &filename, Row &row)
+  {
+    std::ifstream in (filename.c_str ());
+    if (!in.is_open ())
+      {
+        return false;
+      }
+    std::string line;
+    while (std::getline (in, line))
+      {
+        std::istringstream is (line.substr (0, line.find ('#')));
+        std::string name, value;
+        if (is >> name >> value)
+          {
+            row.push_back (std::make_pair (name, value));
+          }
+      }
+    return true;
+  }
+
+  /**
+   * Append the totals of a FlowMonitor XML file to a row.
+   * \param filename The FlowMonitor file.
+   * \param row The row.
+   * \return False if the file is not a FlowMonitor file.
+   */
+  static bool ReadFlowMonitor (const std::string &filename, Row &row)
+  {
+    // look for the root element first, to skip other XML files (e.g. NetAnim) unread
+    std::ifstream in (filename.c_str ());
+    std::string xml (4096, '\0');
+    in.read (&xml[0], xml.size ());
+    xml.resize (in.gcount ());
+    if (xml.find ("<FlowMonitor") == std::string::npos)
+      {
+        return false;
+      }
+    std::stringstream buffer;
+    buffer << in.rdbuf ();
+    xml += buffer.str ();
+    // the <Flow> elements of <FlowStats> are the ones with counters
+    uint64_t flows = 0;
+    double tx = 0, rx = 0, lost = 0, txBytes = 0, rxBytes = 0, delaySum = 0;
+    for (std::string::size_type pos = xml.find ("<Flow "); pos != std::string::npos; pos = xml.find ("<Flow ", pos + 1))
+      {
+        std::string flow = xml.substr (pos, xml.find ('>', pos) - pos);
+        if (flow.find ("txPackets=") == std::string::npos)
+          {
+            continue;
+          }
+        ++flows;
+        tx += GetAttribute (flow, "txPackets");
+        rx += GetAttribute (flow, "rxPackets");
+        lost += GetAttribute (flow, "lostPackets");
+        txBytes += GetAttribute (flow, "txBytes");
+        rxBytes += GetAttribute (flow, "rxBytes");
+        delaySum += GetAttribute (flow, "delaySum");
+      }
+    AddValue (row, "flows", flows);
+    AddValue (row, "txPackets", tx);
+    AddValue (row, "rxPackets", rx);
+    AddValue (row, "lostPackets", lost);
+    AddValue (row, "txBytes", txBytes);
+    AddValue (row, "rxBytes", rxBytes);
+    AddValue (row, "pdr", tx > 0 ? rx / tx : 0);
+    AddValue (row, "meanDelay(ms)", rx > 0 ? delaySum / rx / 1e6 : 0);
+    return true;
+  }
+
+  /**
+   * \param dir A directory.
+   * \return The names of the regular files in it, sorted.
+   */
+  static std::vector<std::string> ListFiles (const std::string &dir)
+  {
+    std::vector<std::string> files;
+    DIR *d = opendir (dir.c_str ());
+    if (d == 0)
+      {
+        return files;
+      }
+    for (struct dirent *e = readdir (d); e != 0; e = readdir (d))
+      {
+        struct stat st;
+        std::string name = e->d_name;
+        if (stat ((dir + "/" + name).c_str (), &st) == 0 && S_ISREG (st.st_mode))
+          {
+            files.push_back (name);
+          }
+      }
+    closedir (d);
+    std::sort (files.begin (), files.end ());
+    return files;
+  }
+
+private:
+  // numeric value of name="..." in an element; times ("+1.5e+06ns") are in ns
+  static double GetAttribute (const std::string &element, const std::string &name)
+  {
+    std::string::size_type pos = element.find (" " + name + "=\"");
+    if (pos == std::string::npos)
+      {
+        return 0;
+      }
+    return std::strtod (element.c_str () + pos + name.size () + 3, 0);
+  }
+
+  template <typename T>
+  static void AddValue (Row &row, const std::string &name, T value)
+  {
+    std::ostringstream os;
+    os << value;
+    row.push_back (std::make_pair (name, os.str ()));
+  }
+
+  std::vector<std::string> m_columns;                        //!< The column names, in first-seen order.
+  std::set<std::string> m_known;                             //!< The column names seen.
+  std::vector<std::map<std::string, std::string> > m_rows;   //!< The values of every row.
+};
+
+} // namespace ns3
+
+#endif /* PARAMETER_SWEEP_H */
@@ -0,0 +1,135 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Passive-listener UE profile, for broadcast group calls with a large
+ * audience: a listener only receives the PSCCH/PSSCH of its group and
+ * runs the receive side of McpttCallMachineGrpBroadcast.
+ *
+ * Compared with a talker, a listener
+ *  - has discovery disabled (no announcing nor monitoring pool);
+ *  - does not transmit SLSS, whatever LteUeRrc::UeSlssTransmissionEnabled;
+ *  - only gets RECEIVE sidelink bearers, so its MAC never schedules a
+ *    transmission;
+ *  - gets a McpttPttApp that never pushes (no PushOnStart, no automatic
+ *    pusher), whose call is set up by BroadcastCallBuilder without the
+ *    TFB timers of the talkers: the call machine starts TFB1 itself when
+ *    the GROUP CALL BROADCAST is received.
+ *
+ * A listener still has the LteUeNetDevice and McpttPttApp of a UE: the
+ * profile saves what it would schedule and transmit, not its protocol
+ * stack. broadcast-scaling-bench measures it against listeners installed
+ * as talkers (--listenersPerGroup).
+ *
+ *   Ptr<PassiveListenerHelper> listenerHelper = Create<PassiveListenerHelper> (lteHelper, proseHelper);
+ *   listenerHelper->SetPreconfiguration (preconfiguration);
+ *   listenerHelper->Install (listenerDevs);
+ *   listenerHelper->ActivateGroup (Seconds (1), listenerDevs, grpAddress, groupL2Address);
+ *   ApplicationContainer listenerApps = listenerHelper->InstallApps (listenerNodes, peerAddress);
+ *   callBuilder->SetListenersPerGroup (listenersPerGroup);
+ *   callBuilder->Build (talkerApps, listenerApps);
+ */
+
+#ifndef PASSIVE_LISTENER_H
+#define PASSIVE_LISTENER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/psc-module.h"
+
+namespace ns3 {
+
+class PassiveListenerHelper : public SimpleRefCount<PassiveListenerHelper>
+{
+public:
+  /**
+   * \param lteHelper The LTE helper that installed the listener devices.
+   * \param proseHelper The sidelink helper.
+   */
+  PassiveListenerHelper (Ptr<LteHelper> lteHelper, Ptr<LteSidelinkHelper> proseHelper)
+    : m_lteHelper (lteHelper),
+      m_proseHelper (proseHelper),
+      m_havePreconfiguration (false)
+  {
+    m_mcpttHelper.SetPusher ("ns3::McpttPusher",
+                             "Automatic", BooleanValue (false));
+  }
+
+  /**
+   * \param preconfiguration The sidelink preconfiguration of the talkers,
+   *                         whose communication pools the listeners monitor.
+   */
+  void SetPreconfiguration (const LteRrcSap::SlPreconfiguration &preconfiguration)
+  {
+    m_preconfiguration = preconfiguration;
+    m_havePreconfiguration = true;
+  }
+
+  /**
+   * Configure the sidelink of the listener devices, before the start of
+   * the simulation.
+   * \param listeners The listener UE devices.
+   */
+  void Install (NetDeviceContainer listeners)
+  {
+    NS_ABORT_MSG_UNLESS (m_havePreconfiguration, "No sidelink preconfiguration for the listeners");
+    Ptr<LteSlUeRrc> slConfiguration = CreateObject<LteSlUeRrc> ();
+    slConfiguration->SetSlEnabled (true);
+    slConfiguration->SetDiscEnabled (false);
+    slConfiguration->SetSlPreconfiguration (m_preconfiguration);
+    m_lteHelper->InstallSidelinkConfiguration (listeners, slConfiguration);
+    for (uint32_t i = 0; i < listeners.GetN (); i++)
+      {
+        Ptr<LteUeNetDevice> ueDev = listeners.Get (i)->GetObject<LteUeNetDevice> ();
+        NS_ABORT_MSG_IF (ueDev == 0, "Listener " << i << " is not an LTE UE");
+        ueDev->GetRrc ()->SetAttribute ("UeSlssTransmissionEnabled", BooleanValue (false));
+      }
+  }
+
+  /**
+   * Make the listeners receive a group.
+   * \param activation The bearer activation time.
+   * \param listeners The listener UE devices of the group.
+   * \param grpAddress The group IP address.
+   * \param groupL2Address The group layer 2 address.
+   */
+  void ActivateGroup (Time activation, NetDeviceContainer listeners, Ipv4Address grpAddress, uint32_t groupL2Address)
+  {
+    Ptr<LteSlTft> tft = Create<LteSlTft> (LteSlTft::RECEIVE, grpAddress, groupL2Address);
+    m_proseHelper->ActivateSidelinkBearer (activation, listeners, tft);
+  }
+
+  /**
+   * \param listeners The listener nodes, with their IP stack.
+   * \param peerAddress The address the calls are sent to.
+   * \return The McpttPttApp of every listener, to give to BroadcastCallBuilder.
+   */
+  ApplicationContainer InstallApps (NodeContainer listeners, Ipv4Address peerAddress)
+  {
+    m_mcpttHelper.SetPttApp ("ns3::McpttPttApp",
+                             "PeerAddress", Ipv4AddressValue (peerAddress),
+                             "PushOnStart", BooleanValue (false));
+    return m_mcpttHelper.Install (listeners);
+  }
+
+  /**
+   * \param listeners The listener nodes.
+   * \param stream The first stream of the listener applications.
+   * \return The number of streams used.
+   */
+  int64_t AssignStreams (NodeContainer listeners, int64_t stream)
+  {
+    return m_mcpttHelper.AssignStreams (listeners, stream);
+  }
+
+private:
+  Ptr<LteHelper> m_lteHelper;                             //!< The LTE helper.
+  Ptr<LteSidelinkHelper> m_proseHelper;                   //!< The sidelink helper.
+  McpttHelper m_mcpttHelper;                              //!< The helper of the listener applications.
+  LteRrcSap::SlPreconfiguration m_preconfiguration;       //!< The sidelink preconfiguration.
+  bool m_havePreconfiguration;                            //!< Whether the preconfiguration was given.
+};
+
+} // namespace ns3
+
+#endif /* PASSIVE_LISTENER_H */
@@ -0,0 +1,184 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Pair-loss matrix for static sidelink topologies: the loss of a wrapped
+ * propagation loss model (Cost231 by default) between every pair of the
+ * given nodes is computed once, so that the reception of a PSCCH/PSSCH
+ * transmission costs a table lookup instead of the model's log10 chain.
+ *
+ * The matrix is filled by Build (), after the mobility is installed and
+ * the wrapped model configured (e.g. its Frequency), i.e. right after
+ * lteHelper->Initialize (). When a node changes course its row and column
+ * are cleared and recomputed on their next use; nodes not given to Build
+ * (e.g. the eNodeB) are passed to the wrapped model every time. Only use
+ * it with deterministic models: a random loss would be frozen. LteHelper
+ * sets the Frequency of its pathloss models when installing an eNodeB,
+ * which does not reach the wrapped model: set it on GetModel ().
+ *
+ *   lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::MatrixPropagationLossModel"));
+ *   lteHelper->SetPathlossModelAttribute ("Model", StringValue ("ns3::Cost231PropagationLossModel"));
+ *   lteHelper->Initialize ();
+ *   Ptr<MatrixPropagationLossModel> matrix = lteHelper->GetUplinkPathlossModel ()->GetObject<MatrixPropagationLossModel> ();
+ *   matrix->GetModel ()->SetAttribute ("Frequency", DoubleValue (ulFreq));
+ *   matrix->Build (ueNodes);
+ */
+
+#ifndef PATHLOSS_MATRIX_H
+#define PATHLOSS_MATRIX_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+class MatrixPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::MatrixPropagationLossModel")
+      .SetParent<PropagationLossModel> ()
+      .SetGroupName ("Propagation")
+      .AddConstructor<MatrixPropagationLossModel> ()
+      .AddAttribute ("Model",
+                     "The TypeId of the wrapped propagation loss model",
+                     StringValue ("ns3::Cost231PropagationLossModel"),
+                     MakeStringAccessor (&MatrixPropagationLossModel::m_modelType),
+                     MakeStringChecker ())
+    ;
+    return tid;
+  }
+
+  MatrixPropagationLossModel (void)
+  { }
+
+  /**
+   * \return The wrapped model, to be configured before Build.
+   */
+  Ptr<PropagationLossModel> GetModel (void) const
+  {
+    if (m_model == 0)
+      {
+        ObjectFactory factory;
+        factory.SetTypeId (m_modelType);
+        m_model = factory.Create<PropagationLossModel> ();
+      }
+    return m_model;
+  }
+
+  /**
+   * Compute the loss between every ordered pair of nodes.
+   * \param nodes The nodes, with their mobility installed.
+   */
+  void Build (NodeContainer nodes)
+  {
+    uint32_t first = m_mobility.size ();
+    for (uint32_t n = 0; n < nodes.GetN (); n++)
+      {
+        Ptr<MobilityModel> mobility = nodes.Get (n)->GetObject<MobilityModel> ();
+        NS_ABORT_MSG_IF (mobility == 0, "Node " << nodes.Get (n)->GetId () << " has no mobility");
+        if (m_index.count (PeekPointer (mobility)))
+          {
+            continue;
+          }
+        m_index[PeekPointer (mobility)] = m_mobility.size ();
+        m_mobility.push_back (mobility);
+        mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&MatrixPropagationLossModel::CourseChanged, this));
+      }
+    // grow the matrix, keeping the losses already computed
+    uint32_t size = m_mobility.size ();
+    std::vector<double> loss (size * size);
+    for (uint32_t tx = 0; tx < size; tx++)
+      {
+        for (uint32_t rx = 0; rx < size; rx++)
+          {
+            loss[tx * size + rx] = (tx < first && rx < first) ? m_loss[tx * first + rx] : Compute (tx, rx);
+          }
+      }
+    m_loss.swap (loss);
+  }
+
+  /**
+   * \return The number of nodes in the matrix.
+   */
+  uint32_t GetN (void) const
+  {
+    return m_mobility.size ();
+  }
+
+  /**
+   * Recompute every loss on its next use, e.g. after a change of the
+   * wrapped model's attributes.
+   */
+  void Invalidate (void)
+  {
+    std::fill (m_loss.begin (), m_loss.end (), std::numeric_limits<double>::quiet_NaN ());
+  }
+
+private:
+  virtual double DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+  {
+    std::unordered_map<const MobilityModel *, uint32_t>::const_iterator tx = m_index.find (PeekPointer (a));
+    std::unordered_map<const MobilityModel *, uint32_t>::const_iterator rx = m_index.find (PeekPointer (b));
+    if (tx == m_index.end () || rx == m_index.end ())
+      {
+        return GetModel ()->CalcRxPower (txPowerDbm, a, b);
+      }
+    double &loss = m_loss[tx->second * m_mobility.size () + rx->second];
+    if (std::isnan (loss))
+      {
+        loss = Compute (tx->second, rx->second);
+      }
+    return txPowerDbm - loss;
+  }
+
+  virtual int64_t DoAssignStreams (int64_t stream)
+  {
+    return GetModel ()->AssignStreams (stream);
+  }
+
+  virtual void DoDispose (void)
+  {
+    m_mobility.clear ();
+    m_index.clear ();
+    m_model = 0;
+    PropagationLossModel::DoDispose ();
+  }
+
+  // the loss (dB) from the tx-th to the rx-th node, independent of the power
+  double Compute (uint32_t tx, uint32_t rx) const
+  {
+    return -GetModel ()->CalcRxPower (0, m_mobility[tx], m_mobility[rx]);
+  }
+
+  void CourseChanged (Ptr<const MobilityModel> mobility)
+  {
+    uint32_t node = m_index[PeekPointer (mobility)];
+    uint32_t size = m_mobility.size ();
+    for (uint32_t other = 0; other < size; other++)
+      {
+        m_loss[node * size + other] = std::numeric_limits<double>::quiet_NaN ();
+        m_loss[other * size + node] = std::numeric_limits<double>::quiet_NaN ();
+      }
+  }
+
+  std::string m_modelType;                                       //!< The TypeId of the wrapped model.
+  mutable Ptr<PropagationLossModel> m_model;                     //!< The wrapped model, created on first use.
+  std::vector<Ptr<MobilityModel> > m_mobility;                   //!< The mobility of the nodes in the matrix.
+  std::unordered_map<const MobilityModel *, uint32_t> m_index;   //!< The index of a mobility in the matrix.
+  mutable std::vector<double> m_loss;                            //!< The losses (dB), tx-major, NaN if to recompute.
+};
+
+NS_OBJECT_ENSURE_REGISTERED (MatrixPropagationLossModel);
+
+} // namespace ns3
+
+#endif /* PATHLOSS_MATRIX_H */
@@ -0,0 +1,298 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Event-driven back-off election of the UE that initiates an out-of-coverage
+ * broadcast call.
+ *
+ * When an election starts every candidate UE arms a back-off timer equal to
+ * its waiting_time () score. The first UE whose timer expires initiates the
+ * call; every other UE cancels its own timer as soon as it hears that call.
+ * A UE whose timer expires before the call reaches it also initiates, and
+ * is counted as a redundant initiator.
+ *
+ * Hearing the winner can be signalled by the scenario (NotifyHeard, e.g.
+ * from the McpttPttApp RxTrace) or modelled with a fixed hearing delay:
+ *
+ *   pttApp->TraceConnectWithoutContext ("RxTrace", MakeBoundCallback (&RelayElection::RxTrace, election, candidateId, callId));
+ *   Simulator::Schedule (releaseTime, &RelayElection::ReleaseWinnerCall, election, apps);
+ */
+
+#ifndef RELAY_ELECTION_H
+#define RELAY_ELECTION_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/psc-module.h"
+
+#include <ns3/mcptt-ptt-app.h>
+#include "waiting-time.h"
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+namespace ns3 {
+
+class RelayElection : public SimpleRefCount<RelayElection>
+{
+public:
+  /**
+   * Outcome of one election.
+   */
+  struct Stats
+  {
+    Time start;          //!< The time the election started.
+    Time firstWin;       //!< The time the first UE initiated the call.
+    uint32_t winner;     //!< The candidate that initiated first.
+    uint32_t initiators; //!< The number of UEs that initiated the call.
+    uint32_t suppressed; //!< The number of UEs that cancelled their back-off.
+  };
+
+  RelayElection (void)
+    : m_tCycle (Seconds (0.1)),
+      m_maxBackoff (Seconds (1)),
+      m_hearingDelay (Seconds (0)),
+      m_pending (0),
+      m_running (false)
+  { }
+
+  /**
+   * Add a candidate UE. The score inputs follow waiting_time ().
+   * \param initiateCb The callback that makes the UE initiate the call.
+   * \return The candidate ID, used with NotifyHeard.
+   */
+  uint32_t AddCandidate (Callback<void> initiateCb, double ownSnr, double locAccuracy,
+                         double otherDeviceSnr, bool inCoverage, double soc)
+  {
+    NS_ABORT_MSG_IF (m_running, "Cannot add a candidate during an election");
+    m_candidates.Add (ownSnr, locAccuracy, otherDeviceSnr, inCoverage, soc, m_tCycle.GetSeconds ());
+    m_initiateCbs.push_back (initiateCb);
+    m_backoff.push_back (EventId ());
+    m_done.push_back (false);
+    return m_initiateCbs.size () - 1;
+  }
+
+  /**
+   * \param tCycle The election cycle duration used by waiting_time ().
+   */
+  void SetTCycle (Time tCycle)
+  {
+    m_tCycle = tCycle;
+    std::fill (m_candidates.tCycle.begin (), m_candidates.tCycle.end (), tCycle.GetSeconds ());
+  }
+
+  /**
+   * \param maxBackoff The upper bound of a back-off timer.
+   */
+  void SetMaxBackoff (Time maxBackoff)
+  {
+    m_maxBackoff = maxBackoff;
+  }
+
+  /**
+   * \param delay The time for a call initiation to reach the other UEs.
+   *              Zero (the default) disables the model; the scenario must
+   *              then call NotifyHeard.
+   */
+  void SetHearingDelay (Time delay)
+  {
+    m_hearingDelay = delay;
+  }
+
+  /**
+   * \param cb The callback invoked with the candidate ID of the winner.
+   */
+  void SetWinCallback (Callback<void, uint32_t> cb)
+  {
+    m_winCb = cb;
+  }
+
+  /**
+   * Start an election now. An unfinished previous election is abandoned.
+   */
+  void Start (void)
+  {
+    CancelBackoffs ();
+    std::vector<double> backoff;
+    waiting_time_batch (m_candidates, backoff);
+
+    Stats stats;
+    stats.start = Simulator::Now ();
+    stats.firstWin = Seconds (0);
+    stats.winner = 0;
+    stats.initiators = 0;
+    stats.suppressed = 0;
+    m_stats.push_back (stats);
+    m_pending = backoff.size ();
+    m_running = m_pending > 0;
+
+    for (uint32_t id = 0; id < backoff.size (); ++id)
+      {
+        // clamped before the conversion: a near-zero score denominator
+        // gives a back-off that overflows Time
+        Time delay = Seconds (std::min (backoff[id], m_maxBackoff.GetSeconds ()));
+        m_done[id] = false;
+        m_backoff[id] = Simulator::Schedule (delay, &RelayElection::BackoffExpired, this, id);
+      }
+  }
+
+  /**
+   * Tell the election that a candidate heard another UE initiate the call.
+   * \param id The candidate ID of the listener.
+   */
+  void NotifyHeard (uint32_t id)
+  {
+    if (!m_running || m_done[id])
+      {
+        return;
+      }
+    m_done[id] = true;
+    m_backoff[id].Cancel ();
+    m_stats.back ().suppressed++;
+    Finish (id);
+  }
+
+  /**
+   * \return The candidate that won the last election.
+   */
+  uint32_t GetWinner (void) const
+  {
+    NS_ABORT_MSG_IF (m_stats.empty () || m_stats.back ().initiators == 0, "No election has been won");
+    return m_stats.back ().winner;
+  }
+
+  /**
+   * \return The outcome of every election started so far.
+   */
+  const std::vector<Stats> & GetStats (void) const
+  {
+    return m_stats;
+  }
+
+  /**
+   * Print one line per election and the averages.
+   * \param os The output stream.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    os << "election\tstart(s)\tlatency(ms)\twinner\tinitiators\tredundant" << std::endl;
+    double latencySum = 0;
+    uint32_t redundantSum = 0;
+    uint32_t won = 0;
+    for (uint32_t e = 0; e < m_stats.size (); ++e)
+      {
+        const Stats &s = m_stats[e];
+        if (s.initiators == 0)
+          {
+            os << e << "\t" << s.start.GetSeconds () << "\t-\t-\t0\t0" << std::endl;
+            continue;
+          }
+        double latency = (s.firstWin - s.start).GetSeconds () * 1000;
+        os << e << "\t" << s.start.GetSeconds () << "\t" << latency << "\t" << s.winner
+           << "\t" << s.initiators << "\t" << s.initiators - 1 << std::endl;
+        latencySum += latency;
+        redundantSum += s.initiators - 1;
+        won++;
+      }
+    if (won > 0)
+      {
+        os << "mean latency (ms): " << latencySum / won
+           << "\tmean redundant initiators: " << (double) redundantSum / won << std::endl;
+      }
+  }
+
+  /**
+   * McpttPttApp RxTrace sink: a candidate that receives the broadcast
+   * call of the election has heard the winner.
+   * \param election The election.
+   * \param candidateId The candidate ID of the receiving UE.
+   * \param electionCallId The ID of the call the election initiates.
+   * \param app The receiving application.
+   * \param callId The ID of the call of the message.
+   * \param msg The received message.
+   */
+  static void RxTrace (Ptr<RelayElection> election, uint32_t candidateId, uint16_t electionCallId,
+                       Ptr<const Application> app, uint16_t callId, const Header &msg)
+  {
+    if (callId == electionCallId && msg.GetInstanceTypeId () == McpttCallMsgGrpBroadcast::GetTypeId ())
+      {
+        election->NotifyHeard (candidateId);
+      }
+  }
+
+  /**
+   * Make the winner of the last election release its call.
+   * \param election The election.
+   * \param apps The McpttPttApps of the candidates, in candidate ID order.
+   */
+  static void ReleaseWinnerCall (Ptr<RelayElection> election, ApplicationContainer apps)
+  {
+    DynamicCast<McpttPttApp, Application> (apps.Get (election->GetWinner ()))->ReleaseCall ();
+  }
+
+private:
+  void BackoffExpired (uint32_t id)
+  {
+    Stats &stats = m_stats.back ();
+    if (stats.initiators == 0)
+      {
+        stats.firstWin = Simulator::Now ();
+        stats.winner = id;
+        if (!m_winCb.IsNull ())
+          {
+            m_winCb (id);
+          }
+      }
+    stats.initiators++;
+    Finish (id);
+    m_initiateCbs[id] ();
+
+    // the first initiation reaches every UE first
+    if (m_hearingDelay > Seconds (0) && stats.initiators == 1)
+      {
+        m_allHeard = Simulator::Schedule (m_hearingDelay, &RelayElection::NotifyAllHeard, this);
+      }
+  }
+
+  void NotifyAllHeard (void)
+  {
+    for (uint32_t id = 0; id < m_done.size () && m_running; ++id)
+      {
+        NotifyHeard (id);
+      }
+  }
+
+  void Finish (uint32_t id)
+  {
+    m_done[id] = true;
+    if (--m_pending == 0)
+      {
+        m_running = false;
+      }
+  }
+
+  void CancelBackoffs (void)
+  {
+    for (uint32_t id = 0; id < m_backoff.size (); ++id)
+      {
+        m_backoff[id].Cancel ();
+      }
+    m_allHeard.Cancel ();
+  }
+
+  WaitingTimeCandidates m_candidates;          //!< The score inputs of each candidate.
+  std::vector<Callback<void> > m_initiateCbs;  //!< The call initiation of each candidate.
+  std::vector<EventId> m_backoff;              //!< The armed back-off timers.
+  EventId m_allHeard;                          //!< The modelled hearing of the first initiation.
+  std::vector<bool> m_done;                    //!< Initiated or suppressed in this election.
+  std::vector<Stats> m_stats;                  //!< The outcome of each election.
+  Callback<void, uint32_t> m_winCb;            //!< The winner callback.
+  Time m_tCycle;                               //!< The election cycle duration.
+  Time m_maxBackoff;                           //!< The back-off upper bound.
+  Time m_hearingDelay;                         //!< The modelled hearing delay.
+  uint32_t m_pending;                          //!< Candidates still backing off.
+  bool m_running;                              //!< True while an election is undecided.
+};
+
+} // namespace ns3
+
+#endif /* RELAY_ELECTION_H */
@@ -0,0 +1,298 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Sequential stopping of independent replications: the KPIs of every
+ * replication are added in order, the running mean and the Student t
+ * confidence interval of each tracked KPI are updated, and the
+ * replications stop once every interval half-width is within its target
+ * (or a maximum number of replications is reached).
+ *
+ * The tracked KPIs are given as ';'-separated "name:target" terms, where
+ * the target is an absolute half-width, or a half-width relative to the
+ * mean when it ends with '%', e.g. "pdr:0.01;callSetup(ms):5%".
+ */
+
+#ifndef REPLICATION_CONTROLLER_H
+#define REPLICATION_CONTROLLER_H
+
+#include "ns3/core-module.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Running mean and variance (Welford) of one KPI.
+ */
+class RunningKpi
+{
+public:
+  RunningKpi (void)
+    : m_n (0),
+      m_mean (0),
+      m_m2 (0)
+  { }
+
+  /**
+   * \param x The value of a new replication.
+   */
+  void Add (double x)
+  {
+    ++m_n;
+    double delta = x - m_mean;
+    m_mean += delta / m_n;
+    m_m2 += delta * (x - m_mean);
+  }
+
+  /**
+   * \return The number of values.
+   */
+  uint32_t GetN (void) const
+  {
+    return m_n;
+  }
+
+  /**
+   * \return The mean.
+   */
+  double GetMean (void) const
+  {
+    return m_mean;
+  }
+
+  /**
+   * \return The sample standard deviation.
+   */
+  double GetStdDev (void) const
+  {
+    return m_n > 1 ? std::sqrt (m_m2 / (m_n - 1)) : 0;
+  }
+
+  /**
+   * \param confidence The confidence level, e.g. 0.95.
+   * \return The half-width of the confidence interval of the mean, or
+   *         infinity with fewer than two values.
+   */
+  double GetHalfWidth (double confidence) const
+  {
+    if (m_n < 2)
+      {
+        return std::numeric_limits<double>::infinity ();
+      }
+    return StudentQuantile (0.5 + confidence / 2, m_n - 1) * GetStdDev () / std::sqrt ((double) m_n);
+  }
+
+  /**
+   * \param p A probability in (0, 1).
+   * \return The p-quantile of the standard normal distribution (Acklam).
+   */
+  static double NormalQuantile (double p)
+  {
+    static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+    static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+    static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                3.754408661907416e+00 };
+    NS_ABORT_MSG_IF (p <= 0 || p >= 1, "Bad probability " << p);
+    if (p < 0.02425 || p > 1 - 0.02425)
+      {
+        double q = std::sqrt (-2 * std::log (p < 0.5 ? p : 1 - p));
+        double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+          / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+        return p < 0.5 ? x : -x;
+      }
+    double q = p - 0.5;
+    double r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q
+      / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+  }
+
+  /**
+   * \param p A probability in (0, 1).
+   * \param df The degrees of freedom.
+   * \return The p-quantile of the Student t distribution (exact for 1 and 2
+   *         degrees of freedom, Cornish-Fisher expansion above).
+   */
+  static double StudentQuantile (double p, uint32_t df)
+  {
+    NS_ABORT_MSG_IF (df == 0, "Student t with no degree of freedom");
+    if (df == 1)
+      {
+        return std::tan (M_PI * (p - 0.5));
+      }
+    if (df == 2)
+      {
+        return (2 * p - 1) / std::sqrt (2 * p * (1 - p));
+      }
+    double z = NormalQuantile (p);
+    double z2 = z * z;
+    double n = df;
+    double g1 = z * (z2 + 1) / 4;
+    double g2 = z * ((5 * z2 + 16) * z2 + 3) / 96;
+    double g3 = z * (((3 * z2 + 19) * z2 + 17) * z2 - 15) / 384;
+    double g4 = z * ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) / 92160;
+    return z + g1 / n + g2 / (n * n) + g3 / (n * n * n) + g4 / (n * n * n * n);
+  }
+
+private:
+  uint32_t m_n;    //!< The number of values.
+  double m_mean;   //!< The running mean.
+  double m_m2;     //!< The sum of squared deviations from the mean.
+};
+
+class ReplicationController : public SimpleRefCount<ReplicationController>
+{
+public:
+  /**
+   * \param spec The tracked KPIs and their targets, see the top of this file.
+   */
+  explicit ReplicationController (std::string spec)
+    : m_confidence (0.95),
+      m_minReplications (3),
+      m_maxReplications (100),
+      m_replications (0)
+  {
+    std::istringstream terms (spec);
+    std::string term;
+    while (std::getline (terms, term, ';'))
+      {
+        if (term.empty ())
+          {
+            continue;
+          }
+        std::string::size_type colon = term.rfind (':');
+        NS_ABORT_MSG_IF (colon == std::string::npos || colon == 0 || colon + 1 == term.size (), "Bad KPI term '" << term << "'");
+        std::string target = term.substr (colon + 1);
+        Target t;
+        t.name = term.substr (0, colon);
+        t.relative = target[target.size () - 1] == '%';
+        char *end;
+        t.halfWidth = std::strtod (target.c_str (), &end);
+        NS_ABORT_MSG_IF (end != target.c_str () + target.size () - t.relative || t.halfWidth <= 0, "Bad KPI term '" << term << "'");
+        if (t.relative)
+          {
+            t.halfWidth /= 100;
+          }
+        m_targets.push_back (t);
+      }
+    NS_ABORT_MSG_IF (m_targets.empty (), "No KPI to track");
+  }
+
+  /**
+   * \param confidence The confidence level of the intervals, e.g. 0.95.
+   */
+  void SetConfidence (double confidence)
+  {
+    NS_ABORT_MSG_IF (confidence <= 0 || confidence >= 1, "Bad confidence level " << confidence);
+    m_confidence = confidence;
+  }
+
+  /**
+   * \param minReplications The replications always run.
+   * \param maxReplications The replications never exceeded.
+   */
+  void SetReplicationBounds (uint32_t minReplications, uint32_t maxReplications)
+  {
+    NS_ABORT_MSG_IF (minReplications < 2 || minReplications > maxReplications,
+                     "Bad replication bounds " << minReplications << "-" << maxReplications);
+    m_minReplications = minReplications;
+    m_maxReplications = maxReplications;
+  }
+
+  /**
+   * Add the KPIs of the next replication.
+   * \param kpis The KPI values by name; every tracked KPI must be present.
+   */
+  void AddReplication (const std::map<std::string, double> &kpis)
+  {
+    NS_ABORT_MSG_IF (IsDone (), "Replication added after the stopping point");
+    for (uint32_t t = 0; t < m_targets.size (); ++t)
+      {
+        std::map<std::string, double>::const_iterator it = kpis.find (m_targets[t].name);
+        NS_ABORT_MSG_IF (it == kpis.end (), "Replication " << m_replications << " has no KPI " << m_targets[t].name);
+        m_targets[t].kpi.Add (it->second);
+      }
+    ++m_replications;
+  }
+
+  /**
+   * \return The number of replications added.
+   */
+  uint32_t GetReplications (void) const
+  {
+    return m_replications;
+  }
+
+  /**
+   * \return True if no more replication is needed.
+   */
+  bool IsDone (void) const
+  {
+    return m_replications >= m_maxReplications || (m_replications >= m_minReplications && IsConverged ());
+  }
+
+  /**
+   * \return True if every tracked KPI is within its target.
+   */
+  bool IsConverged (void) const
+  {
+    for (uint32_t t = 0; t < m_targets.size (); ++t)
+      {
+        if (!IsConverged (m_targets[t]))
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+
+  /**
+   * \param os The stream to print the intervals to, one line per KPI.
+   */
+  void Print (std::ostream &os) const
+  {
+    os << "kpi\tn\tmean\tstddev\thalfWidth\ttarget\tconverged" << std::endl;
+    for (uint32_t t = 0; t < m_targets.size (); ++t)
+      {
+        const Target &target = m_targets[t];
+        os << target.name << "\t" << target.kpi.GetN () << "\t" << target.kpi.GetMean () << "\t"
+           << target.kpi.GetStdDev () << "\t" << target.kpi.GetHalfWidth (m_confidence) << "\t"
+           << (target.relative ? target.halfWidth * 100 : target.halfWidth) << (target.relative ? "%" : "") << "\t"
+           << IsConverged (target) << std::endl;
+      }
+  }
+
+private:
+  struct Target
+  {
+    std::string name;    //!< The KPI name.
+    double halfWidth;    //!< The target half-width (a fraction of the mean if relative).
+    bool relative;       //!< Whether the target is relative to the mean.
+    RunningKpi kpi;      //!< The running statistics.
+  };
+
+  bool IsConverged (const Target &target) const
+  {
+    double limit = target.relative ? target.halfWidth * std::fabs (target.kpi.GetMean ()) : target.halfWidth;
+    return target.kpi.GetHalfWidth (m_confidence) <= limit;
+  }
+
+  double m_confidence;             //!< The confidence level.
+  uint32_t m_minReplications;      //!< The replications always run.
+  uint32_t m_maxReplications;      //!< The replications never exceeded.
+  uint32_t m_replications;         //!< The replications added.
+  std::vector<Target> m_targets;   //!< The tracked KPIs.
+};
+
+} // namespace ns3
+
+#endif /* REPLICATION_CONTROLLER_H */
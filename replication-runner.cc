@@ -0,0 +1,160 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Replication driver: runs a scenario with RngRun = firstRun, firstRun + 1,
+ * ... until the confidence interval of every tracked KPI is narrow enough
+ * (see replication-controller.h), instead of a guessed number of seeds.
+ *
+ * Replications run in parallel (--jobs), each in outDir/rep-NNNNN, but are
+ * added to the statistics in RngRun order, so the stopping point does not
+ * depend on which run finishes first; the runs started past the stopping
+ * point are killed. The KPIs of a replication are read from its KPI files
+ * (KpiFile, kpi.txt by default) and FlowMonitor files, as in sweep-runner.
+ * The scenarios fix their random streams with AssignStreams, so that only
+ * RngRun differs between replications.
+ *
+ * The KPIs of every replication are written to outDir/replications.tsv and
+ * the final intervals to outDir/summary.tsv.
+ *
+ * ./waf --run "replication-runner --binary=build/scratch/broadcast_20
+ *   --kpis=callSetup(ms):5% --confidence=0.95 --minReplications=5"
+ */
+
+#include "ns3/core-module.h"
+#include "parameter-sweep.h"
+#include "replication-controller.h"
+
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("ReplicationRunner");
+
+//the directory of a replication
+std::string
+ReplicationDirectory (const std::string &outDir, uint32_t rep)
+{
+  std::ostringstream oss;
+  oss << outDir << "/rep-" << std::setw (5) << std::setfill ('0') << rep;
+  return oss.str ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string binary = "";
+  std::string kpis = "";
+  std::string args = "";
+  std::string outDir = "replications";
+  std::string kpiFiles = "kpi.txt";
+  double confidence = 0.95;
+  uint32_t minReplications = 5;
+  uint32_t maxReplications = 100;
+  uint32_t firstRun = 1;
+  uint32_t jobs = 0;
+
+  CommandLine cmd;
+  cmd.AddValue ("binary", "The scenario binary", binary);
+  cmd.AddValue ("kpis", "The tracked KPIs and their target half-widths, e.g. \"pdr:0.01;callSetup(ms):5%\"", kpis);
+  cmd.AddValue ("args", "Space-separated arguments given to every replication", args);
+  cmd.AddValue ("outDir", "The directory of the replication directories and tables", outDir);
+  cmd.AddValue ("kpiFiles", "Comma-separated names of the KPI files written by the scenario", kpiFiles);
+  cmd.AddValue ("confidence", "Confidence level of the intervals", confidence);
+  cmd.AddValue ("minReplications", "Replications always run", minReplications);
+  cmd.AddValue ("maxReplications", "Replications never exceeded", maxReplications);
+  cmd.AddValue ("firstRun", "RngRun of the first replication", firstRun);
+  cmd.AddValue ("jobs", "Number of concurrent replications (0 for the number of cores)", jobs);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (binary.empty (), "No scenario binary (--binary)");
+  char path[PATH_MAX];
+  NS_ABORT_MSG_IF (realpath (binary.c_str (), path) == 0, "Can't find binary " << binary);
+  binary = path;
+
+  Ptr<ReplicationController> controller = Create<ReplicationController> (kpis);
+  controller->SetConfidence (confidence);
+  controller->SetReplicationBounds (minReplications, maxReplications);
+  std::vector<std::string> fixedArgs;
+  std::istringstream argStream (args);
+  for (std::string a; argStream >> a; )
+    {
+      fixedArgs.push_back (a);
+    }
+  std::vector<std::string> kpiNames = ParameterGrid::SplitList (kpiFiles);
+
+  ProcessPool pool (jobs);
+  ProcessPool::MakeDirectories (outDir);
+  KpiTable table;
+  std::map<uint32_t, KpiTable::Row> finished;   // finished, not yet added
+  uint32_t submitted = 0;
+  while (!controller->IsDone ())
+    {
+      // keep every job busy with the next replications
+      while (submitted < maxReplications && submitted < controller->GetReplications () + pool.GetJobs ())
+        {
+          std::vector<std::string> argv (1, binary);
+          std::ostringstream rngRun;
+          rngRun << "--RngRun=" << firstRun + submitted;
+          argv.push_back (rngRun.str ());
+          argv.insert (argv.end (), fixedArgs.begin (), fixedArgs.end ());
+          pool.Submit (submitted, ReplicationDirectory (outDir, submitted), argv);
+          ++submitted;
+        }
+
+      uint32_t done;
+      int status;
+      NS_ABORT_MSG_UNLESS (pool.Wait (done, status), "No replication running");
+      std::string dir = ReplicationDirectory (outDir, done);
+      NS_ABORT_MSG_IF (status != 0, "Replication " << done << " exited with " << status << ", see " << dir);
+      KpiTable::Row row;
+      std::ostringstream rep;
+      rep << firstRun + done;
+      row.push_back (std::make_pair ("RngRun", rep.str ()));
+      std::vector<std::string> files = KpiTable::ListFiles (dir);
+      for (uint32_t f = 0; f < files.size (); ++f)
+        {
+          if (files[f].size () > 4 && files[f].compare (files[f].size () - 4, 4, ".xml") == 0)
+            {
+              KpiTable::ReadFlowMonitor (dir + "/" + files[f], row);
+            }
+        }
+      for (uint32_t k = 0; k < kpiNames.size (); ++k)
+        {
+          KpiTable::ReadKpiFile (dir + "/" + kpiNames[k], row);
+        }
+      finished[done] = row;
+
+      // add the replications in RngRun order
+      while (!controller->IsDone () && finished.count (controller->GetReplications ()))
+        {
+          const KpiTable::Row &next = finished[controller->GetReplications ()];
+          std::map<std::string, double> values;
+          for (uint32_t c = 0; c < next.size (); ++c)
+            {
+              values[next[c].first] = std::strtod (next[c].second.c_str (), 0);
+            }
+          table.AddRow (next);
+          finished.erase (controller->GetReplications ());
+          controller->AddReplication (values);
+          std::cout << "[" << controller->GetReplications () << "] RngRun " << firstRun + controller->GetReplications () - 1 << std::endl;
+          controller->Print (std::cout);
+        }
+    }
+  pool.Terminate ();
+
+  std::ofstream repOut ((outDir + "/replications.tsv").c_str ());
+  NS_ABORT_MSG_UNLESS (repOut.is_open (), "Can't open file " << outDir << "/replications.tsv");
+  table.Print (repOut);
+  std::ofstream summaryOut ((outDir + "/summary.tsv").c_str ());
+  NS_ABORT_MSG_UNLESS (summaryOut.is_open (), "Can't open file " << outDir << "/summary.tsv");
+  controller->Print (summaryOut);
+
+  std::cout << "Stopped after " << controller->GetReplications () << " replications: "
+            << (controller->IsConverged () ? "all intervals within target" : "maximum replications reached") << std::endl;
+
+  return controller->IsConverged () ? 0 : 2;
+}
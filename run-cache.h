@@ -0,0 +1,320 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Result cache of the scenarios, so that re-running a configuration that
+ * has already been simulated (e.g. a sweep restarted after an unrelated
+ * script edit) returns the stored outputs instead of simulating again.
+ *
+ * A run is identified by the hash of:
+ *  - the binary version: size and modification time of the executable and
+ *    of every ns-3 library it has loaded;
+ *  - the CommandLine values (argv, last value of a name wins);
+ *  - the global values, among them RngSeed and RngRun;
+ *  - the default value of every attribute, i.e. every Config::SetDefault
+ *    and --ns3::Type::Attribute made so far;
+ *  - the keys added by the scenario (AddKey) for settings made otherwise.
+ *
+ * An entry is a directory, cacheDir/<hash>, holding a copy of the output
+ * files registered with AddOutput and the full key text, which is compared
+ * on lookup. Entries are written to a temporary directory and renamed, so
+ * that parallel runs (sweep-runner) can share a cache.
+ *
+ * Compute the key (construct the cache) after the last Config::SetDefault,
+ * and look it up before the scenario creates its trace files, which a hit
+ * would otherwise truncate (lena-simple-epc):
+ *
+ *   Ptr<RunCache> runCache = Create<RunCache> ("run-cache", argc, argv);
+ *   runCache->AddOutput ("kpi.txt");
+ *   if (runCache->Restore ())
+ *     {
+ *       return 0;
+ *     }
+ *   ... build the scenario, open its traces ...
+ *   Simulator::Run ();
+ *   ... write kpi.txt ...
+ *   runCache->Store ();
+ *
+ * A hit restores only the files registered with AddOutput; any other
+ * output of the scenario is left as it is, or not written at all.
+ */
+
+#ifndef RUN_CACHE_H
+#define RUN_CACHE_H
+
+#include "ns3/core-module.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class RunCache : public SimpleRefCount<RunCache>
+{
+public:
+  /**
+   * \param cacheDir The cache directory, created if needed.
+   * \param argc The argument count of main.
+   * \param argv The arguments of main.
+   */
+  RunCache (std::string cacheDir, int argc, char *argv[])
+    : m_cacheDir (cacheDir)
+  {
+    m_ignored.insert ("runCache");
+    m_ignored.insert ("runCacheDir");
+    m_ignored.insert ("invalidateCache");
+    for (int i = 1; i < argc; ++i)
+      {
+        m_argv.push_back (argv[i]);
+      }
+  }
+
+  /**
+   * \param name A CommandLine argument with no effect on the results (the
+   *             cache switches are ignored already).
+   */
+  void IgnoreArgument (std::string name)
+  {
+    m_ignored.insert (name);
+    m_key = "";
+  }
+
+  /**
+   * \param name A setting not made through Config::SetDefault or the
+   *             command line, e.g. an attribute set on a helper.
+   * \param value Its value.
+   */
+  void AddKey (std::string name, std::string value)
+  {
+    m_extra[name] = value;
+    m_key = "";
+  }
+
+  /**
+   * \param filename An output file of the run, stored and restored.
+   */
+  void AddOutput (std::string filename)
+  {
+    m_outputs.push_back (filename);
+  }
+
+  /**
+   * \return The full text of the key.
+   */
+  std::string GetKey (void)
+  {
+    if (m_key.empty ())
+      {
+        m_key = ComputeKey ();
+      }
+    return m_key;
+  }
+
+  /**
+   * \return The entry directory of this run.
+   */
+  std::string GetEntry (void)
+  {
+    std::ostringstream oss;
+    oss << m_cacheDir << "/" << std::hex << std::setw (16) << std::setfill ('0') << Hash64 (GetKey ());
+    return oss.str ();
+  }
+
+  /**
+   * Copy the stored outputs of an identical run, if any, to the working
+   * directory.
+   * \return True if the run was found; the scenario must then not simulate.
+   */
+  bool Restore (void)
+  {
+    std::string entry = GetEntry ();
+    std::ifstream keyFile ((entry + "/key.txt").c_str ());
+    std::stringstream stored;
+    stored << keyFile.rdbuf ();
+    if (!keyFile.is_open () || stored.str () != GetKey ())
+      {
+        return false;
+      }
+    for (uint32_t o = 0; o < m_outputs.size (); ++o)
+      {
+        if (!CopyFile (entry + "/" + StoredName (m_outputs[o]), m_outputs[o]))
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+
+  /**
+   * Store the outputs of this run.
+   */
+  void Store (void)
+  {
+    std::string entry = GetEntry ();
+    std::ostringstream tmp;
+    tmp << entry << ".tmp-" << getpid ();
+    MakeDirectory (m_cacheDir);
+    MakeDirectory (tmp.str ());
+    std::ofstream keyFile ((tmp.str () + "/key.txt").c_str ());
+    keyFile << GetKey ();
+    keyFile.close ();
+    for (uint32_t o = 0; o < m_outputs.size (); ++o)
+      {
+        NS_ABORT_MSG_UNLESS (CopyFile (m_outputs[o], tmp.str () + "/" + StoredName (m_outputs[o])), "Can't cache output " << m_outputs[o]);
+      }
+    Remove (entry);
+    if (rename (tmp.str ().c_str (), entry.c_str ()) != 0)
+      {
+        // an identical run stored it meanwhile
+        Remove (tmp.str ());
+      }
+  }
+
+  /**
+   * Remove the stored outputs of this run, if any.
+   */
+  void Invalidate (void)
+  {
+    Remove (GetEntry ());
+  }
+
+private:
+  std::string ComputeKey (void) const
+  {
+    std::ostringstream key;
+    // binary version
+    std::set<std::string> binaries;
+    char exe[4096];
+    ssize_t len = readlink ("/proc/self/exe", exe, sizeof (exe) - 1);
+    if (len > 0)
+      {
+        binaries.insert (std::string (exe, len));
+      }
+    std::ifstream maps ("/proc/self/maps");
+    for (std::string line; std::getline (maps, line); )
+      {
+        std::string::size_type path = line.find ('/');
+        if (path != std::string::npos && line.find ("libns3", path) != std::string::npos)
+          {
+            binaries.insert (line.substr (path));
+          }
+      }
+    for (std::set<std::string>::const_iterator it = binaries.begin (); it != binaries.end (); ++it)
+      {
+        struct stat st;
+        if (stat (it->c_str (), &st) == 0)
+          {
+            key << "binary " << *it << " " << st.st_size << " " << st.st_mtime << "\n";
+          }
+      }
+    // command line
+    std::map<std::string, std::string> args;
+    for (uint32_t i = 0; i < m_argv.size (); ++i)
+      {
+        std::string arg = m_argv[i];
+        std::string::size_type start = arg.find_first_not_of ('-');
+        std::string::size_type eq = arg.find ('=');
+        std::string name = arg.substr (start == std::string::npos ? 0 : start, eq == std::string::npos ? std::string::npos : eq - start);
+        if (!m_ignored.count (name))
+          {
+            args[name] = eq == std::string::npos ? "" : arg.substr (eq + 1);
+          }
+      }
+    for (std::map<std::string, std::string>::const_iterator it = args.begin (); it != args.end (); ++it)
+      {
+        key << "arg " << it->first << "=" << it->second << "\n";
+      }
+    // global values (RngSeed, RngRun, ...)
+    for (GlobalValue::Iterator it = GlobalValue::Begin (); it != GlobalValue::End (); ++it)
+      {
+        StringValue value;
+        (*it)->GetValue (value);
+        key << "global " << (*it)->GetName () << "=" << value.Get () << "\n";
+      }
+    // attribute defaults, as ConfigStore saves them: no pointers nor containers
+    for (uint32_t i = 0; i < TypeId::GetRegisteredN (); ++i)
+      {
+        TypeId tid = TypeId::GetRegistered (i);
+        for (uint32_t j = 0; j < tid.GetAttributeN (); ++j)
+          {
+            struct TypeId::AttributeInformation info = tid.GetAttribute (j);
+            std::string type = info.checker->GetValueTypeName ();
+            if (!(info.flags & TypeId::ATTR_CONSTRUCT) || type == "ns3::PointerValue" || type == "ns3::ObjectPtrContainerValue")
+              {
+                continue;
+              }
+            key << "default " << tid.GetName () << "::" << info.name << "=" << info.initialValue->SerializeToString (info.checker) << "\n";
+          }
+      }
+    for (std::map<std::string, std::string>::const_iterator it = m_extra.begin (); it != m_extra.end (); ++it)
+      {
+        key << "key " << it->first << "=" << it->second << "\n";
+      }
+    return key.str ();
+  }
+
+  // the name of an output in an entry, which is a flat directory
+  static std::string StoredName (std::string filename)
+  {
+    std::replace (filename.begin (), filename.end (), '/', '%');
+    return filename;
+  }
+
+  static bool CopyFile (const std::string &from, const std::string &to)
+  {
+    std::ifstream in (from.c_str (), std::ifstream::binary);
+    std::ofstream out (to.c_str (), std::ofstream::binary | std::ofstream::trunc);
+    if (!in.is_open () || !out.is_open ())
+      {
+        return false;
+      }
+    out << in.rdbuf ();
+    return out.good ();
+  }
+
+  static void MakeDirectory (const std::string &dir)
+  {
+    NS_ABORT_MSG_IF (mkdir (dir.c_str (), 0755) != 0 && errno != EEXIST, "Can't create directory " << dir);
+  }
+
+  // entries are flat directories
+  static void Remove (const std::string &dir)
+  {
+    DIR *d = opendir (dir.c_str ());
+    if (d == 0)
+      {
+        return;
+      }
+    for (struct dirent *e = readdir (d); e != 0; e = readdir (d))
+      {
+        std::string name = e->d_name;
+        if (name != "." && name != "..")
+          {
+            unlink ((dir + "/" + name).c_str ());
+          }
+      }
+    closedir (d);
+    rmdir (dir.c_str ());
+  }
+
+  std::string m_cacheDir;                       //!< The cache directory.
+  std::vector<std::string> m_argv;              //!< The arguments of main.
+  std::set<std::string> m_ignored;              //!< The arguments left out of the key.
+  std::map<std::string, std::string> m_extra;   //!< The keys added by the scenario.
+  std::vector<std::string> m_outputs;           //!< The output files.
+  std::string m_key;                            //!< The key text, once computed.
+};
+
+} // namespace ns3
+
+#endif /* RUN_CACHE_H */
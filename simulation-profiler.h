@@ -0,0 +1,98 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Cost of a simulation run: wall-clock time and simulator events processed
+ * between Start and Stop, and the peak resident set size of the process.
+ *
+ *   SimulationProfiler profiler;
+ *   profiler.Start ();
+ *   Simulator::Run ();
+ *   profiler.Stop ();
+ *   profiler.Print (std::cout);
+ */
+
+#ifndef SIMULATION_PROFILER_H
+#define SIMULATION_PROFILER_H
+
+#include "ns3/core-module.h"
+
+#include <sys/resource.h>
+#include <chrono>
+#include <ostream>
+
+namespace ns3 {
+
+class SimulationProfiler
+{
+public:
+  SimulationProfiler (void)
+    : m_events (0),
+      m_wallTime (0)
+  { }
+
+  /**
+   * Start measuring.
+   */
+  void Start (void)
+  {
+    m_events = Simulator::GetEventCount ();
+    m_start = std::chrono::steady_clock::now ();
+  }
+
+  /**
+   * Stop measuring.
+   */
+  void Stop (void)
+  {
+    m_wallTime = std::chrono::duration<double> (std::chrono::steady_clock::now () - m_start).count ();
+    m_events = Simulator::GetEventCount () - m_events;
+  }
+
+  /**
+   * \return The wall-clock time between Start and Stop, in seconds.
+   */
+  double GetWallTime (void) const
+  {
+    return m_wallTime;
+  }
+
+  /**
+   * \return The number of events processed between Start and Stop.
+   */
+  uint64_t GetEvents (void) const
+  {
+    return m_events;
+  }
+
+  /**
+   * \return The peak resident set size of the process, in KiB.
+   */
+  static uint64_t GetPeakRss (void)
+  {
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+  }
+
+  /**
+   * \param os The stream to print the measures to, on one line.
+   */
+  void Print (std::ostream &os) const
+  {
+    os << "wall time " << m_wallTime << " s, "
+       << m_events << " events (" << (m_wallTime > 0 ? m_events / m_wallTime : 0) << " events/s), "
+       << "peak RSS " << GetPeakRss () << " KiB" << std::endl;
+  }
+
+private:
+  uint64_t m_events;                                   //!< The events processed.
+  double m_wallTime;                                   //!< The wall-clock time, in seconds.
+  std::chrono::steady_clock::time_point m_start;       //!< The time Start was called.
+};
+
+} // namespace ns3
+
+#endif /* SIMULATION_PROFILER_H */
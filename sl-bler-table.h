@@ -0,0 +1,278 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Precomputed BLER of the sidelink error model (LteNistErrorModel, AWGN,
+ * SISO, first transmission): the PSCCH, PSDCH and per-MCS PSSCH curves
+ * are sampled once on a dense SINR grid, so that a reception costs an
+ * index computation and a load instead of the model's curve search and
+ * interpolation. The PSSCH BLER of the model only depends on the MCS, not
+ * on the transport block size, hence one row per MCS.
+ *
+ * The rows are built on first use, or all at once by Build; Load and Save
+ * keep them in a cache file, whose grid must match and whose rows are
+ * checked against the live model at a few SINRs, so that a cache of
+ * another ns-3 build is rebuilt rather than used.
+ *
+ *   Ptr<SlBlerTable> blerTable = Create<SlBlerTable> ();
+ *   if (!blerTable->Load ("bler-table.bin"))
+ *     {
+ *       blerTable->Build (mcsList);
+ *       blerTable->Save ("bler-table.bin");
+ *     }
+ *   double bler = blerTable->GetPsschBler (mcs, sinrDb);
+ *
+ * SINRs below the grid get the BLER of its first point (1 for any
+ * sensible grid), above it the BLER of its last point. The default grid,
+ * -20 to 40 dB by 0.01 dB, is 6001 doubles (47 kB) per row.
+ */
+
+#ifndef SL_BLER_TABLE_H
+#define SL_BLER_TABLE_H
+
+#include "ns3/core-module.h"
+#include "ns3/lte-module.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class SlBlerTable : public SimpleRefCount<SlBlerTable>
+{
+public:
+  /// The channels of the table
+  enum Channel
+  {
+    PSCCH,
+    PSDCH,
+    PSSCH
+  };
+
+  /**
+   * \param minSinrDb The first SINR of the grid (dB).
+   * \param maxSinrDb The last SINR of the grid (dB).
+   * \param stepDb The grid step (dB).
+   */
+  SlBlerTable (double minSinrDb = -20, double maxSinrDb = 40, double stepDb = 0.01)
+    : m_minSinrDb (minSinrDb),
+      m_stepDb (stepDb),
+      m_invStepDb (1 / stepDb),
+      m_points (std::floor ((maxSinrDb - minSinrDb) / stepDb + 0.5) + 1),
+      m_rows ((PSSCH + 1) << 8)
+  {
+    NS_ABORT_MSG_IF (stepDb <= 0 || maxSinrDb <= minSinrDb, "Bad BLER grid " << minSinrDb << ":" << stepDb << ":" << maxSinrDb);
+  }
+
+  /**
+   * Build the control rows and the PSSCH rows of some MCSs.
+   * \param mcsList The PSSCH MCSs.
+   */
+  void Build (const std::vector<uint32_t> &mcsList)
+  {
+    GetRow (PSCCH, 0);
+    GetRow (PSDCH, 0);
+    for (uint32_t i = 0; i < mcsList.size (); i++)
+      {
+        GetRow (PSSCH, mcsList[i]);
+      }
+  }
+
+  /**
+   * \param sinrDb The SINR (dB).
+   * \return The BLER of a SCI.
+   */
+  double GetPscchBler (double sinrDb)
+  {
+    return Lookup (GetRow (PSCCH, 0), sinrDb);
+  }
+
+  /**
+   * \param sinrDb The SINR (dB).
+   * \return The BLER of a discovery message.
+   */
+  double GetPsdchBler (double sinrDb)
+  {
+    return Lookup (GetRow (PSDCH, 0), sinrDb);
+  }
+
+  /**
+   * \param mcs The MCS.
+   * \param sinrDb The SINR (dB).
+   * \return The BLER of a transport block.
+   */
+  double GetPsschBler (uint32_t mcs, double sinrDb)
+  {
+    return Lookup (GetRow (PSSCH, mcs), sinrDb);
+  }
+
+  /**
+   * \param channel The channel.
+   * \param mcs The MCS, for the PSSCH.
+   * \param sinrDb The SINR (dB).
+   * \return The BLER of the error model itself, without the table.
+   */
+  static double ComputeBler (Channel channel, uint32_t mcs, double sinrDb)
+  {
+    HarqProcessInfoList_t harqHistory;
+    switch (channel)
+      {
+      case PSCCH:
+        return LteNistErrorModel::GetPscchBler (LteNistErrorModel::AWGN, LteNistErrorModel::SISO, sinrDb).tbler;
+      case PSDCH:
+        return LteNistErrorModel::GetPsdchBler (LteNistErrorModel::AWGN, LteNistErrorModel::SISO, sinrDb, harqHistory).tbler;
+      default:
+        return LteNistErrorModel::GetPsschBler (LteNistErrorModel::AWGN, LteNistErrorModel::SISO, mcs, sinrDb, harqHistory).tbler;
+      }
+  }
+
+  /**
+   * \param filename The cache file, replaced atomically.
+   */
+  void Save (std::string filename) const
+  {
+    std::string tmp = filename + ".tmp";
+    std::ofstream os (tmp.c_str (), std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_UNLESS (os, "Cannot write the BLER table " << tmp);
+    os.write ("BLER", 4);
+    Write (os, VERSION);
+    Write (os, m_minSinrDb);
+    Write (os, m_stepDb);
+    Write (os, m_points);
+    uint32_t nRows = 0;
+    for (uint32_t key = 0; key < m_rows.size (); key++)
+      {
+        nRows += !m_rows[key].empty ();
+      }
+    Write (os, nRows);
+    for (uint32_t key = 0; key < m_rows.size (); key++)
+      {
+        if (!m_rows[key].empty ())
+          {
+            Write (os, key);
+            os.write (reinterpret_cast<const char *> (&m_rows[key][0]), m_points * sizeof (double));
+          }
+      }
+    os.close ();
+    NS_ABORT_MSG_UNLESS (os, "Cannot write the BLER table " << tmp);
+    NS_ABORT_MSG_IF (std::rename (tmp.c_str (), filename.c_str ()) != 0, "Cannot rename " << tmp << " to " << filename);
+  }
+
+  /**
+   * \param filename The cache file.
+   * \return False if there is no such file, or if it is of another grid
+   *         or error model; true once its rows are loaded.
+   */
+  bool Load (std::string filename)
+  {
+    std::ifstream is (filename.c_str (), std::ios::binary);
+    if (!is)
+      {
+        return false;
+      }
+    char magic[4];
+    is.read (magic, 4);
+    if (!is || std::string (magic, 4) != "BLER" || Read<uint32_t> (is) != VERSION
+        || Read<double> (is) != m_minSinrDb || Read<double> (is) != m_stepDb || Read<uint32_t> (is) != m_points)
+      {
+        return false;
+      }
+    std::vector<std::vector<double> > rows (m_rows.size ());
+    uint32_t nRows = Read<uint32_t> (is);
+    for (uint32_t r = 0; r < nRows && is; r++)
+      {
+        uint32_t key = Read<uint32_t> (is);
+        if (key >= rows.size ())
+          {
+            return false;
+          }
+        std::vector<double> &row = rows[key];
+        row.resize (m_points);
+        is.read (reinterpret_cast<char *> (&row[0]), m_points * sizeof (double));
+        // a few points of the live model, in case the curves changed
+        for (uint32_t i = 0; i < m_points && is; i += m_points / 7 + 1)
+          {
+            if (row[i] != ComputeBler (KeyChannel (key), KeyMcs (key), m_minSinrDb + i * m_stepDb))
+              {
+                return false;
+              }
+          }
+      }
+    if (!is)
+      {
+        return false;
+      }
+    m_rows.swap (rows);
+    return true;
+  }
+
+private:
+  static const uint32_t VERSION = 1;
+
+  static uint32_t Key (Channel channel, uint32_t mcs)
+  {
+    return channel << 8 | mcs;
+  }
+
+  static Channel KeyChannel (uint32_t key)
+  {
+    return (Channel) (key >> 8);
+  }
+
+  static uint32_t KeyMcs (uint32_t key)
+  {
+    return key & 0xFF;
+  }
+
+  // the row of a channel, computed on first use
+  const std::vector<double> &GetRow (Channel channel, uint32_t mcs)
+  {
+    NS_ABORT_MSG_IF (mcs > 0xFF, "Bad MCS " << mcs);
+    std::vector<double> &row = m_rows[Key (channel, mcs)];
+    if (row.empty ())
+      {
+        row.resize (m_points);
+        for (uint32_t i = 0; i < m_points; i++)
+          {
+            row[i] = ComputeBler (channel, mcs, m_minSinrDb + i * m_stepDb);
+          }
+      }
+    return row;
+  }
+
+  // the BLER of the nearest grid point
+  double Lookup (const std::vector<double> &row, double sinrDb) const
+  {
+    double x = (sinrDb - m_minSinrDb) * m_invStepDb + 0.5;
+    if (!(x > 0))
+      {
+        return row[0];
+      }
+    return x < m_points ? row[(uint32_t) x] : row[m_points - 1];
+  }
+
+  template <typename T>
+  static void Write (std::ostream &os, T value)
+  {
+    os.write (reinterpret_cast<const char *> (&value), sizeof (value));
+  }
+
+  template <typename T>
+  static T Read (std::istream &is)
+  {
+    T value = T ();
+    is.read (reinterpret_cast<char *> (&value), sizeof (value));
+    return value;
+  }
+
+  double m_minSinrDb;                                     //!< The first SINR of the grid (dB).
+  double m_stepDb;                                        //!< The grid step (dB).
+  double m_invStepDb;                                     //!< Its inverse.
+  uint32_t m_points;                                      //!< The points of a row.
+  std::vector<std::vector<double> > m_rows;               //!< The BLER of every channel and MCS, empty if not built.
+};
+
+} // namespace ns3
+
+#endif /* SL_BLER_TABLE_H */
@@ -0,0 +1,155 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Micro-benchmark of the sidelink interference accumulation: one receiver
+ * gets the signals of 10, 100 and 1000 concurrent transmitters, each on a
+ * random subchannel of a 50 and a 100 RB band, sums their PSDs and
+ * computes the per-RB SINR of every one of them,
+ *  - with SpectrumValue operators, as LteInterference;
+ *  - with SlInterference, scalar loops;
+ *  - with SlInterference, AVX2 loops (if the CPU has them);
+ * checks that the results agree and reports the cost per reception.
+ *
+ * Build with the optimized profile:
+ * ./waf configure --build-profile=optimized
+ * ./waf --run "sl-interference-bench --iterations=20"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/spectrum-module.h"
+#include "sl-interference.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SlInterferenceBench");
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t iterations = 20;
+  uint32_t rbSize = 10;
+  std::string transmitters = "10,100,1000";
+  std::string bandwidths = "50,100";
+
+  CommandLine cmd;
+  cmd.AddValue ("iterations", "Number of times every configuration is run", iterations);
+  cmd.AddValue ("rbSize", "RBs of a transmission", rbSize);
+  cmd.AddValue ("transmitters", "Comma-separated numbers of concurrent transmitters", transmitters);
+  cmd.AddValue ("bandwidths", "Comma-separated bandwidths (RBs)", bandwidths);
+  cmd.Parse (argc, argv);
+
+  Ptr<UniformRandomVariable> rnd = CreateObject<UniformRandomVariable> ();
+  bool haveAvx2 = SlInterference::IsVectorized ();
+  uint32_t mismatches = 0;
+  double sink = 0;
+
+  std::cout << "AVX2: " << (haveAvx2 ? "yes" : "no") << "\titerations: " << iterations << std::endl;
+  std::cout << "RBs\ttransmitters\tSpectrumValue(ns)\tscalar(ns)\tAVX2(ns)\tspeedup" << std::endl;
+  std::istringstream bwList (bandwidths);
+  for (std::string bw; std::getline (bwList, bw, ','); )
+    {
+      uint32_t nRbs = std::strtoul (bw.c_str (), 0, 10);
+      NS_ABORT_MSG_IF (nRbs < rbSize, "Band of " << nRbs << " RBs narrower than a transmission");
+      std::vector<double> frequencies;
+      for (uint32_t rb = 0; rb < nRbs; ++rb)
+        {
+          frequencies.push_back (1.7e9 + 180e3 * rb);
+        }
+      Ptr<SpectrumModel> model = Create<SpectrumModel> (frequencies);
+      SpectrumValue noise (model);
+      noise = 1.0e-20;
+
+      std::istringstream txList (transmitters);
+      for (std::string tx; std::getline (txList, tx, ','); )
+        {
+          uint32_t nTxs = std::strtoul (tx.c_str (), 0, 10);
+          std::vector<Ptr<SpectrumValue> > psds;
+          for (uint32_t t = 0; t < nTxs; ++t)
+            {
+              Ptr<SpectrumValue> psd = Create<SpectrumValue> (model);
+              uint32_t first = rnd->GetInteger (0, (nRbs - rbSize) / rbSize) * rbSize;
+              double level = std::pow (10, rnd->GetValue (-21, -15));
+              for (uint32_t rb = first; rb < first + rbSize; ++rb)
+                {
+                  (*psd)[rb] = level;
+                }
+              psds.push_back (psd);
+            }
+
+          // SpectrumValue operators
+          std::vector<SpectrumValue> reference (nTxs, SpectrumValue (model));
+          auto start = std::chrono::steady_clock::now ();
+          for (uint32_t it = 0; it < iterations; ++it)
+            {
+              Ptr<SpectrumValue> allSignals = Create<SpectrumValue> (model);
+              for (uint32_t t = 0; t < nTxs; ++t)
+                {
+                  *allSignals += *psds[t];
+                }
+              for (uint32_t t = 0; t < nTxs; ++t)
+                {
+                  reference[t] = *psds[t] / ((*allSignals - *psds[t]) + noise);
+                }
+              sink += reference[it % nTxs][0];
+            }
+          double spectrumValueNs = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+
+          double pathNs[2] = {0, 0};
+          for (uint32_t vectorized = 0; vectorized < 2; ++vectorized)
+            {
+              if (vectorized && !haveAvx2)
+                {
+                  continue;
+                }
+              SlInterference::SetVectorized (vectorized);
+              SlInterference interference (noise);
+              SpectrumValue sinr (model);
+              start = std::chrono::steady_clock::now ();
+              for (uint32_t it = 0; it < iterations; ++it)
+                {
+                  interference.Reset ();
+                  for (uint32_t t = 0; t < nTxs; ++t)
+                    {
+                      interference.AddSignal (*psds[t]);
+                    }
+                  for (uint32_t t = 0; t < nTxs; ++t)
+                    {
+                      interference.GetSinr (*psds[t], sinr);
+                      if (it == 0)
+                        {
+                          for (uint32_t rb = 0; rb < nRbs; ++rb)
+                            {
+                              mismatches += sinr[rb] != reference[t][rb];
+                            }
+                        }
+                    }
+                  sink += sinr[0];
+                }
+              pathNs[vectorized] = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+            }
+          SlInterference::SetVectorized (haveAvx2);
+
+          double receptions = (double) nTxs * iterations;
+          std::cout << nRbs << "\t" << nTxs << "\t" << spectrumValueNs / receptions << "\t" << pathNs[0] / receptions << "\t";
+          if (haveAvx2)
+            {
+              std::cout << pathNs[1] / receptions << "\t" << spectrumValueNs / pathNs[1] << "x";
+            }
+          else
+            {
+              std::cout << "-\t" << spectrumValueNs / pathNs[0] << "x";
+            }
+          std::cout << std::endl;
+        }
+    }
+  std::cout << "mismatches: " << mismatches << " (checksum " << sink << ")" << std::endl;
+
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Per-RB interference accumulation and SINR of a sidelink receiver, over
+ * the raw values of SpectrumValue: the sum of the PSDs of the concurrent
+ * signals is kept in one array, updated when a signal starts or ends, and
+ * the SINR of a signal is
+ *
+ *   SINR[rb] = S[rb] / (sum[rb] - S[rb] + N[rb])
+ *
+ * as LteInterference computes it with SpectrumValue operators, without
+ * their temporary SpectrumValues.
+ *
+ * On x86 the loops run on AVX2 (4 RBs per instruction) when the CPU has
+ * it, detected at run time so that a default build gets it too, and on
+ * the scalar loops otherwise. Both paths do the same operations in the
+ * same order (no FMA), so their results are identical.
+ *
+ *   SlInterference interference (noisePsd);
+ *   interference.AddSignal (*rxPsd);
+ *   ...
+ *   interference.GetSinr (*rxPsd, sinr);
+ *   ...
+ *   interference.RemoveSignal (*rxPsd);
+ *
+ * All the SpectrumValues must be of the spectrum model of the noise PSD
+ * (50 or 100 RBs in the scenarios). Adding then removing a signal is
+ * exact up to the rounding of the other signals added meanwhile; Reset
+ * when the receiver is idle.
+ */
+
+#ifndef SL_INTERFERENCE_H
+#define SL_INTERFERENCE_H
+
+#include "ns3/core-module.h"
+#include "ns3/spectrum-module.h"
+
+#include <cstddef>
+#include <vector>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define SL_INTERFERENCE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace ns3 {
+
+class SlInterference
+{
+public:
+  /**
+   * \param noisePsd The noise PSD of the receiver.
+   */
+  SlInterference (const SpectrumValue &noisePsd)
+    : m_noise (noisePsd.ConstValuesBegin (), noisePsd.ConstValuesEnd ()),
+      m_total (m_noise.size (), 0),
+      m_model (noisePsd.GetSpectrumModel ())
+  { }
+
+  /**
+   * \param psd The PSD of a signal starting.
+   */
+  void AddSignal (const SpectrumValue &psd)
+  {
+    Accumulate (&m_total[0], Values (psd), m_total.size (), 1);
+  }
+
+  /**
+   * \param psd The PSD of a signal ending, given to AddSignal before.
+   */
+  void RemoveSignal (const SpectrumValue &psd)
+  {
+    Accumulate (&m_total[0], Values (psd), m_total.size (), -1);
+  }
+
+  /**
+   * Forget every signal.
+   */
+  void Reset (void)
+  {
+    m_total.assign (m_total.size (), 0);
+  }
+
+  /**
+   * \param psd The PSD of a signal, added to the total.
+   * \param sinr Set to its SINR, against the other signals and the noise.
+   */
+  void GetSinr (const SpectrumValue &psd, SpectrumValue &sinr) const
+  {
+    NS_ABORT_MSG_UNLESS (sinr.GetSpectrumModel () == m_model, "SINR of another spectrum model");
+    Sinr (Values (psd), &m_total[0], &m_noise[0], m_total.size (), &*sinr.ValuesBegin ());
+  }
+
+  /**
+   * \return The sum of the PSDs of the signals.
+   */
+  const std::vector<double> &GetTotal (void) const
+  {
+    return m_total;
+  }
+
+  /**
+   * total[rb] += sign * psd[rb]
+   * \param total The accumulated PSD.
+   * \param psd The PSD of a signal.
+   * \param n The number of RBs.
+   * \param sign 1 to add the signal, -1 to remove it.
+   */
+  static void Accumulate (double *total, const double *psd, std::size_t n, double sign)
+  {
+#ifdef SL_INTERFERENCE_AVX2
+    if (IsVectorized ())
+      {
+        AccumulateAvx2 (total, psd, n, sign);
+        return;
+      }
+#endif
+    AccumulateScalar (total, psd, n, sign);
+  }
+
+  /**
+   * sinr[rb] = signal[rb] / (total[rb] - signal[rb] + noise[rb])
+   * \param signal The PSD of a signal.
+   * \param total The accumulated PSD, signal included.
+   * \param noise The noise PSD.
+   * \param n The number of RBs.
+   * \param sinr The SINR of the signal; may alias none of the inputs.
+   */
+  static void Sinr (const double *signal, const double *total, const double *noise, std::size_t n, double *sinr)
+  {
+#ifdef SL_INTERFERENCE_AVX2
+    if (IsVectorized ())
+      {
+        SinrAvx2 (signal, total, noise, n, sinr);
+        return;
+      }
+#endif
+    SinrScalar (signal, total, noise, n, sinr);
+  }
+
+  /**
+   * \return Whether the AVX2 loops are used.
+   */
+  static bool IsVectorized (void)
+  {
+    return Vectorized ();
+  }
+
+  /**
+   * \param enabled Whether to use the AVX2 loops, when the CPU has them
+   *                (e.g. false to compare with the scalar ones).
+   */
+  static void SetVectorized (bool enabled)
+  {
+#ifdef SL_INTERFERENCE_AVX2
+    Vectorized () = enabled && __builtin_cpu_supports ("avx2");
+#endif
+  }
+
+private:
+  const double *Values (const SpectrumValue &psd) const
+  {
+    NS_ABORT_MSG_UNLESS (psd.GetSpectrumModel () == m_model, "PSD of another spectrum model");
+    return &*psd.ConstValuesBegin ();
+  }
+
+  static bool &Vectorized (void)
+  {
+#ifdef SL_INTERFERENCE_AVX2
+    static bool vectorized = __builtin_cpu_supports ("avx2");
+#else
+    static bool vectorized = false;
+#endif
+    return vectorized;
+  }
+
+  static void AccumulateScalar (double *total, const double *psd, std::size_t n, double sign)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+      {
+        total[i] += sign * psd[i];
+      }
+  }
+
+  static void SinrScalar (const double *signal, const double *total, const double *noise, std::size_t n, double *sinr)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+      {
+        sinr[i] = signal[i] / (total[i] - signal[i] + noise[i]);
+      }
+  }
+
+#ifdef SL_INTERFERENCE_AVX2
+  __attribute__ ((target ("avx2")))
+  static void AccumulateAvx2 (double *total, const double *psd, std::size_t n, double sign)
+  {
+    __m256d s = _mm256_set1_pd (sign);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+      {
+        __m256d t = _mm256_loadu_pd (total + i);
+        t = _mm256_add_pd (t, _mm256_mul_pd (s, _mm256_loadu_pd (psd + i)));
+        _mm256_storeu_pd (total + i, t);
+      }
+    AccumulateScalar (total + i, psd + i, n - i, sign);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static void SinrAvx2 (const double *signal, const double *total, const double *noise, std::size_t n, double *sinr)
+  {
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+      {
+        __m256d s = _mm256_loadu_pd (signal + i);
+        __m256d d = _mm256_add_pd (_mm256_sub_pd (_mm256_loadu_pd (total + i), s), _mm256_loadu_pd (noise + i));
+        _mm256_storeu_pd (sinr + i, _mm256_div_pd (s, d));
+      }
+    SinrScalar (signal + i, total + i, noise + i, n - i, sinr + i);
+  }
+#endif
+
+  std::vector<double> m_noise;                  //!< The noise PSD.
+  std::vector<double> m_total;                  //!< The sum of the PSDs of the signals.
+  Ptr<const SpectrumModel> m_model;             //!< The spectrum model of the PSDs.
+};
+
+} // namespace ns3
+
+#endif /* SL_INTERFERENCE_H */
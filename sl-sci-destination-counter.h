@@ -0,0 +1,135 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Counters of the sidelink SCIs a UE decodes, keyed on their group
+ * destination ID (the 8 least significant bits of the group L2 address,
+ * e.g. 255 in broadcast_20, 200 + group in wns3-2017-synch).
+ *
+ * The counter filters nothing: dropping the PSSCH transport blocks of
+ * other destinations is up to the stack, whose sidelink spectrum PHY only
+ * decodes those of the L1 group IDs registered by the RECEIVE sidelink
+ * bearers. The scenario declares the same subscriptions here (Subscribe),
+ * and every SCI decoded is checked against them, so that the share of
+ * the SCIs (and of the transport block bytes they announce) that are of
+ * groups the UE does not subscribe to is known.
+ *
+ *   Ptr<SlSciDestinationCounter> sciCounter = Create<SlSciDestinationCounter> ();
+ *   sciCounter->Subscribe (rxUes, groupL2Address);
+ *   ...
+ *   sciCounter->Install (ueDevs);
+ *   Simulator::Run ();
+ *   sciCounter->PrintStats (std::cout);
+ *
+ * Two groups whose L2 addresses share their 8 least significant bits
+ * cannot be told apart by the SCI and are both counted as subscribed.
+ */
+
+#ifndef SL_SCI_DESTINATION_COUNTER_H
+#define SL_SCI_DESTINATION_COUNTER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/lte-module.h"
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <vector>
+
+namespace ns3 {
+
+class SlSciDestinationCounter : public SimpleRefCount<SlSciDestinationCounter>
+{
+public:
+  SlSciDestinationCounter (void)
+    : m_subscribed (0),
+      m_other (0),
+      m_otherBytes (0)
+  { }
+
+  /**
+   * \param ues The UE devices receiving the group.
+   * \param groupL2Address The group L2 address, as in the LteSlTft.
+   */
+  void Subscribe (NetDeviceContainer ues, uint32_t groupL2Address)
+  {
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        m_subscriptions[PeekPointer (ues.Get (i))].insert (GroupDstId (groupL2Address));
+      }
+  }
+
+  /**
+   * Count the SCIs every UE decodes. Call once the subscriptions are
+   * complete.
+   * \param ues The UE devices, subscribed or not.
+   */
+  void Install (NetDeviceContainer ues)
+  {
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        Ptr<LteUeNetDevice> ueDev = ues.Get (i)->GetObject<LteUeNetDevice> ();
+        NS_ABORT_MSG_IF (ueDev == 0, "Device " << i << " is not an LTE UE");
+        Ptr<LteSpectrumPhy> slPhy = ueDev->GetPhy ()->GetSlSpectrumPhy ();
+        uint32_t ue = m_ueGroups.size ();
+        m_ueGroups.push_back (m_subscriptions[PeekPointer (ues.Get (i))]);
+        slPhy->TraceConnectWithoutContext ("SlPscchReception", MakeBoundCallback (&SlSciDestinationCounter::SciReceived,
+                                                                                  Ptr<SlSciDestinationCounter> (this), ue));
+      }
+  }
+
+  /**
+   * \return The number of SCIs of a subscribed group.
+   */
+  uint64_t GetSubscribed (void) const
+  {
+    return m_subscribed;
+  }
+
+  /**
+   * \return The number of SCIs of another group.
+   */
+  uint64_t GetOther (void) const
+  {
+    return m_other;
+  }
+
+  /**
+   * \param os The stream to print the counters to.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    uint64_t scis = m_subscribed + m_other;
+    os << "SCI destinations: " << m_subscribed << " of a subscribed group, " << m_other << " of another group ("
+       << (scis ? 100.0 * m_other / scis : 0) << "% of the SCIs, announcing " << m_otherBytes << " TB bytes)" << std::endl;
+  }
+
+private:
+  // the SCI group destination ID of a group L2 address
+  static uint8_t GroupDstId (uint32_t groupL2Address)
+  {
+    return groupL2Address & 0xFF;
+  }
+
+  static void SciReceived (Ptr<SlSciDestinationCounter> counter, uint32_t ue, SlPhyReceptionStatParameters params)
+  {
+    if (counter->m_ueGroups[ue].count (params.m_groupDestinationId))
+      {
+        counter->m_subscribed++;
+      }
+    else
+      {
+        counter->m_other++;
+        counter->m_otherBytes += params.m_tbSize;
+      }
+  }
+
+  std::map<const NetDevice *, std::set<uint8_t> > m_subscriptions;   //!< The groups of every subscribed UE.
+  std::vector<std::set<uint8_t> > m_ueGroups;                         //!< The groups of every installed UE.
+  uint64_t m_subscribed;                                              //!< The SCIs of a subscribed group.
+  uint64_t m_other;                                                   //!< The SCIs of another group.
+  uint64_t m_otherBytes;                                              //!< The TB bytes they announced.
+};
+
+} // namespace ns3
+
+#endif /* SL_SCI_DESTINATION_COUNTER_H */
@@ -0,0 +1,229 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Parameter sweep driver for the scenarios of this directory.
+ *
+ * Every point of a grid of CommandLine values is run once per seed
+ * (--RngRun), in parallel on all the cores (or --jobs), each run in its own
+ * directory outDir/run-NNNNN where the scenario writes its traces, standard
+ * output and error. When all runs are done their FlowMonitor and KPI
+ * outputs are merged into one table, outDir/sweep.tsv, with one row per
+ * run: run, the parameters, RngRun, exit status, then the KPIs.
+ *
+ * With --resume (the default) a run that already finished successfully in
+ * outDir with the same command line (saved in its args.txt) is not run
+ * again, so an interrupted sweep can be restarted. Any other run has the
+ * status, KPI and FlowMonitor files of a previous run of its directory
+ * deleted first, so that they cannot be merged if it fails.
+ *
+ * The scenario binary is run directly, so run the driver through waf to get
+ * the library path:
+ *
+ * ./waf --run "sweep-runner --binary=build/scratch/lte-sl-relay-cluster
+ *   --grid=relayRadius=100,300;nRemoteUesPerRelay=1,5,10 --seeds=1,2,3
+ *   --args=--simTime=10 --outDir=relay-sweep"
+ */
+
+#include "ns3/core-module.h"
+#include "parameter-sweep.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SweepRunner");
+
+//the directory of a run
+std::string
+RunDirectory (const std::string &outDir, uint32_t run)
+{
+  std::ostringstream oss;
+  oss << outDir << "/run-" << std::setw (5) << std::setfill ('0') << run;
+  return oss.str ();
+}
+
+//exit status recorded by a previous sweep, -1 if none
+int
+ReadStatus (const std::string &dir)
+{
+  std::ifstream in ((dir + "/status.txt").c_str ());
+  int status;
+  return (in >> status) ? status : -1;
+}
+
+//command line of a previous run, empty if none
+std::vector<std::string>
+ReadArgs (const std::string &dir)
+{
+  std::vector<std::string> argv;
+  std::ifstream in ((dir + "/args.txt").c_str ());
+  for (std::string arg; std::getline (in, arg); )
+    {
+      argv.push_back (arg);
+    }
+  return argv;
+}
+
+//save the command line of a run and delete the outputs of a previous one
+void
+PrepareRun (const std::string &dir, const std::vector<std::string> &argv, const std::vector<std::string> &kpiNames)
+{
+  ProcessPool::MakeDirectories (dir);
+  std::remove ((dir + "/status.txt").c_str ());
+  for (uint32_t k = 0; k < kpiNames.size (); ++k)
+    {
+      std::remove ((dir + "/" + kpiNames[k]).c_str ());
+    }
+  std::vector<std::string> files = KpiTable::ListFiles (dir);
+  for (uint32_t f = 0; f < files.size (); ++f)
+    {
+      if (files[f].size () > 4 && files[f].compare (files[f].size () - 4, 4, ".xml") == 0)
+        {
+          std::remove ((dir + "/" + files[f]).c_str ());
+        }
+    }
+  std::ofstream out ((dir + "/args.txt").c_str ());
+  NS_ABORT_MSG_UNLESS (out.is_open (), "Can't open file " << dir << "/args.txt");
+  for (uint32_t i = 0; i < argv.size (); ++i)
+    {
+      out << argv[i] << std::endl;
+    }
+}
+
+//save the exit status of a finished run and report progress
+void
+RecordStatus (const std::string &dir, int status, uint32_t finished, uint32_t nRuns)
+{
+  std::ofstream out ((dir + "/status.txt").c_str ());
+  out << status << std::endl;
+  std::cout << "[" << finished << "/" << nRuns << "] " << dir << " exit " << status << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string binary = "";
+  std::string grid = "";
+  std::string seeds = "1";
+  std::string args = "";
+  std::string outDir = "sweep";
+  std::string kpiFiles = "kpi.txt";
+  uint32_t jobs = 0;
+  bool resume = true;
+
+  CommandLine cmd;
+  cmd.AddValue ("binary", "The scenario binary", binary);
+  cmd.AddValue ("grid", "The parameter grid, e.g. \"relayRadius=100,300;txProb=0.5,1\"", grid);
+  cmd.AddValue ("seeds", "Comma-separated RngRun values, each point is run once per value", seeds);
+  cmd.AddValue ("args", "Space-separated arguments given to every run", args);
+  cmd.AddValue ("outDir", "The directory of the run directories and merged table", outDir);
+  cmd.AddValue ("kpiFiles", "Comma-separated names of the KPI files written by the scenario", kpiFiles);
+  cmd.AddValue ("jobs", "Number of concurrent runs (0 for the number of cores)", jobs);
+  cmd.AddValue ("resume", "Skip the runs that already succeeded in outDir", resume);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (binary.empty (), "No scenario binary (--binary)");
+  char path[PATH_MAX];
+  NS_ABORT_MSG_IF (realpath (binary.c_str (), path) == 0, "Can't find binary " << binary);
+  binary = path;
+
+  ParameterGrid parameters (grid);
+  std::vector<std::string> rngRuns = ParameterGrid::SplitList (seeds);
+  NS_ABORT_MSG_IF (rngRuns.empty (), "No seeds");
+  std::vector<std::string> kpiNames = ParameterGrid::SplitList (kpiFiles);
+  std::vector<std::string> fixedArgs;
+  std::istringstream argStream (args);
+  for (std::string a; argStream >> a; )
+    {
+      fixedArgs.push_back (a);
+    }
+
+  uint32_t nRuns = parameters.GetNPoints () * rngRuns.size ();
+  std::vector<int> status (nRuns, -1);
+  ProcessPool pool (jobs);
+  ProcessPool::MakeDirectories (outDir);
+  std::cout << nRuns << " runs (" << parameters.GetNPoints () << " points x " << rngRuns.size ()
+            << " seeds) on " << pool.GetJobs () << " jobs" << std::endl;
+
+  uint32_t finished = 0;
+  for (uint32_t run = 0; run < nRuns; ++run)
+    {
+      std::string dir = RunDirectory (outDir, run);
+      std::vector<std::string> argv (1, binary);
+      ParameterGrid::Point point = parameters.GetPoint (run / rngRuns.size ());
+      for (uint32_t p = 0; p < point.size (); ++p)
+        {
+          argv.push_back ("--" + point[p].first + "=" + point[p].second);
+        }
+      argv.push_back ("--RngRun=" + rngRuns[run % rngRuns.size ()]);
+      argv.insert (argv.end (), fixedArgs.begin (), fixedArgs.end ());
+      if (resume && ReadStatus (dir) == 0 && ReadArgs (dir) == argv)
+        {
+          status[run] = 0;
+          ++finished;
+          continue;
+        }
+      PrepareRun (dir, argv, kpiNames);
+      pool.Submit (run, dir, argv);
+      // report the runs that finished meanwhile, without waiting
+      uint32_t done;
+      int exitStatus;
+      while (pool.Wait (done, exitStatus, false))
+        {
+          status[done] = exitStatus;
+          RecordStatus (RunDirectory (outDir, done), exitStatus, ++finished, nRuns);
+        }
+    }
+  uint32_t done;
+  int exitStatus;
+  while (pool.Wait (done, exitStatus))
+    {
+      status[done] = exitStatus;
+      RecordStatus (RunDirectory (outDir, done), exitStatus, ++finished, nRuns);
+    }
+
+  KpiTable table;
+  uint32_t failed = 0;
+  for (uint32_t run = 0; run < nRuns; ++run)
+    {
+      std::string dir = RunDirectory (outDir, run);
+      KpiTable::Row row;
+      std::ostringstream runId;
+      runId << run;
+      row.push_back (std::make_pair ("run", runId.str ()));
+      ParameterGrid::Point point = parameters.GetPoint (run / rngRuns.size ());
+      row.insert (row.end (), point.begin (), point.end ());
+      row.push_back (std::make_pair ("RngRun", rngRuns[run % rngRuns.size ()]));
+      std::ostringstream exitStatus;
+      exitStatus << status[run];
+      row.push_back (std::make_pair ("status", exitStatus.str ()));
+      failed += status[run] != 0;
+
+      std::vector<std::string> files = KpiTable::ListFiles (dir);
+      for (uint32_t f = 0; f < files.size (); ++f)
+        {
+          if (files[f].size () > 4 && files[f].compare (files[f].size () - 4, 4, ".xml") == 0)
+            {
+              KpiTable::ReadFlowMonitor (dir + "/" + files[f], row);
+            }
+        }
+      for (uint32_t k = 0; k < kpiNames.size (); ++k)
+        {
+          KpiTable::ReadKpiFile (dir + "/" + kpiNames[k], row);
+        }
+      table.AddRow (row);
+    }
+
+  std::string tableName = outDir + "/sweep.tsv";
+  std::ofstream out (tableName.c_str ());
+  NS_ABORT_MSG_UNLESS (out.is_open (), "Can't open file " << tableName);
+  table.Print (out);
+  std::cout << "Merged " << nRuns << " runs (" << failed << " failed) into " << tableName << std::endl;
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,299 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Online detection of the convergence of the sidelink synchronization
+ * protocol, instead of post-processing SyncRef.txt: the tracker follows
+ * the SLSSID every UE is synchronized to (the SLSSID of its SyncRef, or
+ * its own), from the ChangeOfSyncRef trace of LteUeRrc, and the UEs
+ * sending SLSS, from its SendSLSS trace.
+ *
+ * The clusters are the connected components of the radio links, the UE
+ * pairs whose S-RSRP reaches the minimum a UE needs to follow a SyncRef,
+ * and of the current SyncRef links: a UE that changes its SyncRef is
+ * linked to the UE that last sent SLSS with the SLSSID and offset of the
+ * new SyncRef, and a UE that selects itself loses its link. The radio
+ * links are computed once by Install, from the loss model given (the
+ * model wrapped by a LruPropagationLossModel rather than the cache, which
+ * they would fill).
+ *
+ * The protocol has converged once every cluster has a single SLSSID and
+ * no UE changed its SyncRef for the hold time, counted from the first
+ * evaluation at the earliest: until every UE has scanned and selected its
+ * SyncRef once, the initial SLSSIDs say nothing of the protocol. The
+ * convergence time is that of the last change, or the first evaluation if
+ * none; with SetStopOnConvergence the simulation ends when it is
+ * detected, for the studies of the protocol itself (the traffic of the
+ * scenario is cut short too).
+ *
+ *   Ptr<SyncConvergenceTracker> syncTracker = Create<SyncConvergenceTracker> (Seconds (2));
+ *   syncTracker->SetFirstEvaluation (MilliSeconds (firstScanTimeMax + scanTime + measTime));
+ *   syncTracker->Install (ueDevs, lossCache->GetModel (), ueTxPower, -125);
+ *   Simulator::Run ();
+ *   syncTracker->SetKpis (kpis);
+ *
+ * KPIs: syncConverged (0 or 1), syncConvergenceTime(s) (-1 if not
+ * converged), syncChanges (SyncRef changes) and syncRefs (UEs that sent
+ * SLSS during the hold time).
+ */
+
+#ifndef SYNC_CONVERGENCE_H
+#define SYNC_CONVERGENCE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/lte-module.h"
+
+#include "kpi-file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+class SyncConvergenceTracker : public SimpleRefCount<SyncConvergenceTracker>
+{
+public:
+  /**
+   * \param holdTime How long the SyncRefs must not change.
+   */
+  SyncConvergenceTracker (Time holdTime)
+    : m_holdTime (holdTime),
+      m_stopOnConvergence (false),
+      m_converged (false),
+      m_changes (0),
+      m_syncRefs (0)
+  { }
+
+  /**
+   * \param stop Whether to stop the simulation once converged.
+   */
+  void SetStopOnConvergence (bool stop)
+  {
+    m_stopOnConvergence = stop;
+  }
+
+  /**
+   * \param firstEvaluation The time by which every UE selected its SyncRef
+   *                        once (the end of the first scans and their
+   *                        measurement), zero without scanning; call
+   *                        before Install.
+   */
+  void SetFirstEvaluation (Time firstEvaluation)
+  {
+    m_firstEvaluation = firstEvaluation;
+  }
+
+  /**
+   * Follow the UEs, once their initial SLSSIDs are set.
+   * \param ues The UE devices.
+   * \param lossModel The sidelink pathloss model, not a cache of it.
+   * \param txPower The UE transmit power (dBm).
+   * \param minSrsrp The S-RSRP (dBm per RE) a UE needs to follow a SyncRef.
+   */
+  void Install (NetDeviceContainer ues, Ptr<PropagationLossModel> lossModel, double txPower, double minSrsrp)
+  {
+    NS_ABORT_MSG_UNLESS (m_slssids.empty (), "The tracker is already installed");
+    ComputeRadioClusters (ues, lossModel, txPower, minSrsrp);
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        Ptr<LteUeNetDevice> ueDev = ues.Get (i)->GetObject<LteUeNetDevice> ();
+        NS_ABORT_MSG_IF (ueDev == 0, "Device " << i << " is not an LTE UE");
+        Ptr<LteUeRrc> rrc = ueDev->GetRrc ();
+        uint32_t ue = m_slssids.size ();
+        m_syncRef.push_back (ue);
+        m_slssids.push_back (rrc->GetSlssid ());
+        m_lastSlss.push_back (Seconds (-1));
+        rrc->TraceConnectWithoutContext ("ChangeOfSyncRef", MakeBoundCallback (&SyncConvergenceTracker::ChangeOfSyncRef,
+                                                                              Ptr<SyncConvergenceTracker> (this), ue));
+        rrc->TraceConnectWithoutContext ("SendSLSS", MakeBoundCallback (&SyncConvergenceTracker::SendSlss,
+                                                                       Ptr<SyncConvergenceTracker> (this), ue));
+      }
+    Update ();
+  }
+
+  /**
+   * \return Whether the protocol converged.
+   */
+  bool IsConverged (void) const
+  {
+    return m_converged;
+  }
+
+  /**
+   * \return The time of the last SyncRef change before convergence, or
+   *         the first evaluation if none.
+   */
+  Time GetConvergenceTime (void) const
+  {
+    return std::max (m_lastChange, m_firstEvaluation);
+  }
+
+  /**
+   * \param kpis The KPI file of the run.
+   */
+  void SetKpis (Ptr<KpiFile> kpis) const
+  {
+    kpis->Set ("syncConverged", m_converged ? 1 : 0);
+    kpis->Set ("syncConvergenceTime(s)", m_converged ? GetConvergenceTime ().GetSeconds () : -1);
+    kpis->Set ("syncChanges", m_changes);
+    kpis->Set ("syncRefs", m_syncRefs);
+  }
+
+  /**
+   * \param os The stream to print the outcome to.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    os << "sync: " << m_slssids.size () << " UEs in " << CountClusters () << " clusters, " << m_changes << " SyncRef changes, ";
+    if (m_converged)
+      {
+        os << "converged at " << GetConvergenceTime ().GetSeconds () << " s (" << m_syncRefs << " SyncRefs)";
+      }
+    else
+      {
+        os << "not converged";
+      }
+    os << std::endl;
+  }
+
+private:
+  static void ChangeOfSyncRef (Ptr<SyncConvergenceTracker> tracker, uint32_t ue, LteUeRrc::SlChangeOfSyncRefStatParameters param)
+  {
+    tracker->m_changes++;
+    tracker->m_slssids[ue] = param.currSlssid;
+    std::map<std::pair<uint64_t, uint16_t>, uint32_t>::const_iterator sender
+      = tracker->m_slssSenders.find (std::make_pair ((uint64_t) param.currSlssid, (uint16_t) param.currRxOffset));
+    tracker->m_syncRef[ue] = sender == tracker->m_slssSenders.end () ? ue : sender->second;
+    tracker->m_lastChange = Simulator::Now ();
+    tracker->m_converged = false;
+    tracker->Update ();
+  }
+
+  static void SendSlss (Ptr<SyncConvergenceTracker> tracker, uint32_t ue, uint64_t imsi, uint64_t slssid, uint16_t txOffset,
+                        bool inCoverage, uint16_t frame, uint16_t subframe)
+  {
+    tracker->m_lastSlss[ue] = Simulator::Now ();
+    tracker->m_slssSenders[std::make_pair (slssid, txOffset)] = ue;
+  }
+
+  // the S-RSRP of the SLSS (txPower over its 6 RBs, 72 REs), as SyncPreset
+  void ComputeRadioClusters (NetDeviceContainer ues, Ptr<PropagationLossModel> lossModel, double txPower, double minSrsrp)
+  {
+    std::vector<Ptr<MobilityModel> > mobility (ues.GetN ());
+    m_radioCluster.resize (ues.GetN ());
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        m_radioCluster[i] = i;
+        mobility[i] = ues.Get (i)->GetNode ()->GetObject<MobilityModel> ();
+        NS_ABORT_MSG_IF (mobility[i] == 0, "UE " << i << " has no mobility");
+      }
+    double txPowerPerRe = txPower - 10 * std::log10 (72.0);
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        for (uint32_t j = i + 1; j < ues.GetN (); j++)
+          {
+            if (lossModel->CalcRxPower (txPowerPerRe, mobility[j], mobility[i]) >= minSrsrp)
+              {
+                m_radioCluster[Find (m_radioCluster, i)] = Find (m_radioCluster, j);
+              }
+          }
+      }
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        m_radioCluster[i] = Find (m_radioCluster, i);
+      }
+  }
+
+  // the cluster of every UE: the connected components of the radio and SyncRef links
+  std::vector<uint32_t> Clusters (void) const
+  {
+    std::vector<uint32_t> parent = m_radioCluster;
+    for (uint32_t ue = 0; ue < parent.size (); ue++)
+      {
+        parent[Find (parent, ue)] = Find (parent, m_syncRef[ue]);
+      }
+    for (uint32_t ue = 0; ue < parent.size (); ue++)
+      {
+        parent[ue] = Find (parent, ue);
+      }
+    return parent;
+  }
+
+  uint32_t CountClusters (void) const
+  {
+    std::vector<uint32_t> cluster = Clusters ();
+    uint32_t clusters = 0;
+    for (uint32_t ue = 0; ue < cluster.size (); ue++)
+      {
+        clusters += cluster[ue] == ue;
+      }
+    return clusters;
+  }
+
+  static uint32_t Find (std::vector<uint32_t> &parent, uint32_t i)
+  {
+    while (parent[i] != i)
+      {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+      }
+    return i;
+  }
+
+  // (re)start the hold time, from the first evaluation at the earliest,
+  // if every cluster has a single SLSSID
+  void Update (void)
+  {
+    m_check.Cancel ();
+    std::vector<uint32_t> cluster = Clusters ();
+    std::map<uint32_t, uint64_t> clusterSlssid;
+    for (uint32_t ue = 0; ue < m_slssids.size (); ue++)
+      {
+        std::map<uint32_t, uint64_t>::const_iterator it = clusterSlssid.find (cluster[ue]);
+        if (it != clusterSlssid.end () && it->second != m_slssids[ue])
+          {
+            return;
+          }
+        clusterSlssid[cluster[ue]] = m_slssids[ue];
+      }
+    Time start = std::max (Simulator::Now (), m_firstEvaluation);
+    m_check = Simulator::Schedule (start + m_holdTime - Simulator::Now (), &SyncConvergenceTracker::Converged, this);
+  }
+
+  void Converged (void)
+  {
+    m_converged = true;
+    m_syncRefs = 0;
+    for (uint32_t ue = 0; ue < m_lastSlss.size (); ue++)
+      {
+        m_syncRefs += m_lastSlss[ue] >= Simulator::Now () - m_holdTime;
+      }
+    if (m_stopOnConvergence)
+      {
+        Simulator::Stop ();
+      }
+  }
+
+  Time m_holdTime;                              //!< How long the SyncRefs must not change.
+  bool m_stopOnConvergence;                     //!< Whether to stop the simulation once converged.
+  Time m_firstEvaluation;                       //!< The time every UE selected its SyncRef once by.
+  std::vector<uint32_t> m_radioCluster;         //!< The radio cluster (root UE) of every UE.
+  std::vector<uint32_t> m_syncRef;              //!< The SyncRef UE of every UE, itself if none.
+  std::map<std::pair<uint64_t, uint16_t>, uint32_t> m_slssSenders; //!< The last UE sending every SLSSID and offset.
+  std::vector<uint64_t> m_slssids;              //!< The current SLSSID of every UE.
+  std::vector<Time> m_lastSlss;                 //!< The last SLSS sent by every UE.
+  EventId m_check;                              //!< The end of the hold time.
+  Time m_lastChange;                            //!< The last SyncRef change.
+  bool m_converged;                             //!< Whether the protocol converged.
+  uint64_t m_changes;                           //!< The SyncRef changes.
+  uint32_t m_syncRefs;                          //!< The UEs that sent SLSS during the hold time.
+};
+
+} // namespace ns3
+
+#endif /* SYNC_CONVERGENCE_H */
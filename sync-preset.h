@@ -0,0 +1,201 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Converged sidelink synchronization state assigned at t=0, for sweeps
+ * that study the traffic rather than the SLSS protocol: the UEs start
+ * with the SLSSID they would share at the end of the SyncRef selection,
+ * so that the scenario neither staggers the first scans nor transmits
+ * SLSS, and the traffic can start at once.
+ *
+ * The SLSSIDs either come from
+ *  - ComputeClusters: the UEs connected by links whose S-RSRP reaches
+ *    minSrsrp form a cluster, which gets one SLSSID (firstSlssid + the
+ *    cluster index, in UE order); the S-RSRP is the received power of
+ *    the SLSS, txPower over its 6 RBs (72 REs), through the loss model;
+ *  - Load: the SyncRef.txt of a previous run of the same deployment, whose
+ *    last row per IMSI gives the SLSSID the UE ended with.
+ *
+ *   Config::SetDefault ("ns3::LteUePhy::UeRandomInitialSubframeIndication", BooleanValue (false));
+ *   ...
+ *   Ptr<SyncPreset> syncPreset = Create<SyncPreset> ();
+ *   if (syncRefFile.empty ())
+ *     {
+ *       syncPreset->ComputeClusters (ueDevs, lossModel, ueTxPower, -125);
+ *     }
+ *   else
+ *     {
+ *       syncPreset->Load (syncRefFile);
+ *     }
+ *   syncPreset->Apply (ueDevs);
+ *
+ * Frame and subframe numbers are not set per UE: without random initial
+ * subframe indications every UE starts at the same one, which is the
+ * timing of its cluster once converged. Clusters out of range of each
+ * other are aligned as well, which the protocol would not guarantee.
+ */
+
+#ifndef SYNC_PRESET_H
+#define SYNC_PRESET_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/lte-module.h"
+
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class SyncPreset : public SimpleRefCount<SyncPreset>
+{
+public:
+  SyncPreset (void)
+  { }
+
+  /**
+   * Cluster the UEs by S-RSRP.
+   * \param ues The UE devices.
+   * \param lossModel The sidelink pathloss model.
+   * \param txPower The UE transmit power (dBm).
+   * \param minSrsrp The S-RSRP (dBm per RE) a UE needs to follow a SyncRef.
+   * \param firstSlssid The SLSSID of the first cluster.
+   */
+  void ComputeClusters (NetDeviceContainer ues, Ptr<PropagationLossModel> lossModel, double txPower, double minSrsrp,
+                        uint64_t firstSlssid = 100000)
+  {
+    std::vector<uint32_t> parent (ues.GetN ());
+    std::vector<Ptr<MobilityModel> > mobility (ues.GetN ());
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        parent[i] = i;
+        mobility[i] = ues.Get (i)->GetNode ()->GetObject<MobilityModel> ();
+        NS_ABORT_MSG_IF (mobility[i] == 0, "UE " << i << " has no mobility");
+      }
+    double txPowerPerRe = txPower - 10 * std::log10 (72.0);
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        for (uint32_t j = i + 1; j < ues.GetN (); j++)
+          {
+            if (lossModel->CalcRxPower (txPowerPerRe, mobility[j], mobility[i]) >= minSrsrp)
+              {
+                parent[Find (parent, i)] = Find (parent, j);
+              }
+          }
+      }
+    // the clusters are numbered in the order of their first UE
+    std::map<uint32_t, uint64_t> clusterSlssid;
+    m_slssids.clear ();
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        uint32_t root = Find (parent, i);
+        if (clusterSlssid.find (root) == clusterSlssid.end ())
+          {
+            uint64_t slssid = firstSlssid + clusterSlssid.size ();
+            clusterSlssid[root] = slssid;
+          }
+        m_slssids[GetImsi (ues.Get (i))] = clusterSlssid[root];
+      }
+  }
+
+  /**
+   * \param syncRefFile The SyncRef.txt of a previous run.
+   * \return False if there is no such file.
+   */
+  bool Load (std::string syncRefFile)
+  {
+    std::ifstream is (syncRefFile.c_str ());
+    if (!is)
+      {
+        return false;
+      }
+    m_slssids.clear ();
+    std::string line;
+    std::getline (is, line);
+    NS_ABORT_MSG_UNLESS (line.compare (0, 9, "Time\tIMSI") == 0, syncRefFile << " is not a SyncRef trace");
+    while (std::getline (is, line))
+      {
+        // Time IMSI prevSLSSID prevRxOffset prevFrameNo prevSframeNo currSLSSID ...
+        std::istringstream row (line);
+        uint64_t time, imsi, prevSlssid, prevRxOffset, prevFrameNo, prevSubframeNo, currSlssid;
+        row >> time >> imsi >> prevSlssid >> prevRxOffset >> prevFrameNo >> prevSubframeNo >> currSlssid;
+        NS_ABORT_MSG_UNLESS (row, "Bad row in " << syncRefFile << ": " << line);
+        m_slssids[imsi] = currSlssid;
+      }
+    return true;
+  }
+
+  /**
+   * Set the SLSSID of every UE.
+   * \param ues The UE devices, all clustered or in the loaded trace.
+   */
+  void Apply (NetDeviceContainer ues) const
+  {
+    for (uint32_t i = 0; i < ues.GetN (); i++)
+      {
+        ues.Get (i)->GetObject<LteUeNetDevice> ()->GetRrc ()->SetSlssid (GetSlssid (GetImsi (ues.Get (i))));
+      }
+  }
+
+  /**
+   * \param imsi The IMSI of a UE, clustered or in the loaded trace.
+   * \return Its SLSSID, which identifies its cluster.
+   */
+  uint64_t GetSlssid (uint64_t imsi) const
+  {
+    std::map<uint64_t, uint64_t>::const_iterator it = m_slssids.find (imsi);
+    NS_ABORT_MSG_IF (it == m_slssids.end (), "No SLSSID for IMSI " << imsi);
+    return it->second;
+  }
+
+  /**
+   * \return The number of SLSSIDs (clusters).
+   */
+  uint32_t GetClusters (void) const
+  {
+    std::set<uint64_t> slssids;
+    for (std::map<uint64_t, uint64_t>::const_iterator it = m_slssids.begin (); it != m_slssids.end (); ++it)
+      {
+        slssids.insert (it->second);
+      }
+    return slssids.size ();
+  }
+
+  /**
+   * \param os The stream to print the preset to.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    os << "sync preset: " << m_slssids.size () << " UEs in " << GetClusters () << " clusters" << std::endl;
+  }
+
+private:
+  static uint32_t Find (std::vector<uint32_t> &parent, uint32_t i)
+  {
+    while (parent[i] != i)
+      {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+      }
+    return i;
+  }
+
+  static uint64_t GetImsi (Ptr<NetDevice> dev)
+  {
+    Ptr<LteUeNetDevice> ueDev = dev->GetObject<LteUeNetDevice> ();
+    NS_ABORT_MSG_IF (ueDev == 0, "Device is not an LTE UE");
+    return ueDev->GetImsi ();
+  }
+
+  std::map<uint64_t, uint64_t> m_slssids;       //!< The SLSSID of every IMSI.
+};
+
+} // namespace ns3
+
+#endif /* SYNC_PRESET_H */
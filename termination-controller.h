@@ -0,0 +1,226 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * KPI-driven termination of a scenario that otherwise runs to a fixed stop
+ * time: the scenario registers its stop criteria, the controller checks
+ * them periodically and stops the simulation at the first check where all
+ * of them hold, or at the time limit given to Start otherwise. A criterion
+ * is either
+ *  - a condition, e.g. every listener received the GROUP CALL BROADCAST
+ *    END, every UE discovered all the others;
+ *  - a steady state: a KPI sampled at every check (e.g. the PDR so far)
+ *    that varied by at most epsilon over the last samples.
+ *
+ *   Ptr<TerminationController> termination = Create<TerminationController> (MilliSeconds (100));
+ *   termination->AddCriterion ("all discovered", MakeBoundCallback (&AllDiscovered, progress));
+ *   termination->AddSteadyState ("pdr", MakeCallback (&SlDeliveryStats::GetPdr, deliveryStats), 0.01, 5);
+ *   termination->Start (Seconds (2), Seconds (simTime));
+ *   Simulator::Run ();
+ *   termination->PrintStats (std::cout);
+ *   termination->SetKpis (kpis);
+ *
+ * The stopping reason (the criteria that held, or those that did not by
+ * the time limit) is printed by PrintStats. KPIs: earlyStop (0 or 1)
+ * and endTime(s).
+ */
+
+#ifndef TERMINATION_CONTROLLER_H
+#define TERMINATION_CONTROLLER_H
+
+#include "ns3/core-module.h"
+
+#include "kpi-file.h"
+
+#include <algorithm>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class TerminationController : public SimpleRefCount<TerminationController>
+{
+public:
+  /**
+   * \param checkInterval The time between two checks of the criteria.
+   */
+  TerminationController (Time checkInterval)
+    : m_checkInterval (checkInterval),
+      m_checks (0),
+      m_early (false),
+      m_limitReached (false)
+  {
+    NS_ABORT_MSG_UNLESS (checkInterval.IsStrictlyPositive (), "The check interval must be positive");
+  }
+
+  /**
+   * \param name The name of the criterion, printed as the stopping reason.
+   * \param holds Whether the criterion holds.
+   */
+  void AddCriterion (std::string name, Callback<bool> holds)
+  {
+    Criterion criterion;
+    criterion.name = name;
+    criterion.holds = holds;
+    m_criteria.push_back (criterion);
+  }
+
+  /**
+   * \param name The name of the KPI.
+   * \param kpi Its current value, sampled at every check.
+   * \param epsilon The largest variation of a steady KPI.
+   * \param samples The number of last samples within epsilon of each other.
+   */
+  void AddSteadyState (std::string name, Callback<double> kpi, double epsilon, uint32_t samples)
+  {
+    NS_ABORT_MSG_IF (samples < 2, "A steady state needs at least 2 samples");
+    Criterion criterion;
+    criterion.name = name + " steady";
+    criterion.kpi = kpi;
+    criterion.epsilon = epsilon;
+    criterion.samples = samples;
+    m_criteria.push_back (criterion);
+  }
+
+  /**
+   * Check the criteria from the given time on, and stop the simulation at
+   * the time limit if they do not all hold by then; call once they are
+   * all added.
+   * \param first The time of the first check.
+   * \param limit The time the simulation stops at anyway.
+   */
+  void Start (Time first, Time limit)
+  {
+    NS_ABORT_MSG_IF (m_criteria.empty (), "No termination criteria");
+    NS_ABORT_MSG_IF (limit < first, "Time limit before the first check");
+    m_check = Simulator::Schedule (first - Simulator::Now (), &TerminationController::Check, this);
+    m_limit = Simulator::Schedule (limit - Simulator::Now (), &TerminationController::Expire, this);
+  }
+
+  /**
+   * \return Whether the criteria stopped the simulation.
+   */
+  bool IsEarlyStop (void) const
+  {
+    return m_early;
+  }
+
+  /**
+   * \param kpis The KPI file of the run, after Simulator::Run.
+   */
+  void SetKpis (Ptr<KpiFile> kpis) const
+  {
+    kpis->Set ("earlyStop", m_early ? 1 : 0);
+    kpis->Set ("endTime(s)", Simulator::Now ().GetSeconds ());
+  }
+
+  /**
+   * \param os The stream to print the stopping reason to, after
+   *           Simulator::Run.
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    os << "termination: ";
+    if (m_early)
+      {
+        os << "early stop at " << Simulator::Now ().GetSeconds () << " s (" << Reason (true) << ")";
+      }
+    else if (m_checks == 0)
+      {
+        os << "ended at " << Simulator::Now ().GetSeconds () << " s before the first check";
+      }
+    else
+      {
+        os << (m_limitReached ? "time limit reached at " : "ended at ") << Simulator::Now ().GetSeconds ()
+           << " s, criteria not met (" << Reason (false) << ")";
+      }
+    os << ", " << m_checks << " checks" << std::endl;
+  }
+
+private:
+  struct Criterion
+  {
+    Criterion (void)
+      : epsilon (0),
+        samples (0),
+        held (false)
+    { }
+
+    std::string name;                   //!< The name of the criterion.
+    Callback<bool> holds;               //!< The condition, null for a steady state.
+    Callback<double> kpi;               //!< The KPI of a steady state.
+    double epsilon;                     //!< The largest variation of a steady KPI.
+    uint32_t samples;                   //!< The samples a steady KPI is checked over.
+    std::deque<double> history;         //!< The last samples of the KPI.
+    bool held;                          //!< Whether it held at the last check.
+  };
+
+  // every criterion is evaluated, so that the KPIs are sampled at every check
+  void Check (void)
+  {
+    m_checks++;
+    bool all = true;
+    for (uint32_t c = 0; c < m_criteria.size (); c++)
+      {
+        Criterion &criterion = m_criteria[c];
+        criterion.held = criterion.holds.IsNull () ? IsSteady (criterion) : criterion.holds ();
+        all = all && criterion.held;
+      }
+    if (all)
+      {
+        m_early = true;
+        m_limit.Cancel ();
+        Simulator::Stop ();
+        return;
+      }
+    m_check = Simulator::Schedule (m_checkInterval, &TerminationController::Check, this);
+  }
+
+  void Expire (void)
+  {
+    m_limitReached = true;
+    m_check.Cancel ();
+    Simulator::Stop ();
+  }
+
+  static bool IsSteady (Criterion &criterion)
+  {
+    criterion.history.push_back (criterion.kpi ());
+    if (criterion.history.size () > criterion.samples)
+      {
+        criterion.history.pop_front ();
+      }
+    if (criterion.history.size () < criterion.samples)
+      {
+        return false;
+      }
+    return *std::max_element (criterion.history.begin (), criterion.history.end ())
+           - *std::min_element (criterion.history.begin (), criterion.history.end ()) <= criterion.epsilon;
+  }
+
+  // the names of the criteria that held (or not) at the last check
+  std::string Reason (bool held) const
+  {
+    std::string reason;
+    for (uint32_t c = 0; c < m_criteria.size (); c++)
+      {
+        if (m_criteria[c].held == held)
+          {
+            reason += (reason.empty () ? "" : ", ") + m_criteria[c].name;
+          }
+      }
+    return reason;
+  }
+
+  Time m_checkInterval;                         //!< The time between two checks.
+  std::vector<Criterion> m_criteria;            //!< The stop criteria.
+  EventId m_check;                              //!< The next check.
+  EventId m_limit;                              //!< The stop at the time limit.
+  uint32_t m_checks;                            //!< The checks done.
+  bool m_early;                                 //!< Whether the criteria stopped the simulation.
+  bool m_limitReached;                          //!< Whether the time limit stopped it.
+};
+
+} // namespace ns3
+
+#endif /* TERMINATION_CONTROLLER_H */
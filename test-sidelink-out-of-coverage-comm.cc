@@ -46,19 +46,13 @@
 #include <ns3/udp-socket-factory.h>
 #include <ns3/udp-echo-client.h>
 #include "ns3/flow-monitor-module.h"
+#include "packet-trace-writer.h"
 
 #include <cfloat>
 #include <sstream>
 
 using namespace ns3;
 
-// This trace will log packet transmissions and receptions from the application
-// layer.  The parameter 'localAddrs' is passed to this trace in case the
-// address passed by the trace is not set (i.e., is '0.0.0.0' or '::').  The
-// trace writes to a file stream provided by the first argument; by default,
-// this trace file is 'UePacketTrace.tr'
-
- 
 void
 ChangeUdpEchoClientRemote (Ptr<Node> newRemoteNode, Ptr<UdpEchoClient> app, uint16_t port, Ipv6Address network, Ipv6Prefix prefix)
 {
@@ -74,68 +68,20 @@ ChangeUdpEchoClientRemote (Ptr<Node> newRemoteNode, Ptr<UdpEchoClient> app, uint
 
 
 void
-TraceSinkPC5SignalingPacketTrace (Ptr<OutputStreamWrapper> stream, uint32_t srcL2Id, uint32_t dstL2Id, Ptr<Packet> p)
+TraceSinkPC5SignalingPacketTrace (Ptr<FilteredTraceStream> trace, uint32_t srcL2Id, uint32_t dstL2Id, Ptr<Packet> p)
 {
+  if (!trace->Accept (p->GetSize ()))
+    {
+      return;
+    }
   LteSlPc5SignallingMessageType lpc5smt;
   p->PeekHeader (lpc5smt);
-  *stream->GetStream () << Simulator::Now ().GetSeconds () << "\t" << srcL2Id << "\t" << dstL2Id << "\t" << lpc5smt.GetMessageName () << std::endl;
+  std::ostringstream line;
+  line << Simulator::Now ().GetSeconds () << "\t" << srcL2Id << "\t" << dstL2Id << "\t" << lpc5smt.GetMessageName () << "\n";
+  trace->Write (line.str ());
 }
 
 
-void
-UePacketTrace (Ptr<OutputStreamWrapper> stream, const Address &localAddrs, std::string context, Ptr<const Packet> p, const Address &srcAddrs, const Address &dstAddrs)
-{
-  std::ostringstream oss;
-  *stream->GetStream () << Simulator::Now ().GetNanoSeconds () / (double) 1e9 << "\t" << context << "\t" << p->GetSize () << "\t";
-  if (InetSocketAddress::IsMatchingType (srcAddrs))
-    {
-      oss << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 ();
-      if (!oss.str ().compare ("0.0.0.0")) //srcAddrs not set
-        {
-          *stream->GetStream () << Ipv4Address::ConvertFrom (localAddrs) << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-        }
-      else
-        {
-          oss.str ("");
-          oss << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 ();
-          if (!oss.str ().compare ("0.0.0.0")) //dstAddrs not set
-            {
-              *stream->GetStream () << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" <<  Ipv4Address::ConvertFrom (localAddrs) << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-          else
-            {
-              *stream->GetStream () << InetSocketAddress::ConvertFrom (srcAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << InetSocketAddress::ConvertFrom (dstAddrs).GetIpv4 () << ":" << InetSocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-        }
-    }
-  else
-   if (Inet6SocketAddress::IsMatchingType (srcAddrs))
-    {
-      oss << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 ();
-      if (!oss.str ().compare ("::")) //srcAddrs not set
-        {
-          *stream->GetStream () << Ipv6Address::ConvertFrom (localAddrs) << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-        }
-      else
-        {
-          oss.str ("");
-          oss << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 ();
-          if (!oss.str ().compare ("::")) //dstAddrs not set
-            {
-              *stream->GetStream () << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Ipv6Address::ConvertFrom (localAddrs) << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-          else
-            {
-              *stream->GetStream () << Inet6SocketAddress::ConvertFrom (srcAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (srcAddrs).GetPort () << "\t" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetIpv6 () << ":" << Inet6SocketAddress::ConvertFrom (dstAddrs).GetPort () << std::endl;
-            }
-        }
-    }
-  else
-    {
-      *stream->GetStream () << "Unknown address type!" << std::endl;
-    }
-}
-
 /*Synchronization traces*/
 void
 NotifyChangeOfSyncRef (Ptr<OutputStreamWrapper> stream, LteUeRrc::SlChangeOfSyncRefStatParameters param)
@@ -183,11 +129,15 @@ int main (int argc, char *argv[])
   Time simTime = Seconds (10);
   bool enableNsLogs = false;
   bool useIPv6 = true;
+  bool binaryTraces = false;
+  std::string traceFilter = "";
 
   CommandLine cmd;
   cmd.AddValue ("simTime", "Total duration of the simulation", simTime);
   cmd.AddValue ("enableNsLogs", "Enable ns-3 logging (debug builds)", enableNsLogs);
   cmd.AddValue ("useIPv6", "Use IPv6 instead of IPv4", useIPv6);
+  cmd.AddValue ("binaryTraces", "Write the application packet trace in the binary format (see packet-trace-convert)", binaryTraces);
+  cmd.AddValue ("traceFilter", "Packet trace subscription, e.g. \"nodes=3,4;ports=8000;dir=rx;size=0-512;sample=1/10\" (see packet-trace-filter.h)", traceFilter);
   cmd.Parse (argc, argv);
 
     /* Synchronization*/
@@ -602,11 +552,10 @@ std::vector < NetDeviceContainer > createdgroups;
 createdgroups = proseHelper->AssociateForBroadcast (46.0, ulEarfcn,ulBandwidth, relayUeDevs,-112, 1,LteSidelinkHelper::SLRSRP_PSBCH);
   ///*** End of application configuration ***///
 
-  // AsciiTraceHelper ascii;
-  Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream ("UePacketTrace.tr");
-
-  //Trace file table header
-  *stream->GetStream () << "time(sec)\ttx/rx\tNodeID\tIMSI\tPktSize(bytes)\tIP[src]\tIP[dst]" << std::endl;
+  Ptr<AsyncPacketTraceWriter> packetTraceWriter = Create<AsyncPacketTraceWriter> (binaryTraces ? "UePacketTrace.bin" : "UePacketTrace.tr",
+    "time(sec)\ttx/rx\tNodeID\tIMSI\tPktSize(bytes)\tIP[src]\tIP[dst]",
+    PacketTraceRecord::SIZE_FIRST, binaryTraces ? AsyncPacketTraceWriter::BINARY : AsyncPacketTraceWriter::TEXT);
+  packetTraceWriter->SetFilter (Create<PacketTraceFilter> (traceFilter));
 
   std::ostringstream oss;
 
@@ -618,7 +567,7 @@ createdgroups = proseHelper->AssociateForBroadcast (46.0, ulEarfcn,ulBandwidth,
           Ipv4Address localAddrs =  clientApps.Get (ac)->GetNode ()->GetObject<Ipv4L3Protocol> ()->GetAddress (1,0).GetLocal ();
           std::cout << "Tx address: " << localAddrs << std::endl;
           oss << "tx\t" << allUeNodes.Get (0)->GetId () << "\t" << allUeNodes.Get (0)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-          clientApps.Get (ac)->TraceConnect ("TxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream, localAddrs));
+          packetTraceWriter->Connect (clientApps.Get (ac), "TxWithAddresses", oss.str (), localAddrs);
           oss.str ("");
         }
 
@@ -628,7 +577,7 @@ createdgroups = proseHelper->AssociateForBroadcast (46.0, ulEarfcn,ulBandwidth,
           Ipv4Address localAddrs =  serverApps.Get (ac)->GetNode ()->GetObject<Ipv4L3Protocol> ()->GetAddress (1,0).GetLocal ();
           std::cout << "Rx address: " << localAddrs << std::endl;
           oss << "rx\t" << allUeNodes.Get (1)->GetId () << "\t" << allUeNodes.Get (1)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-          serverApps.Get (ac)->TraceConnect ("RxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream, localAddrs));
+          packetTraceWriter->Connect (serverApps.Get (ac), "RxWithAddresses", oss.str (), localAddrs);
           oss.str ("");
         }
     }
@@ -641,7 +590,7 @@ createdgroups = proseHelper->AssociateForBroadcast (46.0, ulEarfcn,ulBandwidth,
           Ipv6Address localAddrs =  clientApps.Get (ac)->GetNode ()->GetObject<Ipv6L3Protocol> ()->GetAddress (1,1).GetAddress ();
           std::cout << "Tx address: " << localAddrs << std::endl;
           oss << "tx\t" << allUeNodes.Get (0)->GetId () << "\t" << allUeNodes.Get (0)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-          clientApps.Get (ac)->TraceConnect ("TxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream, localAddrs));
+          packetTraceWriter->Connect (clientApps.Get (ac), "TxWithAddresses", oss.str (), localAddrs);
           oss.str ("");
         }
 
@@ -652,7 +601,7 @@ createdgroups = proseHelper->AssociateForBroadcast (46.0, ulEarfcn,ulBandwidth,
           Ipv6Address localAddrs =  serverApps.Get (ac)->GetNode ()->GetObject<Ipv6L3Protocol> ()->GetAddress (1,1).GetAddress ();
           std::cout << "Rx address: " << localAddrs << std::endl;
           oss << "rx\t" << allUeNodes.Get (1)->GetId () << "\t" << allUeNodes.Get (1)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi ();
-          serverApps.Get (ac)->TraceConnect ("RxWithAddresses", oss.str (), MakeBoundCallback (&UePacketTrace, stream, localAddrs));
+          packetTraceWriter->Connect (serverApps.Get (ac), "RxWithAddresses", oss.str (), localAddrs);
           oss.str ("");
         }
     }
@@ -662,26 +611,37 @@ createdgroups = proseHelper->AssociateForBroadcast (46.0, ulEarfcn,ulBandwidth,
   //Tracing PC5 signaling messages
   Ptr<OutputStreamWrapper> PC5SignalingPacketTraceStream = ascii.CreateFileStream ("PC5SignalingPacketTrace.txt");
   *PC5SignalingPacketTraceStream->GetStream () << "time(s)\ttxId\tRxId\tmsgType" << std::endl;
+  Ptr<PacketTraceFilter> pc5TraceFilter = Create<PacketTraceFilter> (traceFilter);
+  Ptr<FilteredTraceStream> pc5Trace = Create<FilteredTraceStream> (PC5SignalingPacketTraceStream, pc5TraceFilter);
+  //the direction term is for the application traces: this one only has receptions
 
   for (uint32_t ueDevIdx = 0; ueDevIdx < relayUeDevs.GetN (); ueDevIdx++)
     {
+      if (!pc5TraceFilter->IsSubscribed (relayUeDevs.Get (ueDevIdx)->GetNode ()->GetId (), PacketTraceFilter::BOTH))
+        {
+          continue;
+        }
       Ptr<LteUeRrc> rrc = relayUeDevs.Get (ueDevIdx)->GetObject<LteUeNetDevice> ()->GetRrc ();
       PointerValue ptrOne;
       rrc->GetAttribute ("SidelinkConfiguration", ptrOne);
       Ptr<LteSlUeRrc> slUeRrc = ptrOne.Get<LteSlUeRrc> ();
       slUeRrc->TraceConnectWithoutContext ("PC5SignalingPacketTrace",
                                            MakeBoundCallback (&TraceSinkPC5SignalingPacketTrace,
-                                                              PC5SignalingPacketTraceStream));
+                                                              pc5Trace));
     }
   for (uint32_t ueDevIdx = 0; ueDevIdx < remoteUeDevs.GetN (); ueDevIdx++)
     {
+      if (!pc5TraceFilter->IsSubscribed (remoteUeDevs.Get (ueDevIdx)->GetNode ()->GetId (), PacketTraceFilter::BOTH))
+        {
+          continue;
+        }
       Ptr<LteUeRrc> rrc = remoteUeDevs.Get (ueDevIdx)->GetObject<LteUeNetDevice> ()->GetRrc ();
       PointerValue ptrOne;
       rrc->GetAttribute ("SidelinkConfiguration", ptrOne);
       Ptr<LteSlUeRrc> slUeRrc = ptrOne.Get<LteSlUeRrc> ();
       slUeRrc->TraceConnectWithoutContext ("PC5SignalingPacketTrace",
                                            MakeBoundCallback (&TraceSinkPC5SignalingPacketTrace,
-                                                              PC5SignalingPacketTraceStream));
+                                                              pc5Trace));
     }
 
 
@@ -714,6 +674,8 @@ createdgroups = proseHelper->AssociateForBroadcast (46.0, ulEarfcn,ulBandwidth,
   // anim.EnablePacketMetadata (true);
 
   Simulator::Run ();
+  packetTraceWriter->Close ();
+  pc5Trace->Close ();
   Simulator::Destroy ();
   return 0;
 
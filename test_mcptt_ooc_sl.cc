@@ -9,6 +9,7 @@
 #include <cfloat>
 #include <sstream>
 #include <ns3/netanim-module.h>
+#include "pathloss-matrix.h"
 
 using namespace ns3;
 
@@ -41,6 +42,7 @@ int main (int argc, char *argv[])
   Ipv4Address peerAddress = Ipv4Address ("225.0.0.0");
   Time startTime = Seconds (2);
   Time stopTime = simTime;
+  bool pathlossMatrix = true;
 
   //Configure the UE for UE_SELECTED scenario
   Config::SetDefault ("ns3::LteUeMac::SlGrantMcs", UintegerValue (16));
@@ -63,6 +65,7 @@ int main (int argc, char *argv[])
   CommandLine cmd;
   cmd.AddValue ("simTime", "Total duration of the simulation", simTime);
   cmd.AddValue ("enableNsLogs", "Enable ns-3 logging (debug builds)", enableNsLogs);
+  cmd.AddValue ("pathlossMatrix", "Precompute the pathloss between the static UEs", pathlossMatrix);
   cmd.Parse (argc, argv);
 
   //Sidelink bearers activation time
@@ -83,8 +86,16 @@ int main (int argc, char *argv[])
   //Enable Sidelink
   lteHelper->SetAttribute ("UseSidelink", BooleanValue (true));
 
-  //Set pathloss model
-  lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Cost231PropagationLossModel"));
+  //Set pathloss model, looked up in the pair-loss matrix of the UEs since they don't move
+  if (pathlossMatrix)
+    {
+      lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::MatrixPropagationLossModel"));
+      lteHelper->SetPathlossModelAttribute ("Model", StringValue ("ns3::Cost231PropagationLossModel"));
+    }
+  else
+    {
+      lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Cost231PropagationLossModel"));
+    }
   // channel model initialization
   lteHelper->Initialize ();
 
@@ -92,6 +103,11 @@ int main (int argc, char *argv[])
   double ulFreq = LteSpectrumValueHelper::GetCarrierFrequency (ulEarfcn);
   NS_LOG_LOGIC ("UL freq: " << ulFreq);
   Ptr<Object> uplinkPathlossModel = lteHelper->GetUplinkPathlossModel ();
+  Ptr<MatrixPropagationLossModel> lossMatrix = uplinkPathlossModel->GetObject<MatrixPropagationLossModel> ();
+  if (lossMatrix)
+    {
+      uplinkPathlossModel = lossMatrix->GetModel ();
+    }
   Ptr<PropagationLossModel> lossModel = uplinkPathlossModel->GetObject<PropagationLossModel> ();
   NS_ABORT_MSG_IF (lossModel == NULL, "No PathLossModel");
   bool ulFreqOk = uplinkPathlossModel->SetAttributeFailSafe ("Frequency", DoubleValue (ulFreq));
@@ -126,6 +142,11 @@ int main (int argc, char *argv[])
   mobilityUe2.SetPositionAllocator (positionAllocUe2);
   mobilityUe2.Install (ueNodes.Get (1));
 
+  if (lossMatrix)
+    {
+      lossMatrix->Build (ueNodes);
+    }
+
   //Install LTE UE devices to the nodes
   NetDeviceContainer ueDevs = lteHelper->InstallUeDevice (ueNodes);
 
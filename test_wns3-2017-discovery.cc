@@ -59,6 +59,11 @@
 #include "ns3/lte-mac-sap.h"
 #include "ns3/lte-rlc-sap.h"
 #include "ns3/ff-mac-sched-sap.h"
+#include "kpi-file.h"
+#include "sync-preset.h"
+#include "termination-controller.h"
+
+#include <set>
 
 using namespace ns3;
 
@@ -162,6 +167,31 @@ NotifySendOfSlss (Ptr<OutputStreamWrapper> stream, uint64_t imsi, uint64_t slssi
   *stream->GetStream () << Simulator::Now ().GetMilliSeconds () << "\t" << imsi << "\t"  << slssid << "\t" << txOffset << "\t" << inCoverage << "\t" << frame <<  "\t" << subframe << std::endl;
 }
 
+/*Discovery KPIs*/
+//the codes every UE has discovered, and when it had discovered all the other UEs
+struct DiscoveryProgress : public SimpleRefCount<DiscoveryProgress>
+{
+  uint32_t nbUes;
+  std::map<uint64_t, std::set<uint32_t> > discovered;
+  std::map<uint64_t, Time> completed;
+};
+
+void
+NotifyDiscoveryMonitoring (Ptr<DiscoveryProgress> progress, uint64_t imsi, uint16_t cellId, uint16_t rnti, LteSlDiscHeader discMsg)
+{
+  std::set<uint32_t> &codes = progress->discovered[imsi];
+  if (codes.insert (discMsg.GetApplicationCode ()).second && codes.size () + 1 == progress->nbUes)
+    {
+      progress->completed[imsi] = Simulator::Now ();
+    }
+}
+
+bool
+AllDiscovered (Ptr<DiscoveryProgress> progress)
+{
+  return progress->completed.size () == progress->nbUes;
+}
+
 
 int main (int argc, char *argv[])
 {
@@ -172,6 +202,12 @@ int main (int argc, char *argv[])
   uint16_t txProb = 100;
   bool useRecovery = false;
   bool  enableNsLogs = false; // If enabled will output NS LOGs
+  std::string kpiFile = "kpi.txt";
+  bool syncAssumed = false; // start with the converged SLSSIDs, without the staggered SyncRef scans
+  std::string syncRefFile = ""; // SyncRef.txt of a previous run giving them, clustered by S-RSRP if empty
+  bool earlyStop = true; // end the run once every UE discovered all the others
+  double discoveryStartTime = 2.0; // s, start of the discovery apps
+  double syncAssumedStartTime = 0.1; // s, start of the discovery apps with syncAssumed, no SyncRef scan to wait for
 
   // Command line arguments
   CommandLine cmd;
@@ -180,6 +216,12 @@ int main (int argc, char *argv[])
   cmd.AddValue ("txProb", "initial transmission probability", txProb);
   cmd.AddValue ("enableRecovery", "error model and HARQ for D2D Discovery", useRecovery);
   cmd.AddValue ("enableNsLogs", "Enable NS logs", enableNsLogs);
+  cmd.AddValue ("kpiFile", "File the KPIs of the run are written to (none if empty)", kpiFile);
+  cmd.AddValue ("syncAssumed", "Start in the converged synchronization state and skip the SyncRef scans", syncAssumed);
+  cmd.AddValue ("syncRefFile", "SyncRef.txt of a previous run giving the converged SLSSIDs (S-RSRP clusters if empty)", syncRefFile);
+  cmd.AddValue ("earlyStop", "End the run once every UE discovered all the others, instead of at simTime", earlyStop);
+  cmd.AddValue ("discoveryStart", "Start time (s) of the discovery applications", discoveryStartTime);
+  cmd.AddValue ("syncAssumedStart", "Start time (s) of the discovery applications with syncAssumed, instead of discoveryStart", syncAssumedStartTime);
 
   cmd.Parse (argc, argv);
 
@@ -204,6 +246,10 @@ int main (int argc, char *argv[])
   // Use error model and HARQ for D2D Discovery (recovery process)
   Config::SetDefault ("ns3::LteSpectrumPhy::SlDiscoveryErrorModelEnabled", BooleanValue (useRecovery));
   Config::SetDefault ("ns3::LteSpectrumPhy::DropRbOnCollisionEnabled", BooleanValue (true));
+  if (syncAssumed)
+    {
+      Config::SetDefault ("ns3::LteUePhy::UeRandomInitialSubframeIndication", BooleanValue (false));
+    }
 
   //sidelink pre-configuration
   //Configure the UE for UE_SELECTED scenario
@@ -381,8 +427,11 @@ lteHelper->InstallSidelinkConfiguration (ueDevs, ueSidelinkConfiguration);
 uint16_t base_t = 2000; //ms
 
 uint16_t devIt = 1;
-ueDevs.Get (devIt)->GetObject<LteUeNetDevice> ()->GetRrc ()->SetSlssid (devIt + 10);
-ueDevs.Get (devIt)->GetObject<LteUeNetDevice> ()->GetPhy ()->SetFirstScanningTime (MilliSeconds (base_t + (devIt * base_t)));
+if (!syncAssumed)
+  {
+    ueDevs.Get (devIt)->GetObject<LteUeNetDevice> ()->GetRrc ()->SetSlssid (devIt + 10);
+    ueDevs.Get (devIt)->GetObject<LteUeNetDevice> ()->GetPhy ()->SetFirstScanningTime (MilliSeconds (base_t + (devIt * base_t)));
+  }
 
 NS_LOG_INFO ("Configuring discovery applications");
 std::map<Ptr<NetDevice>, std::list<uint32_t> > announcePayloads; 
@@ -401,10 +450,11 @@ for (uint32_t i = 1; i <= nbUes; ++i)
       }
   }
 
+Time discoveryStart = Seconds (syncAssumed ? syncAssumedStartTime : discoveryStartTime);
 for (uint32_t i = 0; i < nbUes; i++)
   {
-    Simulator::Schedule (Seconds (2.0), &LteSidelinkHelper::StartDiscoveryApps, sidelinkHelper, ueDevs.Get (i), announcePayloads[ueDevs.Get (i)], LteSlUeRrc::Announcing);
-    Simulator::Schedule (Seconds (2.0), &LteSidelinkHelper::StartDiscoveryApps, sidelinkHelper, ueDevs.Get (i), monitorPayloads[ueDevs.Get (i)], LteSlUeRrc::Monitoring);
+    Simulator::Schedule (discoveryStart, &LteSidelinkHelper::StartDiscoveryApps, sidelinkHelper, ueDevs.Get (i), announcePayloads[ueDevs.Get (i)], LteSlUeRrc::Announcing);
+    Simulator::Schedule (discoveryStart, &LteSidelinkHelper::StartDiscoveryApps, sidelinkHelper, ueDevs.Get (i), monitorPayloads[ueDevs.Get (i)], LteSlUeRrc::Monitoring);
   }
 
 AsciiTraceHelper ascii;
@@ -426,7 +476,21 @@ for (uint32_t i = 0; i < ueDevs.GetN (); ++i)
 uint32_t baseTime = 2000; //ms
 uint32_t firstScanningTime = 0;
 
-for (uint32_t i = 0; i < ueDevs.GetN (); i++)
+if (syncAssumed)
+{
+  Ptr<SyncPreset> syncPreset = Create<SyncPreset> ();
+  if (syncRefFile.empty ())
+  {
+    syncPreset->ComputeClusters (ueDevs, lossModel, 23.0, -125); //the default MinSrsrp
+  }
+  else
+  {
+    NS_ABORT_MSG_UNLESS (syncPreset->Load (syncRefFile), "Can't open file " << syncRefFile);
+  }
+  syncPreset->Apply (ueDevs);
+  syncPreset->PrintStats (std::cout);
+}
+for (uint32_t i = 0; i < ueDevs.GetN () && !syncAssumed; i++)
 {
   uint64_t tempSlssid = i + 10;
   ueDevs.Get (i)->GetObject<LteUeNetDevice> ()->GetRrc ()->SetSlssid (tempSlssid);
@@ -939,6 +1003,18 @@ lteHelper->EnableDiscoveryMonitoringRrcTraces ();
 mcpttHelper.EnableMsgTraces ();
 mcpttHelper.EnableStateMachineTraces ();
 
+Ptr<DiscoveryProgress> discoveryProgress = Create<DiscoveryProgress> ();
+discoveryProgress->nbUes = nbUes;
+Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/$ns3::LteUeNetDevice/LteUeRrc/DiscoveryMonitoring",
+                               MakeBoundCallback (&NotifyDiscoveryMonitoring, discoveryProgress));
+Ptr<TerminationController> termination;
+if (earlyStop)
+  {
+    termination = Create<TerminationController> (MilliSeconds (100));
+    termination->AddCriterion ("discovery completed for all pairs", MakeBoundCallback (&AllDiscovered, discoveryProgress));
+    termination->Start (discoveryStart, Seconds (simTime));
+  }
+
 NS_LOG_INFO ("Starting simulation...");
 Simulator::Stop (Seconds (simTime));
 
@@ -946,6 +1022,32 @@ AnimationInterface anim ("discovery.xml");
 anim.SetMaxPktsPerTraceFile(500000);
 
 Simulator::Run ();
+
+//KPIs: discovery time is the time a UE takes to discover all the other UEs
+Ptr<KpiFile> kpis = Create<KpiFile> (kpiFile);
+double discoveryTimeSum = 0;
+uint32_t discoveredPairs = 0;
+for (std::map<uint64_t, Time>::iterator it = discoveryProgress->completed.begin (); it != discoveryProgress->completed.end (); ++it)
+  {
+    discoveryTimeSum += (it->second - discoveryStart).GetSeconds ();
+  }
+for (std::map<uint64_t, std::set<uint32_t> >::iterator it = discoveryProgress->discovered.begin (); it != discoveryProgress->discovered.end (); ++it)
+  {
+    discoveredPairs += it->second.size ();
+  }
+if (!discoveryProgress->completed.empty ())
+  {
+    kpis->Set ("discoveryTime(s)", discoveryTimeSum / discoveryProgress->completed.size ());
+  }
+kpis->Set ("discoveryComplete", discoveryProgress->completed.size () / (double) nbUes);
+kpis->Set ("discoveredPairs", nbUes > 1 ? discoveredPairs / (double) (nbUes * (nbUes - 1)) : 0);
+if (termination)
+  {
+    termination->PrintStats (std::cout);
+    termination->SetKpis (kpis);
+  }
+kpis->Write ();
+
 Simulator::Destroy ();
 return 0;
 
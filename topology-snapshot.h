@@ -0,0 +1,270 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Binary snapshot of a sidelink deployment: the eNodeB and UE positions,
+ * the IMSI of every UE and the broadcast groups, so that a sweep over
+ * traffic or timer parameters drops the UEs and associates the groups
+ * once, then reloads them in every other run.
+ *
+ * The file holds a key, given by the scenario, naming the parameters the
+ * deployment depends on (rings, isd, UEs per sector, groups, ...); a
+ * snapshot whose key differs is an error rather than a silent reuse. The
+ * random run is deliberately not part of it: replications that load the
+ * same file share their deployment, give one file per run otherwise.
+ *
+ * Layout, native endianness:
+ *   "TOPO", uint32 version, uint32 key length, key,
+ *   uint32 eNodeBs, { double x, y, z },
+ *   uint32 UEs, { uint64 IMSI, double x, y, z },
+ *   uint32 groups, { uint32 size, { uint32 UE index, transmitter first } }
+ *
+ * On load the UE positions are set before the devices are installed, in
+ * place of the topology helper's drop; the IMSIs of the new devices are
+ * checked against the snapshot, as they depend on the installation order.
+ *
+ *   Ptr<TopologySnapshot> topology = Create<TopologySnapshot> (key);
+ *   if (topology->Load (file))
+ *     {
+ *       topology->SetPositions (sectorNodes, ueNodes);
+ *       ueDevs = lteHelper->InstallUeDevice (ueNodes);
+ *       groups = topology->GetGroups (ueDevs);
+ *     }
+ *   else
+ *     {
+ *       ueDevs = topoHelper->DropUEsUniformlyPerSector (ueNodes);
+ *       groups = proseHelper->AssociateForBroadcast (...);
+ *       topology->Capture (sectorNodes, ueDevs, groups);
+ *       topology->Save (file);
+ *     }
+ */
+
+#ifndef TOPOLOGY_SNAPSHOT_H
+#define TOPOLOGY_SNAPSHOT_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/lte-module.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+class TopologySnapshot : public SimpleRefCount<TopologySnapshot>
+{
+public:
+  /**
+   * \param key The parameters the deployment depends on.
+   */
+  TopologySnapshot (std::string key)
+    : m_key (key)
+  { }
+
+  /**
+   * Record a deployment.
+   * \param enbNodes The eNodeB nodes.
+   * \param ueDevs The UE devices, in installation order.
+   * \param groups The broadcast groups, transmitter first.
+   */
+  void Capture (NodeContainer enbNodes, NetDeviceContainer ueDevs, const std::vector<NetDeviceContainer> &groups)
+  {
+    m_enbPositions.clear ();
+    m_uePositions.clear ();
+    m_imsis.clear ();
+    m_groups.clear ();
+    for (uint32_t i = 0; i < enbNodes.GetN (); i++)
+      {
+        m_enbPositions.push_back (enbNodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ());
+      }
+    std::unordered_map<const NetDevice *, uint32_t> indexes;
+    for (uint32_t i = 0; i < ueDevs.GetN (); i++)
+      {
+        indexes[PeekPointer (ueDevs.Get (i))] = i;
+        m_uePositions.push_back (ueDevs.Get (i)->GetNode ()->GetObject<MobilityModel> ()->GetPosition ());
+        m_imsis.push_back (ueDevs.Get (i)->GetObject<LteUeNetDevice> ()->GetImsi ());
+      }
+    for (uint32_t g = 0; g < groups.size (); g++)
+      {
+        std::vector<uint32_t> members;
+        for (uint32_t m = 0; m < groups[g].GetN (); m++)
+          {
+            std::unordered_map<const NetDevice *, uint32_t>::const_iterator it = indexes.find (PeekPointer (groups[g].Get (m)));
+            NS_ABORT_MSG_IF (it == indexes.end (), "Member " << m << " of group " << g << " is not among the UEs");
+            members.push_back (it->second);
+          }
+        m_groups.push_back (members);
+      }
+  }
+
+  /**
+   * \param filename The snapshot file, replaced atomically.
+   */
+  void Save (std::string filename) const
+  {
+    std::string tmp = filename + ".tmp";
+    std::ofstream os (tmp.c_str (), std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_UNLESS (os, "Cannot write the topology snapshot " << tmp);
+    os.write ("TOPO", 4);
+    Write (os, VERSION);
+    Write (os, (uint32_t) m_key.size ());
+    os.write (m_key.data (), m_key.size ());
+    Write (os, (uint32_t) m_enbPositions.size ());
+    for (uint32_t i = 0; i < m_enbPositions.size (); i++)
+      {
+        WritePosition (os, m_enbPositions[i]);
+      }
+    Write (os, (uint32_t) m_uePositions.size ());
+    for (uint32_t i = 0; i < m_uePositions.size (); i++)
+      {
+        Write (os, m_imsis[i]);
+        WritePosition (os, m_uePositions[i]);
+      }
+    Write (os, (uint32_t) m_groups.size ());
+    for (uint32_t g = 0; g < m_groups.size (); g++)
+      {
+        Write (os, (uint32_t) m_groups[g].size ());
+        for (uint32_t m = 0; m < m_groups[g].size (); m++)
+          {
+            Write (os, m_groups[g][m]);
+          }
+      }
+    os.close ();
+    NS_ABORT_MSG_UNLESS (os, "Cannot write the topology snapshot " << tmp);
+    NS_ABORT_MSG_IF (std::rename (tmp.c_str (), filename.c_str ()) != 0, "Cannot rename " << tmp << " to " << filename);
+  }
+
+  /**
+   * \param filename The snapshot file.
+   * \return False if there is no such file, true once it is loaded.
+   */
+  bool Load (std::string filename)
+  {
+    std::ifstream is (filename.c_str (), std::ios::binary);
+    if (!is)
+      {
+        return false;
+      }
+    char magic[4];
+    is.read (magic, 4);
+    NS_ABORT_MSG_UNLESS (is && std::string (magic, 4) == "TOPO", filename << " is not a topology snapshot");
+    NS_ABORT_MSG_UNLESS (Read<uint32_t> (is, filename) == VERSION, "Unsupported version of the topology snapshot " << filename);
+    std::string key (Read<uint32_t> (is, filename), '\0');
+    is.read (&key[0], key.size ());
+    NS_ABORT_MSG_UNLESS (is, "Truncated topology snapshot " << filename);
+    NS_ABORT_MSG_UNLESS (key == m_key, "The topology snapshot " << filename << " is of '" << key << "', not of '" << m_key << "'");
+
+    m_enbPositions.resize (Read<uint32_t> (is, filename));
+    for (uint32_t i = 0; i < m_enbPositions.size (); i++)
+      {
+        m_enbPositions[i] = ReadPosition (is, filename);
+      }
+    m_uePositions.resize (Read<uint32_t> (is, filename));
+    m_imsis.resize (m_uePositions.size ());
+    for (uint32_t i = 0; i < m_uePositions.size (); i++)
+      {
+        m_imsis[i] = Read<uint64_t> (is, filename);
+        m_uePositions[i] = ReadPosition (is, filename);
+      }
+    m_groups.resize (Read<uint32_t> (is, filename));
+    for (uint32_t g = 0; g < m_groups.size (); g++)
+      {
+        m_groups[g].resize (Read<uint32_t> (is, filename));
+        for (uint32_t m = 0; m < m_groups[g].size (); m++)
+          {
+            m_groups[g][m] = Read<uint32_t> (is, filename);
+            NS_ABORT_MSG_IF (m_groups[g][m] >= m_uePositions.size (), "Bad UE index in the topology snapshot " << filename);
+          }
+      }
+    return true;
+  }
+
+  /**
+   * Move the nodes to the loaded positions.
+   * \param enbNodes The eNodeB nodes.
+   * \param ueNodes The UE nodes, in installation order.
+   */
+  void SetPositions (NodeContainer enbNodes, NodeContainer ueNodes) const
+  {
+    NS_ABORT_MSG_IF (enbNodes.GetN () != m_enbPositions.size (), "The topology snapshot has " << m_enbPositions.size () << " eNodeBs, not " << enbNodes.GetN ());
+    NS_ABORT_MSG_IF (ueNodes.GetN () != m_uePositions.size (), "The topology snapshot has " << m_uePositions.size () << " UEs, not " << ueNodes.GetN ());
+    for (uint32_t i = 0; i < enbNodes.GetN (); i++)
+      {
+        enbNodes.Get (i)->GetObject<MobilityModel> ()->SetPosition (m_enbPositions[i]);
+      }
+    for (uint32_t i = 0; i < ueNodes.GetN (); i++)
+      {
+        ueNodes.Get (i)->GetObject<MobilityModel> ()->SetPosition (m_uePositions[i]);
+      }
+  }
+
+  /**
+   * \param ueDevs The UE devices installed on the nodes given to SetPositions.
+   * \return The loaded broadcast groups, transmitter first.
+   */
+  std::vector<NetDeviceContainer> GetGroups (NetDeviceContainer ueDevs) const
+  {
+    NS_ABORT_MSG_IF (ueDevs.GetN () != m_imsis.size (), "The topology snapshot has " << m_imsis.size () << " UEs, not " << ueDevs.GetN ());
+    for (uint32_t i = 0; i < ueDevs.GetN (); i++)
+      {
+        uint64_t imsi = ueDevs.Get (i)->GetObject<LteUeNetDevice> ()->GetImsi ();
+        NS_ABORT_MSG_IF (imsi != m_imsis[i], "UE " << i << " has IMSI " << imsi << ", " << m_imsis[i] << " in the topology snapshot");
+      }
+    std::vector<NetDeviceContainer> groups;
+    for (uint32_t g = 0; g < m_groups.size (); g++)
+      {
+        NetDeviceContainer group;
+        for (uint32_t m = 0; m < m_groups[g].size (); m++)
+          {
+            group.Add (ueDevs.Get (m_groups[g][m]));
+          }
+        groups.push_back (group);
+      }
+    return groups;
+  }
+
+private:
+  static const uint32_t VERSION = 1;
+
+  template <typename T>
+  static void Write (std::ostream &os, T value)
+  {
+    os.write (reinterpret_cast<const char *> (&value), sizeof (value));
+  }
+
+  static void WritePosition (std::ostream &os, const Vector &position)
+  {
+    Write (os, position.x);
+    Write (os, position.y);
+    Write (os, position.z);
+  }
+
+  template <typename T>
+  static T Read (std::istream &is, const std::string &filename)
+  {
+    T value;
+    is.read (reinterpret_cast<char *> (&value), sizeof (value));
+    NS_ABORT_MSG_UNLESS (is, "Truncated topology snapshot " << filename);
+    return value;
+  }
+
+  static Vector ReadPosition (std::istream &is, const std::string &filename)
+  {
+    double x = Read<double> (is, filename);
+    double y = Read<double> (is, filename);
+    double z = Read<double> (is, filename);
+    return Vector (x, y, z);
+  }
+
+  std::string m_key;                                   //!< The parameters the deployment depends on.
+  std::vector<Vector> m_enbPositions;                  //!< The eNodeB positions.
+  std::vector<Vector> m_uePositions;                   //!< The UE positions, in installation order.
+  std::vector<uint64_t> m_imsis;                       //!< The UE IMSIs, in installation order.
+  std::vector<std::vector<uint32_t> > m_groups;        //!< The UE indexes of each group, transmitter first.
+};
+
+} // namespace ns3
+
+#endif /* TOPOLOGY_SNAPSHOT_H */
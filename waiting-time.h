@@ -0,0 +1,163 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Relay-election waiting time heuristic used by the out-of-coverage
+ * broadcast call scenarios.
+ *
+ * The score of a candidate UE is
+ *
+ *   T_wait = 1/(locAccuracy + 0.1) * (ownSnr / otherDeviceSnr)
+ *            * 1/(inCoverage + 0.1) * 20/min (soc, 20) * tCycle
+ *
+ * i.e. the state-of-charge term only penalizes UEs below 20 % battery.
+ * SNR values are linear (not dB).
+ */
+
+#ifndef WAITING_TIME_H
+#define WAITING_TIME_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+namespace ns3 {
+
+/// Smallest denominator used by the waiting time guards.
+static const double WAITING_TIME_MIN_DENOM = 1e-9;
+
+/**
+ * Score one candidate UE.
+ *
+ * \param own_snr The SNR the UE measures towards the group (linear).
+ * \param loc_accuracy The location accuracy of the UE.
+ * \param other_device_snr The SNR reported by the neighbour UE (linear).
+ * \param incoverage True if the UE is in network coverage.
+ * \param mySoc The battery state of charge, in percent.
+ * \param T_cycle The election cycle duration.
+ * \return The waiting time before the UE initiates the call.
+ */
+inline double
+waiting_time (double own_snr, double loc_accuracy, double other_device_snr, bool incoverage, double mySoc, double T_cycle)
+{
+  double locDenom = loc_accuracy + 0.1;
+  double snrDenom = other_device_snr;
+  double soc = mySoc < 20 ? mySoc : 20;
+  if (locDenom < WAITING_TIME_MIN_DENOM)
+    {
+      locDenom = WAITING_TIME_MIN_DENOM;
+    }
+  if (snrDenom < WAITING_TIME_MIN_DENOM)
+    {
+      snrDenom = WAITING_TIME_MIN_DENOM;
+    }
+  if (soc < WAITING_TIME_MIN_DENOM)
+    {
+      soc = WAITING_TIME_MIN_DENOM;
+    }
+  // Folded into a single division; see the formula in the file header
+  return (own_snr * 20 * T_cycle) / (locDenom * snrDenom * (incoverage + 0.1) * soc);
+}
+
+/**
+ * Structure-of-arrays input of a relay election, one entry per candidate.
+ *
+ * Keeping each field in its own contiguous array lets waiting_time_batch ()
+ * stream through the candidates with unit stride, which the compiler
+ * auto-vectorizes.
+ */
+struct WaitingTimeCandidates
+{
+  std::vector<double> ownSnr;         //!< The own SNR (linear).
+  std::vector<double> locAccuracy;    //!< The location accuracy.
+  std::vector<double> otherDeviceSnr; //!< The neighbour SNR (linear).
+  std::vector<uint8_t> inCoverage;    //!< 1 if in coverage, 0 otherwise.
+  std::vector<double> soc;            //!< The state of charge, in percent.
+  std::vector<double> tCycle;         //!< The election cycle duration.
+
+  /**
+   * \return The number of candidates.
+   */
+  std::size_t GetN (void) const
+  {
+    return ownSnr.size ();
+  }
+
+  /**
+   * Reserve room for a number of candidates.
+   * \param n The number of candidates.
+   */
+  void Reserve (std::size_t n)
+  {
+    ownSnr.reserve (n);
+    locAccuracy.reserve (n);
+    otherDeviceSnr.reserve (n);
+    inCoverage.reserve (n);
+    soc.reserve (n);
+    tCycle.reserve (n);
+  }
+
+  /**
+   * Append a candidate. The arguments follow waiting_time ().
+   */
+  void Add (double own_snr, double loc_accuracy, double other_device_snr, bool incoverage, double mySoc, double T_cycle)
+  {
+    ownSnr.push_back (own_snr);
+    locAccuracy.push_back (loc_accuracy);
+    otherDeviceSnr.push_back (other_device_snr);
+    inCoverage.push_back (incoverage ? 1 : 0);
+    soc.push_back (mySoc);
+    tCycle.push_back (T_cycle);
+  }
+};
+
+/**
+ * Score n candidates given as raw arrays.
+ *
+ * The loop body is branch-free (the guards are min/max selects) so that it
+ * vectorizes; the results are identical to calling waiting_time () on each
+ * candidate. The output array must not alias any input.
+ */
+inline void
+waiting_time_batch (const double * __restrict ownSnr,
+                    const double * __restrict locAccuracy,
+                    const double * __restrict otherDeviceSnr,
+                    const uint8_t * __restrict inCoverage,
+                    const double * __restrict soc,
+                    const double * __restrict tCycle,
+                    std::size_t n,
+                    double * __restrict out)
+{
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      double locDenom = locAccuracy[i] + 0.1;
+      locDenom = locDenom < WAITING_TIME_MIN_DENOM ? WAITING_TIME_MIN_DENOM : locDenom;
+      double snrDenom = otherDeviceSnr[i];
+      snrDenom = snrDenom < WAITING_TIME_MIN_DENOM ? WAITING_TIME_MIN_DENOM : snrDenom;
+      double s = soc[i] < 20 ? soc[i] : 20;
+      s = s < WAITING_TIME_MIN_DENOM ? WAITING_TIME_MIN_DENOM : s;
+      double covDenom = inCoverage[i] + 0.1;
+      out[i] = (ownSnr[i] * 20 * tCycle[i]) / (locDenom * snrDenom * covDenom * s);
+    }
+}
+
+/**
+ * Score every candidate of an election.
+ *
+ * \param c The candidates.
+ * \param out The waiting time of each candidate, resized to c.GetN ().
+ */
+inline void
+waiting_time_batch (const WaitingTimeCandidates &c, std::vector<double> &out)
+{
+  std::size_t n = c.GetN ();
+  out.resize (n);
+  if (n == 0)
+    {
+      return;
+    }
+  waiting_time_batch (&c.ownSnr[0], &c.locAccuracy[0], &c.otherDeviceSnr[0],
+                      &c.inCoverage[0], &c.soc[0], &c.tCycle[0], n, &out[0]);
+}
+
+} // namespace ns3
+
+#endif /* WAITING_TIME_H */
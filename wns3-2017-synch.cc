@@ -46,6 +46,14 @@
 
 #include <cfloat>
 #include <sstream>
+#include "loss-cache.h"
+#include "broadcast-associator.h"
+#include "topology-snapshot.h"
+#include "sl-sci-destination-counter.h"
+#include "abstract-sl-phy.h"
+#include "sync-preset.h"
+#include "sync-convergence.h"
+#include "termination-controller.h"
 
 using namespace ns3;
 
@@ -122,7 +130,8 @@ main (int argc, char *argv[])
   Config::SetDefault ("ns3::LteUePowerControl::PscchTxPower", DoubleValue (ueTxPower));
 
   // Set data error model
-  Config::SetDefault ("ns3::LteSpectrumPhy::SlDataErrorModelEnabled", BooleanValue (false));
+  bool dataErrorModelEnabled = false;
+  Config::SetDefault ("ns3::LteSpectrumPhy::SlDataErrorModelEnabled", BooleanValue (dataErrorModelEnabled));
   Config::SetDefault ("ns3::LteSpectrumPhy::FadingModel", StringValue ("AWGN"));
 
 
@@ -168,8 +177,24 @@ main (int argc, char *argv[])
   uint32_t firstScanTimeMax = 4000; //ms
   bool unsyncSl = true;
   bool slSyncActive = true;
+  bool syncAssumed = false; // start with the converged SLSSIDs, without SLSS nor scanning
+  std::string syncRefFile = ""; // SyncRef.txt of a previous run giving them, clustered by S-RSRP if empty
+  double syncHoldTime = 2.0; // s without SyncRef change for the clusters to be converged, 0 to not track them
+  bool stopOnSync = false; // end the simulation once the synchronization converged
   bool  enableNsLogs = false; // If enabled will output NS LOGs
   /*END Synchronization*/
+  uint32_t lossCacheSize = 100000; // losses kept by the LRU pathloss cache, 0 to disable
+  double assocExponent = 0; // path loss exponent bounding the indexed group association, 0 for the helper's
+  std::string topologyFile = ""; // snapshot of the UE drop and groups, loaded if it exists, written otherwise
+  bool sciStats = true; // count the SCIs of the subscribed and other groups
+  bool abstractPhy = false; // play the groups on the link-to-system sidelink PHY instead of the LTE stack
+  std::string kpiFile = "kpi.txt";
+  std::string blerCache = "bler-table.bin"; // precomputed BLER of the abstract PHY, loaded if valid, written otherwise
+  uint32_t phyWorkers = 1; // threads computing the abstract PHY receptions, 0 for the number of cores
+  bool earlyStop = false; // end the run once the PDR is steady (and the synchronization converged, if tracked)
+  double pdrEpsilon = 0.005; // largest variation of a steady PDR
+  uint32_t pdrSamples = 5; // samples of the PDR within pdrEpsilon for it to be steady
+  double checkInterval = 1.0; // s between two samples of the PDR
 
   // Command line arguments
   CommandLine cmd;
@@ -205,11 +230,34 @@ main (int argc, char *argv[])
   cmd.AddValue ("firstScanTimeMax", "SL Sync: Max value of the uniform dist of the initial measurement", firstScanTimeMax);
   cmd.AddValue ("unsyncSl", "SL Sync: unsynchronized scenario (random frame/subframe indication, and random SLSSID", unsyncSl);
   cmd.AddValue ("slSyncActive", "SL Sync: activate the SL synchronization protocol", slSyncActive);
+  cmd.AddValue ("syncAssumed", "SL Sync: start in the converged state (SLSSID per cluster, aligned subframes) and skip the protocol", syncAssumed);
+  cmd.AddValue ("syncRefFile", "SL Sync: SyncRef.txt of a previous run giving the converged SLSSIDs (S-RSRP clusters if empty)", syncRefFile);
+  cmd.AddValue ("syncHoldTime", "SL Sync: time (s) without SyncRef change after which the clusters are converged (0 to not track them)", syncHoldTime);
+  cmd.AddValue ("stopOnSync", "SL Sync: stop the simulation once the synchronization converged", stopOnSync);
   cmd.AddValue ("enableNsLogs", "Enable NS logs", enableNsLogs);
+  cmd.AddValue ("lossCacheSize", "Pathloss values kept in the LRU cache (0 to disable it)", lossCacheSize);
+  cmd.AddValue ("assocExponent", "Form the groups with the spatially indexed association, bounded by this path loss exponent (0 for the helper's pairwise pass)", assocExponent);
+  cmd.AddValue ("topologyFile", "Load the UE positions and groups from this snapshot, or save them to it if it does not exist", topologyFile);
+  cmd.AddValue ("sciStats", "Count the SCIs of the subscribed groups and of the other groups", sciStats);
+  cmd.AddValue ("abstractPhy", "Use the abstract (link-to-system) sidelink PHY instead of the full one", abstractPhy);
+  cmd.AddValue ("kpiFile", "File the PDR and latency of the run are written to (none if empty)", kpiFile);
+  cmd.AddValue ("blerCache", "Cache file of the abstract PHY BLER table (none if empty)", blerCache);
+  cmd.AddValue ("phyWorkers", "Threads computing the abstract PHY receptions (0 for the number of cores)", phyWorkers);
+  cmd.AddValue ("earlyStop", "End the run once the PDR is steady and the synchronization converged (if tracked), instead of at simTime", earlyStop);
+  cmd.AddValue ("pdrEpsilon", "Largest variation of the PDR over pdrSamples for it to be steady", pdrEpsilon);
+  cmd.AddValue ("pdrSamples", "Number of last PDR samples within pdrEpsilon for it to be steady", pdrSamples);
+  cmd.AddValue ("checkInterval", "Time (s) between two samples of the PDR for earlyStop", checkInterval);
   /*END Synchronization*/
 
   cmd.Parse (argc, argv);
 
+  //The converged SLSSIDs of a previous run, read before this run truncates its SyncRef.txt
+  Ptr<SyncPreset> syncPreset = Create<SyncPreset> ();
+  if (syncAssumed && !syncRefFile.empty ())
+    {
+      NS_ABORT_MSG_UNLESS (syncPreset->Load (syncRefFile), "Can't open file " << syncRefFile);
+    }
+
   if (enableNsLogs)
     {
       LogLevel logLevel = (LogLevel)(LOG_PREFIX_FUNC | LOG_PREFIX_TIME | LOG_PREFIX_NODE | LOG_LEVEL_ALL);
@@ -232,8 +280,8 @@ main (int argc, char *argv[])
   Config::SetDefault ("ns3::LteUePhy::UeSlssScanningPeriod", TimeValue (MilliSeconds (scanTime)));
   Config::SetDefault ("ns3::LteUePhy::UeSlssMeasurementPeriod", TimeValue (MilliSeconds (measTime)));
   Config::SetDefault ("ns3::LteUePhy::UeSlssEvaluationPeriod", TimeValue (MilliSeconds (evalTime)));
-  Config::SetDefault ("ns3::LteUePhy::UeRandomInitialSubframeIndication", BooleanValue (unsyncSl));
-  if (slSyncActive)
+  Config::SetDefault ("ns3::LteUePhy::UeRandomInitialSubframeIndication", BooleanValue (unsyncSl && !syncAssumed));
+  if (slSyncActive && !syncAssumed)
     {
       Config::SetDefault ("ns3::LteUeRrc::UeSlssTransmissionEnabled", BooleanValue (true));
     }
@@ -286,8 +334,17 @@ main (int argc, char *argv[])
   lteHelper->SetEnbAntennaModelType ("ns3::Parabolic3dAntennaModel");
   lteHelper->SetEnbAntennaModelAttribute ("MechanicalTilt", DoubleValue (15));
 
-  // Set pathloss model
-  lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Hybrid3gppPropagationLossModel"));
+  // Set pathloss model, behind an LRU cache of the pair losses
+  if (lossCacheSize > 0)
+    {
+      lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::LruPropagationLossModel"));
+      lteHelper->SetPathlossModelAttribute ("Model", StringValue ("ns3::Hybrid3gppPropagationLossModel"));
+      lteHelper->SetPathlossModelAttribute ("Capacity", UintegerValue (lossCacheSize));
+    }
+  else
+    {
+      lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::Hybrid3gppPropagationLossModel"));
+    }
 
   //Configure general values of the topology
   topoHelper->SetNumRings (numRings);
@@ -317,9 +374,26 @@ main (int argc, char *argv[])
       mobilityResponders.Install (ueResponders);
     }
 
+  // Reload the deployment of an earlier run with the same topology parameters
+  std::ostringstream topologyKey;
+  topologyKey << "ring=" << numRings << " isd=" << isd << " responders=" << ueRespondersPerSector
+              << " groups=" << numGroups << " assocExponent=" << assocExponent;
+  Ptr<TopologySnapshot> topology = Create<TopologySnapshot> (topologyKey.str ());
+  bool topologyLoaded = !topologyFile.empty () && topology->Load (topologyFile);
+
   //Install LTE devices to all responders and deploy them in the sectors.
   lteHelper->SetAttribute ("UseSidelink", BooleanValue (true));
-  NetDeviceContainer ueRespondersDevs = topoHelper->DropUEsUniformlyPerSector (ueResponders);
+  NetDeviceContainer ueRespondersDevs;
+  if (topologyLoaded)
+    {
+      topology->SetPositions (sectorNodes, ueResponders);
+      ueRespondersDevs = lteHelper->InstallUeDevice (ueResponders);
+      std::cout << "Topology loaded from " << topologyFile << std::endl;
+    }
+  else
+    {
+      ueRespondersDevs = topoHelper->DropUEsUniformlyPerSector (ueResponders);
+    }
 
   //Fix the random number stream for LTE stack
   randomStream += lteHelper->AssignStreams (ueRespondersDevs, randomStream);
@@ -384,7 +458,27 @@ main (int argc, char *argv[])
   std::vector < NetDeviceContainer > createdgroups;
 
   //createdgroups = proseHelper->AssociateForBroadcastWithTxEnabledToReceive (ueTxPower, ulEarfcn, ulBandwidth, ueRespondersDevs, -1000, numGroups, LteProseHelper::SLRSRP_TX_PW);
-  createdgroups = proseHelper->AssociateForBroadcast (ueTxPower, ulEarfcn, ulBandwidth, ueRespondersDevs, -112, numGroups, LteSidelinkHelper::SLRSRP_PSBCH);
+  if (topologyLoaded)
+    {
+      createdgroups = topology->GetGroups (ueRespondersDevs);
+    }
+  else if (assocExponent > 0)
+    {
+      Ptr<BroadcastAssociator> associator = Create<BroadcastAssociator> (lteHelper, proseHelper);
+      associator->SetRangeBound (assocExponent);
+      randomStream += associator->AssignStreams (randomStream);
+      createdgroups = associator->Associate (ueTxPower, ulEarfcn, ulBandwidth, ueRespondersDevs, -112, numGroups, LteSidelinkHelper::SLRSRP_PSBCH);
+      std::cout << "Group association: " << associator->GetEvaluations () << " SL-RSRP computed" << std::endl;
+    }
+  else
+    {
+      createdgroups = proseHelper->AssociateForBroadcast (ueTxPower, ulEarfcn, ulBandwidth, ueRespondersDevs, -112, numGroups, LteSidelinkHelper::SLRSRP_PSBCH);
+    }
+  if (!topologyFile.empty () && !topologyLoaded)
+    {
+      topology->Capture (sectorNodes, ueRespondersDevs, createdgroups);
+      topology->Save (topologyFile);
+    }
 
   //print groups created
   AsciiTraceHelper ascii;
@@ -407,6 +501,42 @@ main (int argc, char *argv[])
   uint16_t pktSizeBytes = responderPktSize;
   double BitRate = pktSizeBytes * 8 * pktRate;
 
+  // PDR and latency of the groups, from the application traces or the abstract PHY
+  Ptr<SlDeliveryStats> deliveryStats = Create<SlDeliveryStats> ();
+  Ptr<KpiFile> kpis = Create<KpiFile> (kpiFile);
+  if (abstractPhy)
+    {
+      Ptr<AbstractSlPhy> abstractSlPhy = Create<AbstractSlPhy> (lteHelper->GetUplinkPathlossModel ()->GetObject<PropagationLossModel> ());
+      abstractSlPhy->SetRadio (ueTxPower, 9);
+      abstractSlPhy->SetPool (slPeriod, pscchLength, 2 * pscchRbs, 2 * 25); //the pool configured below
+      abstractSlPhy->SetGrant (rbSize, mcs, ktrp);
+      abstractSlPhy->SetErrorModels (ctrlErrorModelEnabled, dataErrorModelEnabled, dropOnCollisionEnabled);
+      Ptr<SlBlerTable> blerTable = Create<SlBlerTable> ();
+      if (blerCache.empty () || !blerTable->Load (blerCache))
+        {
+          blerTable->Build (std::vector<uint32_t> (1, mcs));
+          if (!blerCache.empty ())
+            {
+              blerTable->Save (blerCache);
+            }
+        }
+      abstractSlPhy->SetBlerTable (blerTable);
+      abstractSlPhy->SetPeriodicTraffic (pktSizeBytes, Seconds (encoderFrameLength), responderMaxPack);
+      if (onoff)
+        {
+          abstractSlPhy->SetOnOff (meanOnTime, meanOffTime);
+        }
+      abstractSlPhy->SetWorkers (phyWorkers);
+      randomStream += abstractSlPhy->AssignStreams (randomStream);
+      abstractSlPhy->Run (createdgroups, Seconds (respondersStart), Seconds (simTime), deliveryStats);
+      abstractSlPhy->PrintStats (std::cout);
+      deliveryStats->PrintStats (std::cout);
+      deliveryStats->SetKpis (kpis);
+      kpis->Write ();
+      Simulator::Destroy ();
+      return 0;
+    }
+
   // file
   stream = ascii.CreateFileStream ("pscr-ue-pck.tr");
   *stream->GetStream () << "time\ttx/rx\tNID\tIMSI\tUEtype\tsize\tIP[src]\tIP[dst]" << std::endl;
@@ -421,6 +551,7 @@ main (int argc, char *argv[])
   uint16_t echoPort = 8000; //where to listen
   uint16_t grpEchoServerPort = 8000; //where to send
 
+  Ptr<SlSciDestinationCounter> sciCounter = Create<SlSciDestinationCounter> ();
   std::vector < NetDeviceContainer >::iterator gIt;
   for (gIt = createdgroups.begin (); gIt != createdgroups.end (); gIt++)
     {
@@ -433,6 +564,7 @@ main (int argc, char *argv[])
       proseHelper->ActivateSidelinkBearer (Seconds (1.0), txUe, tft);
       tft = Create<LteSlTft> (LteSlTft::RECEIVE, groupRespondersIpv4Address, groupL2Address);
       proseHelper->ActivateSidelinkBearer (Seconds (1.0), rxUes, tft);
+      sciCounter->Subscribe (rxUes, groupL2Address);
 
       //Deploy applications
       // Application to generate traffic (installed only in transmitter)
@@ -470,6 +602,7 @@ main (int argc, char *argv[])
           Ipv4Address localAddrs = (*gIt).Get (ac)->GetNode ()->GetObject<Ipv4L3Protocol> ()->GetAddress (1,0).GetLocal ();
           std::cout << "Tx address: " << localAddrs << std::endl;
           clientRespondersApps.Get (ac)->TraceConnect ("TxWithAddresses", oss.str (), MakeBoundCallback (&PacketSrcDstAddrsTrace, stream, localAddrs));
+          deliveryStats->ConnectTx (clientRespondersApps.Get (ac), rxUes.GetN ());
           oss.str ("");
         }
 
@@ -478,6 +611,10 @@ main (int argc, char *argv[])
       groupL2Address++;
       groupRespondersIpv4Address = Ipv4AddressGenerator::NextAddress (Ipv4Mask ("255.0.0.0"));
     }
+  if (sciStats)
+    {
+      sciCounter->Install (ueRespondersDevs);
+    }
 
   // Application to receive traffic (Installed in all responders)
 
@@ -493,6 +630,7 @@ main (int argc, char *argv[])
       std::cout << "Rx address: " << localAddrs << std::endl;
       oss << "r\t" << ueResponders.Get (ac)->GetId () << "\t" << ueResponders.Get (ac)->GetDevice (0)->GetObject<LteUeNetDevice> ()->GetImsi () << "\tresp";
       clientRespondersSrvApps.Get (ac)->TraceConnect ("RxWithAddresses", oss.str (), MakeBoundCallback (&PacketSrcDstAddrsTrace, stream, localAddrs));
+      deliveryStats->ConnectRx (clientRespondersSrvApps.Get (ac));
       oss.str ("");
     }
 
@@ -578,12 +716,15 @@ main (int argc, char *argv[])
       for (uint32_t i = 0; i < (*groupIt).GetN (); ++i)
         {
           uint32_t slssid = rndSlssid->GetInteger ();
-          (*groupIt).Get (i)->GetObject<LteUeNetDevice> ()->GetRrc ()->SetSlssid (slssid);
+          if (!syncAssumed)
+            {
+              (*groupIt).Get (i)->GetObject<LteUeNetDevice> ()->GetRrc ()->SetSlssid (slssid);
+            }
 
           if ((*groupIt).Get (i)->GetObject<LteUeNetDevice> ()->GetPhy ()->GetFirstScanningTime () == MilliSeconds (0))
             {
               uint32_t t = 0;
-              if (slSyncActive)
+              if (slSyncActive && !syncAssumed)
                 {
                   t = rndStartScanning->GetInteger ();
                   (*groupIt).Get (i)->GetObject<LteUeNetDevice> ()->GetPhy ()->SetFirstScanningTime (MilliSeconds (t));
@@ -593,6 +734,36 @@ main (int argc, char *argv[])
         }
     }
 
+  //The S-RSRP clusters are computed on the pathloss model behind the cache, which they would fill
+  Ptr<LruPropagationLossModel> lossCache = lteHelper->GetUplinkPathlossModel ()->GetObject<LruPropagationLossModel> ();
+  Ptr<PropagationLossModel> syncLossModel = lossCache ? lossCache->GetModel ()
+    : lteHelper->GetUplinkPathlossModel ()->GetObject<PropagationLossModel> ();
+  //Synchronization clusters of the converged state, unless loaded above
+  if (syncAssumed && syncRefFile.empty ())
+    {
+      //the MinSrsrp set above, plus the minimum hysteresis
+      syncPreset->ComputeClusters (ueRespondersDevs, syncLossModel, ueTxPower, -125 + syncRefMinHyst);
+    }
+  //Converged synchronization state, instead of the protocol
+  if (syncAssumed)
+    {
+      syncPreset->Apply (ueRespondersDevs);
+      syncPreset->PrintStats (std::cout);
+    }
+  //Online convergence detection
+  Ptr<SyncConvergenceTracker> syncTracker;
+  if (syncHoldTime > 0)
+    {
+      syncTracker = Create<SyncConvergenceTracker> (Seconds (syncHoldTime));
+      syncTracker->SetStopOnConvergence (stopOnSync);
+      if (slSyncActive && !syncAssumed)
+        {
+          //the last first scan, and the measurement the first SyncRef selection is based on
+          syncTracker->SetFirstEvaluation (MilliSeconds (firstScanTimeMax + scanTime + measTime));
+        }
+      syncTracker->Install (ueRespondersDevs, syncLossModel, ueTxPower, -125 + syncRefMinHyst);
+    }
+
   //Tracing the change of synchronization reference
   for (uint32_t i = 0; i < ueRespondersDevs.GetN (); ++i)
     {
@@ -626,11 +797,44 @@ main (int argc, char *argv[])
   lteHelper->EnableSlPscchRxPhyTraces ();
 
 
+  //Early termination: the PDR so far varied by at most pdrEpsilon over the last pdrSamples
+  Ptr<TerminationController> termination;
+  if (earlyStop)
+    {
+      termination = Create<TerminationController> (Seconds (checkInterval));
+      termination->AddSteadyState ("pdr", MakeCallback (&SlDeliveryStats::GetPdr, deliveryStats), pdrEpsilon, pdrSamples);
+      if (syncTracker)
+        {
+          termination->AddCriterion ("sync converged", MakeCallback (&SyncConvergenceTracker::IsConverged, syncTracker));
+        }
+      termination->Start (Seconds (respondersStart + checkInterval), Seconds (simTime));
+    }
 
   Simulator::Stop (Seconds (simTime));
 
   std::cout << "Simulation running..." << std::endl;
   Simulator::Run ();
+  if (lossCache)
+    {
+      lossCache->PrintStats (std::cout);
+    }
+  if (sciStats)
+    {
+      sciCounter->PrintStats (std::cout);
+    }
+  deliveryStats->PrintStats (std::cout);
+  deliveryStats->SetKpis (kpis);
+  if (syncTracker)
+    {
+      syncTracker->PrintStats (std::cout);
+      syncTracker->SetKpis (kpis);
+    }
+  if (termination)
+    {
+      termination->PrintStats (std::cout);
+      termination->SetKpis (kpis);
+    }
+  kpis->Write ();
   AnimationInterface anim("wns3_synch.xml");
 anim.SetMaxPktsPerTraceFile(500000);
   /*Synchronization*/